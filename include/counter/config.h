@@ -28,7 +28,7 @@ struct lib_counter_config {
 	enum lib_counter_config_sync sync;
 	enum {
 		COUNTER_ARITHMETIC_MODULAR,
-		COUNTER_ARITHMETIC_SATURATE,	/* TODO */
+		COUNTER_ARITHMETIC_SATURATE,
 	} arithmetic;
 	enum {
 		COUNTER_SIZE_8_BIT	= 1,
@@ -36,6 +36,13 @@ struct lib_counter_config {
 		COUNTER_SIZE_32_BIT	= 4,
 		COUNTER_SIZE_64_BIT	= 8,
 	} counter_size;
+	/*
+	 * With COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL, use 64-bit
+	 * global counters. Narrow per-cpu counters spill into them by
+	 * batches of global_sum_step / 2. Increments larger than
+	 * global_sum_step / 2 are added to the global counters directly.
+	 */
+	bool wide_global;
 };
 
 #endif /* _LTTNG_COUNTER_CONFIG_H */
@@ -19,7 +19,9 @@
 #include <wrapper/limits.h>
 
 /*
- * Using unsigned arithmetic because overflow is defined.
+ * Using unsigned arithmetic because overflow is defined. Saturating
+ * counters are clamped to the limits of their type instead of wrapping
+ * around, and flagged as overflowed or underflowed.
  */
 static __always_inline int __lttng_counter_add(const struct lib_counter_config *config,
 				       enum lib_counter_config_alloc alloc,
@@ -48,7 +50,7 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		return -EINVAL;
 	}
 
-	switch (config->counter_size) {
+	switch (lttng_counter_layout_counter_size(config, alloc == COUNTER_ALLOC_GLOBAL)) {
 	case COUNTER_SIZE_8_BIT:
 	{
 		int8_t *int_p = (int8_t *) layout->counters + index;
@@ -62,7 +64,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 			do {
 				move_sum = 0;
 				old = res;
-				n = (int8_t) ((uint8_t) old + (uint8_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int8_t) lttng_counter_saturate_add(old, v, S8_MIN, S8_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int8_t) ((uint8_t) old + (uint8_t) v);
+				}
 				if (unlikely(n > (int8_t) global_sum_step))
 					move_sum = (int8_t) global_sum_step / 2;
 				else if (unlikely(n < -(int8_t) global_sum_step))
@@ -76,7 +85,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		{
 			do {
 				old = res;
-				n = (int8_t) ((uint8_t) old + (uint8_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int8_t) lttng_counter_saturate_add(old, v, S8_MIN, S8_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int8_t) ((uint8_t) old + (uint8_t) v);
+				}
 				res = cmpxchg(int_p, old, n);
 			} while (old != res);
 			break;
@@ -84,6 +100,8 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		default:
 			return -EINVAL;
 		}
+		if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE)
+			break;
 		if (v > 0 && (v >= U8_MAX || n < old))
 			overflow = true;
 		else if (v < 0 && (v <= -(s64) U8_MAX || n > old))
@@ -103,7 +121,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 			do {
 				move_sum = 0;
 				old = res;
-				n = (int16_t) ((uint16_t) old + (uint16_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int16_t) lttng_counter_saturate_add(old, v, S16_MIN, S16_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int16_t) ((uint16_t) old + (uint16_t) v);
+				}
 				if (unlikely(n > (int16_t) global_sum_step))
 					move_sum = (int16_t) global_sum_step / 2;
 				else if (unlikely(n < -(int16_t) global_sum_step))
@@ -117,7 +142,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		{
 			do {
 				old = res;
-				n = (int16_t) ((uint16_t) old + (uint16_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int16_t) lttng_counter_saturate_add(old, v, S16_MIN, S16_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int16_t) ((uint16_t) old + (uint16_t) v);
+				}
 				res = cmpxchg(int_p, old, n);
 			} while (old != res);
 			break;
@@ -125,6 +157,8 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		default:
 			return -EINVAL;
 		}
+		if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE)
+			break;
 		if (v > 0 && (v >= U16_MAX || n < old))
 			overflow = true;
 		else if (v < 0 && (v <= -(s64) U16_MAX || n > old))
@@ -144,7 +178,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 			do {
 				move_sum = 0;
 				old = res;
-				n = (int32_t) ((uint32_t) old + (uint32_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int32_t) lttng_counter_saturate_add(old, v, S32_MIN, S32_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int32_t) ((uint32_t) old + (uint32_t) v);
+				}
 				if (unlikely(n > (int32_t) global_sum_step))
 					move_sum = (int32_t) global_sum_step / 2;
 				else if (unlikely(n < -(int32_t) global_sum_step))
@@ -158,7 +199,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		{
 			do {
 				old = res;
-				n = (int32_t) ((uint32_t) old + (uint32_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int32_t) lttng_counter_saturate_add(old, v, S32_MIN, S32_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int32_t) ((uint32_t) old + (uint32_t) v);
+				}
 				res = cmpxchg(int_p, old, n);
 			} while (old != res);
 			break;
@@ -166,6 +214,8 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		default:
 			return -EINVAL;
 		}
+		if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE)
+			break;
 		if (v > 0 && (v >= U32_MAX || n < old))
 			overflow = true;
 		else if (v < 0 && (v <= -(s64) U32_MAX || n > old))
@@ -186,7 +236,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 			do {
 				move_sum = 0;
 				old = res;
-				n = (int64_t) ((uint64_t) old + (uint64_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int64_t) lttng_counter_saturate_add(old, v, S64_MIN, S64_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int64_t) ((uint64_t) old + (uint64_t) v);
+				}
 				if (unlikely(n > (int64_t) global_sum_step))
 					move_sum = (int64_t) global_sum_step / 2;
 				else if (unlikely(n < -(int64_t) global_sum_step))
@@ -200,7 +257,14 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		{
 			do {
 				old = res;
-				n = (int64_t) ((uint64_t) old + (uint64_t) v);
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+					overflow = false;
+					underflow = false;
+					n = (int64_t) lttng_counter_saturate_add(old, v, S64_MIN, S64_MAX,
+							&overflow, &underflow);
+				} else {
+					n = (int64_t) ((uint64_t) old + (uint64_t) v);
+				}
 				res = cmpxchg(int_p, old, n);
 			} while (old != res);
 			break;
@@ -208,6 +272,8 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 		default:
 			return -EINVAL;
 		}
+		if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE)
+			break;
 		if (v > 0 && n < old)
 			overflow = true;
 		else if (v < 0 && n > old)
@@ -227,6 +293,39 @@ static __always_inline int __lttng_counter_add(const struct lib_counter_config *
 	return 0;
 }
 
+/*
+ * Narrow per-cpu counters stay within [-global_sum_step, global_sum_step]
+ * as long as each increment is at most global_sum_step / 2 in magnitude.
+ * Larger increments could wrap or saturate the per-cpu counter before it
+ * spills, so they are added to the wide global counter directly.
+ */
+static __always_inline bool lttng_counter_add_is_wide(const struct lib_counter_config *config,
+				     struct lib_counter *counter, int64_t v)
+{
+	uint64_t step, max, abs_v;
+
+	if (!config->wide_global)
+		return false;
+	switch (config->counter_size) {
+	case COUNTER_SIZE_8_BIT:
+		step = counter->global_sum_step.s8;
+		max = S8_MAX;
+		break;
+	case COUNTER_SIZE_16_BIT:
+		step = counter->global_sum_step.s16;
+		max = S16_MAX;
+		break;
+	case COUNTER_SIZE_32_BIT:
+		step = counter->global_sum_step.s32;
+		max = S32_MAX;
+		break;
+	default:
+		return false;
+	}
+	abs_v = v < 0 ? -(uint64_t) v : (uint64_t) v;
+	return abs_v > step / 2 || abs_v > max - step;
+}
+
 static __always_inline int __lttng_counter_add_percpu(const struct lib_counter_config *config,
 				     struct lib_counter *counter,
 				     const size_t *dimension_indexes, int64_t v)
@@ -234,6 +333,9 @@ static __always_inline int __lttng_counter_add_percpu(const struct lib_counter_c
 	int64_t move_sum;
 	int ret;
 
+	if (unlikely(lttng_counter_add_is_wide(config, counter, v)))
+		return __lttng_counter_add(config, COUNTER_ALLOC_GLOBAL, COUNTER_SYNC_GLOBAL,
+					   counter, dimension_indexes, v, NULL);
 	ret = __lttng_counter_add(config, COUNTER_ALLOC_PER_CPU, config->sync,
 				       counter, dimension_indexes, v, &move_sum);
 	if (unlikely(ret))
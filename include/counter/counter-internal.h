@@ -44,4 +44,42 @@ static inline size_t lttng_counter_get_index(const struct lib_counter_config *co
 	return index;
 }
 
+/*
+ * Size of the counters of the global layout if @global, else of the
+ * per-cpu layouts.
+ */
+static inline size_t lttng_counter_layout_counter_size(const struct lib_counter_config *config,
+						       bool global)
+{
+	if (global && config->wide_global)
+		return COUNTER_SIZE_64_BIT;
+	return config->counter_size;
+}
+
+/*
+ * Saturating addition of @v to @old within [@min, @max]. Using unsigned
+ * arithmetic because overflow is defined.
+ */
+static __always_inline int64_t lttng_counter_saturate_add(int64_t old, int64_t v,
+							  int64_t min, int64_t max,
+							  bool *overflow, bool *underflow)
+{
+	int64_t n = (int64_t) ((uint64_t) old + (uint64_t) v);
+
+	if (unlikely(v > 0 && n < old)) {
+		*overflow = true;
+		return max;
+	} else if (unlikely(v < 0 && n > old)) {
+		*underflow = true;
+		return min;
+	} else if (unlikely(n > max)) {
+		*overflow = true;
+		return max;
+	} else if (unlikely(n < min)) {
+		*underflow = true;
+		return min;
+	}
+	return n;
+}
+
 #endif /* _LTTNG_COUNTER_INTERNAL_H */
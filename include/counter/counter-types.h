@@ -12,7 +12,11 @@
 
 #include <linux/types.h>
 #include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/mutex.h>
 #include <counter/config.h>
+#include <lttng/kernel-version.h>
+#include <lttng/cpuhotplug.h>
 
 struct lib_counter_dimension {
 	/*
@@ -61,6 +65,12 @@ struct lib_counter {
 
 	struct lib_counter_layout global_counters;
 	struct lib_counter_layout __percpu *percpu_counters;
+	cpumask_var_t cpumask;			/* Per-cpu layouts holding counts */
+
+	struct mutex alloc_lock;		/* Per-cpu layouts allocation */
+#if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0))
+	struct lttng_cpuhp_node cpuhp_prepare;
+#endif
 };
 
 #endif /* _LTTNG_COUNTER_TYPES_H */
@@ -15,6 +15,8 @@
 #include <counter/config.h>
 #include <counter/counter-types.h>
 
+struct page;
+
 /* max_nr_elem is for each dimension. */
 struct lib_counter *lttng_counter_create(const struct lib_counter_config *config,
 					 size_t nr_dimensions,
@@ -43,4 +45,22 @@ int lttng_counter_clear(const struct lib_counter_config *config,
 			struct lib_counter *counter,
 			const size_t *dimension_indexes);
 
+int lttng_counter_get_slice(const struct lib_counter_config *config,
+			    struct lib_counter *counter,
+			    size_t nr_indexes,
+			    const size_t *dimension_indexes,
+			    size_t *index, size_t *nr_elem);
+int lttng_counter_aggregate_range(const struct lib_counter_config *config,
+				  struct lib_counter *counter,
+				  size_t index, size_t nr_elem,
+				  int64_t *values,
+				  uint64_t *overflow_bitmap,
+				  uint64_t *underflow_bitmap);
+
+size_t lttng_counter_get_mmap_len(const struct lib_counter_config *config,
+				  struct lib_counter *counter);
+struct page *lttng_counter_get_page(const struct lib_counter_config *config,
+				    struct lib_counter *counter,
+				    int cpu, unsigned long offset);
+
 #endif /* _LTTNG_COUNTER_H */
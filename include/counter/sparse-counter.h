@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * counter/sparse-counter.h
+ *
+ * LTTng Sparse Counters API
+ *
+ * Sparse counters are keyed by tuples of 64-bit integers rather than
+ * indexed by dense dimensions. Each cpu owns a fixed-size open-addressing
+ * hash table, preallocated at creation, so adding to a counter never
+ * allocates and is safe from NMI and tracepoint context.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#ifndef _LTTNG_SPARSE_COUNTER_H
+#define _LTTNG_SPARSE_COUNTER_H
+
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/atomic.h>
+#include <asm/local64.h>
+
+#define LIB_SPARSE_COUNTER_KEY_MAX	4
+/* Number of entries probed for a key before giving up. */
+#define LIB_SPARSE_COUNTER_MAX_PROBE	16
+
+enum lib_sparse_counter_entry_state {
+	LIB_SPARSE_COUNTER_ENTRY_EMPTY = 0,
+	LIB_SPARSE_COUNTER_ENTRY_BUSY,		/* Key being written by its cpu. */
+	LIB_SPARSE_COUNTER_ENTRY_USED,
+};
+
+struct lib_sparse_counter_entry {
+	unsigned long state;		/* enum lib_sparse_counter_entry_state */
+	local64_t value;
+	uint64_t key[LIB_SPARSE_COUNTER_KEY_MAX];
+};
+
+struct lib_sparse_counter_table {
+	struct lib_sparse_counter_entry *entries;
+	/* Sum of the values added to keys which found no entry. */
+	atomic64_t overflow;
+};
+
+struct lib_sparse_counter {
+	size_t key_len;			/* Number of 64-bit integers per key */
+	size_t nr_entries;		/* Per-cpu table size, power of two */
+	struct lib_sparse_counter_table __percpu *tables;
+};
+
+struct lib_sparse_counter *lttng_sparse_counter_create(size_t key_len,
+						       size_t nr_entries);
+void lttng_sparse_counter_destroy(struct lib_sparse_counter *counter);
+
+void lttng_sparse_counter_add(struct lib_sparse_counter *counter,
+			      const uint64_t *key, int64_t v);
+
+/*
+ * Iterate on the entries of all cpus. Starting at position *@pos, read
+ * the next used entry and update *@pos past it. Returns -ENOENT at the
+ * end of the iteration.
+ */
+int lttng_sparse_counter_read_next(struct lib_sparse_counter *counter,
+				   uint64_t *pos, uint64_t *key,
+				   int *cpu, int64_t *value);
+int64_t lttng_sparse_counter_read_overflow(struct lib_sparse_counter *counter);
+void lttng_sparse_counter_clear(struct lib_sparse_counter *counter);
+
+#endif /* _LTTNG_SPARSE_COUNTER_H */
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lttng_clock
+
+#if !defined(LTTNG_TRACE_LTTNG_CLOCK_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_LTTNG_CLOCK_H
+
+#include <lttng/tracepoint-event.h>
+#include <linux/types.h>
+
+LTTNG_TRACEPOINT_EVENT(lttng_clock_correlation,
+	TP_PROTO(int cpu, u64 cycles, u64 monotonic, u64 realtime),
+	TP_ARGS(cpu, cycles, monotonic, realtime),
+	TP_FIELDS(
+		ctf_integer(int, cpu_id, cpu)
+		ctf_integer(u64, cycles, cycles)
+		ctf_integer(u64, monotonic, monotonic)
+		ctf_integer(u64, realtime, realtime)
+	)
+)
+
+#endif /* LTTNG_TRACE_LTTNG_CLOCK_H */
+
+/* This part must be outside protection */
+#include <lttng/define_trace.h>
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lttng_counter_snapshot
+
+#if !defined(LTTNG_TRACE_LTTNG_COUNTER_SNAPSHOT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_LTTNG_COUNTER_SNAPSHOT_H
+
+#include <lttng/tracepoint-event.h>
+#include <linux/types.h>
+
+LTTNG_TRACEPOINT_EVENT(lttng_counter_snapshot_delta,
+	TP_PROTO(struct lttng_kernel_session *session,
+		uint64_t id, uint64_t index, int64_t delta),
+	TP_ARGS(session, id, index, delta),
+	TP_FIELDS(
+		ctf_integer(uint64_t, id, id)
+		ctf_integer(uint64_t, index, index)
+		ctf_integer(int64_t, delta, delta)
+	)
+)
+
+#endif /* LTTNG_TRACE_LTTNG_COUNTER_SNAPSHOT_H */
+
+/* This part must be outside protection */
+#include <lttng/define_trace.h>
@@ -53,6 +53,26 @@ enum lttng_kernel_abi_output {
  * LTTng DebugFS ABI structures.
  */
 #define LTTNG_KERNEL_ABI_CHANNEL_PADDING	LTTNG_KERNEL_ABI_SYM_NAME_LEN + 32
+
+/*
+ * Allocate a standby sub-buffer set for each buffer of an overwrite mode
+ * channel, allowing frozen snapshots to be taken while writers keep tracing.
+ * Doubles the channel memory footprint.
+ */
+#define LTTNG_KERNEL_ABI_CHANNEL_FLAG_SNAPSHOT_STANDBY	(1U << 0)
+/*
+ * Make compressed packets available through
+ * LTTNG_KERNEL_ABI_RING_BUFFER_GET_COMPRESSED_SUBBUF. At most one compression
+ * flag can be set.
+ */
+#define LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_LZ4	(1U << 1)
+#define LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_ZSTD	(1U << 2)
+/*
+ * Use the packed event header: byte-aligned, with the timestamp written on
+ * as few bytes as its delta from the previous event requires.
+ */
+#define LTTNG_KERNEL_ABI_CHANNEL_FLAG_PACKED_HEADER	(1U << 3)
+
 struct lttng_kernel_abi_channel {
 	uint64_t subbuf_size;			/* in bytes */
 	uint64_t num_subbuf;
@@ -60,7 +80,8 @@ struct lttng_kernel_abi_channel {
 	unsigned int read_timer_interval;	/* usecs */
 	uint32_t output;			/* enum lttng_kernel_abi_output (splice, mmap) */
 	int overwrite;				/* 1: overwrite, 0: discard */
-	char padding[LTTNG_KERNEL_ABI_CHANNEL_PADDING];
+	uint32_t flags;				/* LTTNG_KERNEL_ABI_CHANNEL_FLAG_* */
+	char padding[LTTNG_KERNEL_ABI_CHANNEL_PADDING - sizeof(uint32_t)];
 } __attribute__((packed));
 
 enum lttng_kernel_abi_kretprobe_entryexit {
@@ -105,6 +126,24 @@ struct lttng_kernel_abi_event_callsite {
 	} u;
 } __attribute__((packed));
 
+/*
+ * Sampling and rate limit policy of the events recorded by an enabler,
+ * applied per event and cpu before filters are evaluated. An occurrence
+ * is recorded only if it is a multiple of @sample_period on its cpu, and
+ * if less than @max_rate occurrences of the event were recorded on its
+ * cpu within the last second. Zero disables the respective policy.
+ * Unless @suppressed_counter_fd is -1, suppressed occurrences are counted
+ * in the element @suppressed_counter_index of this one-dimension counter.
+ */
+#define LTTNG_KERNEL_ABI_EVENT_RATE_POLICY_PADDING	32
+struct lttng_kernel_abi_event_rate_policy {
+	uint32_t sample_period;
+	uint32_t max_rate;			/* events per second, per cpu */
+	int32_t suppressed_counter_fd;
+	uint64_t suppressed_counter_index;
+	char padding[LTTNG_KERNEL_ABI_EVENT_RATE_POLICY_PADDING];
+} __attribute__((packed));
+
 enum lttng_kernel_abi_syscall_entryexit {
 	LTTNG_KERNEL_ABI_SYSCALL_ENTRYEXIT	= 0,
 	LTTNG_KERNEL_ABI_SYSCALL_ENTRY	= 1,
@@ -152,23 +191,78 @@ struct lttng_kernel_abi_event {
 	} u;
 } __attribute__((packed));
 
-#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_PADDING	32
+#define LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX	4
+
+enum lttng_kernel_abi_event_notifier_action {
+	LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_NOTIFY		= 0,
+	LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_COUNTER_INCREMENT	= 1,
+	LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_START	= 2,
+	LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_STOP	= 3,
+};
+
+/*
+ * Mapping of a counter key to an index within its counter dimension.
+ * Direct keys are integers used as index, out of range keys are
+ * dropped. Hashed keys (integers or strings) are mapped on the whole
+ * dimension, colliding keys share their bucket.
+ *
+ * Log2 and log-linear keys are integers mapped to histogram buckets.
+ * Log2 bucket 0 holds values below 1, and bucket n holds values within
+ * [2^(n-1), 2^n). Log-linear (HDR) buckets split each power of two
+ * range in LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS linear
+ * sub-buckets. Values beyond the last bucket are accounted in it.
+ */
+enum lttng_kernel_abi_counter_key_mode {
+	LTTNG_KERNEL_ABI_COUNTER_KEY_DIRECT	= 0,
+	LTTNG_KERNEL_ABI_COUNTER_KEY_HASH	= 1,
+	LTTNG_KERNEL_ABI_COUNTER_KEY_LOG2	= 2,
+	LTTNG_KERNEL_ABI_COUNTER_KEY_LOG_LINEAR	= 3,
+};
+
+#define LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS_ORDER	4
+#define LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS		(1U << LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS_ORDER)
+
+/*
+ * Counter increment actions add to the aggregation map counter
+ * @counter_fd, created with LTTNG_KERNEL_ABI_COUNTER_MAP on the same event
+ * notifier group. The first captures of the event notifier are the keys,
+ * one per map dimension. An optional extra capture is the value added,
+ * which is 1 otherwise.
+ *
+ * Timestamp start and stop actions histogram the latency between two
+ * events in the aggregation map @counter_fd. The first capture of both
+ * actions is the integer key pairing them, e.g. a thread ID. The start
+ * action saves the current time for the key. The stop action consumes
+ * it and increments the map element keyed by its following captures,
+ * one per map dimension but the last, and by the latency in nanoseconds
+ * for the last dimension. Stop actions without a saved start time are
+ * ignored.
+ */
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_PADDING	20
 struct lttng_kernel_abi_event_notifier {
 	struct lttng_kernel_abi_event event;
 	uint64_t error_counter_index;
+	uint32_t action;		/* enum lttng_kernel_abi_event_notifier_action */
+	int32_t counter_fd;		/* Aggregation map, for counter increment actions */
+	uint8_t key_mode[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];	/* enum lttng_kernel_abi_counter_key_mode */
 
 	char padding[LTTNG_KERNEL_ABI_EVENT_NOTIFIER_PADDING];
 } __attribute__((packed));
 
-#define LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX	4
-
 enum lttng_kernel_abi_counter_arithmetic {
 	LTTNG_KERNEL_ABI_COUNTER_ARITHMETIC_MODULAR = 0,
+	LTTNG_KERNEL_ABI_COUNTER_ARITHMETIC_SATURATE = 1,
 };
 
+/*
+ * Per-cpu counter bitness. With a non-zero global_sum_step, 16-bit and
+ * 32-bit per-cpu counters spill into 64-bit global counters whenever
+ * they exceed the step; 16-bit counters require a global sum step.
+ */
 enum lttng_kernel_abi_counter_bitness {
 	LTTNG_KERNEL_ABI_COUNTER_BITNESS_32 = 0,
 	LTTNG_KERNEL_ABI_COUNTER_BITNESS_64 = 1,
+	LTTNG_KERNEL_ABI_COUNTER_BITNESS_16 = 2,
 };
 
 struct lttng_kernel_abi_counter_dimension {
@@ -179,7 +273,23 @@ struct lttng_kernel_abi_counter_dimension {
 	uint8_t has_overflow;
 } __attribute__((packed));
 
-#define LTTNG_KERNEL_ABI_COUNTER_CONF_PADDING1	67
+/*
+ * Aggregation maps with a non-zero @sparse_nr_entries are sparse: rather
+ * than dense dimensions, each cpu holds a hash table of
+ * @sparse_nr_entries entries (a power of two, at most
+ * LTTNG_KERNEL_ABI_COUNTER_SPARSE_MAX_ENTRIES) keyed by the tuple of the
+ * @number_dimensions keys. Integer keys are used as is, or bucketed by
+ * histogram key modes, and string keys are hashed. Dimension sizes are
+ * ignored. Sparse maps are 64-bit modular without global sum step.
+ *
+ * Keys are never evicted. Keys which find no entry in a full or crowded
+ * table are accounted in the map overflow. Sparse maps are read with
+ * LTTNG_KERNEL_ABI_COUNTER_SPARSE_READ, and cleared as a whole with
+ * LTTNG_KERNEL_ABI_COUNTER_CLEAR.
+ */
+#define LTTNG_KERNEL_ABI_COUNTER_SPARSE_MAX_ENTRIES	(1U << 20)
+
+#define LTTNG_KERNEL_ABI_COUNTER_CONF_PADDING1	63
 struct lttng_kernel_abi_counter_conf {
 	uint32_t arithmetic;	/* enum lttng_kernel_abi_counter_arithmetic */
 	uint32_t bitness;	/* enum lttng_kernel_abi_counter_bitness */
@@ -187,6 +297,7 @@ struct lttng_kernel_abi_counter_conf {
 	int64_t global_sum_step;
 	struct lttng_kernel_abi_counter_dimension dimensions[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
 	uint8_t coalesce_hits;
+	uint32_t sparse_nr_entries;	/* Sparse aggregation maps, 0 for dense */
 	char padding[LTTNG_KERNEL_ABI_COUNTER_CONF_PADDING1];
 } __attribute__((packed));
 
@@ -222,13 +333,148 @@ struct lttng_kernel_abi_counter_clear {
 	char padding[LTTNG_KERNEL_ABI_COUNTER_CLEAR_PADDING];
 } __attribute__((packed));
 
-#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_NOTIFICATION_PADDING 32
+/*
+ * Aggregate a slice of a counter over all cpus in a single call. The
+ * slice holds the elements sharing the leading dimension indexes of
+ * @index, the whole counter when @index.number_dimensions is 0, in
+ * row-major order. @values points to an array of @nr_elem int64_t.
+ * @overflow and @underflow optionally point to arrays of uint64_t
+ * holding one bit per element: bit (i % 64) of word (i / 64) for
+ * element i. On return, @nr_elem holds the number of elements of the
+ * slice. -ENOSPC is returned if it exceeds the array length.
+ */
+#define LTTNG_KERNEL_ABI_COUNTER_SNAPSHOT_PADDING 32
+struct lttng_kernel_abi_counter_snapshot {
+	struct lttng_kernel_abi_counter_index index;
+	uint64_t values;	/* int64_t array (user pointer) */
+	uint64_t overflow;	/* Optional uint64_t bitmap (user pointer) */
+	uint64_t underflow;	/* Optional uint64_t bitmap (user pointer) */
+	uint64_t nr_elem;	/* input: array length, output: slice length */
+	char padding[LTTNG_KERNEL_ABI_COUNTER_SNAPSHOT_PADDING];
+} __attribute__((packed));
+
+/*
+ * Layout of the read-only mapping of a counter fd. The counter array of
+ * each of the @nr_cpus possible cpus is mapped in cpu number order,
+ * @cpu_stride bytes apart, followed by the array holding the counts
+ * folded from offline cpus. The mapping is thus (@nr_cpus + 1) *
+ * @cpu_stride bytes long. Elements are in row-major order, their size
+ * is given by the counter bitness. All arrays are summed to aggregate
+ * the counter. Counters created with a global sum step cannot
+ * be mapped, and report a zero @cpu_stride.
+ */
+#define LTTNG_KERNEL_ABI_COUNTER_MMAP_INFO_PADDING 32
+struct lttng_kernel_abi_counter_mmap_info {
+	uint64_t cpu_stride;
+	uint32_t nr_cpus;
+	char padding[LTTNG_KERNEL_ABI_COUNTER_MMAP_INFO_PADDING];
+} __attribute__((packed));
+
+struct lttng_kernel_abi_counter_sparse_entry {
+	uint64_t key[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+	int64_t value;
+	int32_t cpu;
+} __attribute__((packed));
+
+/*
+ * Read the entries of a sparse aggregation map in bulk. Iteration starts
+ * with a zero @pos, which is updated to resume the next read. At most
+ * @nr_entries entries are copied to the @entries array, and @nr_entries
+ * is set to the number of entries copied. The iteration is complete when
+ * fewer entries than requested are returned.
+ *
+ * Entries are per cpu and a key may be returned more than once, even for
+ * a given cpu: the values of equal keys are summed to aggregate the map.
+ * @overflow is the sum of the values of keys which did not fit.
+ */
+#define LTTNG_KERNEL_ABI_COUNTER_SPARSE_READ_PADDING 32
+struct lttng_kernel_abi_counter_sparse_read {
+	uint64_t pos;		/* input/output: iteration position */
+	uint64_t entries;	/* struct lttng_kernel_abi_counter_sparse_entry array (user pointer) */
+	uint64_t nr_entries;	/* input: array length, output: entries read */
+	int64_t overflow;	/* output */
+	char padding[LTTNG_KERNEL_ABI_COUNTER_SPARSE_READ_PADDING];
+} __attribute__((packed));
+
+/*
+ * @coalesced is the number of firings of the event notifier since its
+ * previous notification which were coalesced or rate limited, and are
+ * reported by this notification in addition to the firing it holds the
+ * captures of.
+ */
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_NOTIFICATION_PADDING 28
 struct lttng_kernel_abi_event_notifier_notification {
 	uint64_t token;
 	uint16_t capture_buf_size;
+	uint32_t coalesced;
 	char padding[LTTNG_KERNEL_ABI_EVENT_NOTIFIER_NOTIFICATION_PADDING];
 } __attribute__((packed));
 
+/*
+ * Rate policy of the notifications of the event notifiers of an enabler
+ * with the notify action, applied before captures are evaluated. A firing
+ * is notified only if:
+ * - it is the first of a batch of @coalesce firings, when @coalesce is
+ *   above 1,
+ * - at least @min_interval nanoseconds elapsed since the previous
+ *   notification,
+ * - a token is available in a bucket of @bucket_burst tokens refilled at
+ *   @bucket_rate tokens per second, when @bucket_rate is non-zero.
+ * Firings which are not notified are counted in the @coalesced field of
+ * the next notification, rather than in the error counter. If no firing
+ * is notified within the longest of @min_interval, the token refill period
+ * and 100 ms, a notification with empty captures is sent to report them,
+ * once the interval and the bucket allow it.
+ */
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_RATE_POLICY_PADDING	32
+struct lttng_kernel_abi_event_notifier_rate_policy {
+	uint64_t min_interval;			/* in nsecs, 0: none */
+	uint32_t bucket_rate;			/* tokens per second, 0: no bucket */
+	uint32_t bucket_burst;			/* bucket size, at least 1 */
+	uint32_t coalesce;			/* firings per notification */
+	char padding[LTTNG_KERNEL_ABI_EVENT_NOTIFIER_RATE_POLICY_PADDING];
+} __attribute__((packed));
+
+/*
+ * Stage notifications in per-CPU buffers and publish them to the group
+ * ring buffer in batches. Notifications produced on a given CPU are
+ * published in reservation order; there is no ordering guarantee across
+ * CPUs.
+ */
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING	(1U << 0)
+/*
+ * Write notifications into one ring buffer per CPU rather than into a
+ * single global ring buffer. Each LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_NOTIFICATION_FD
+ * ioctl then returns the notification file descriptor of the next CPU
+ * buffer, and fails with -ENOENT once all of them are open. Notifications
+ * produced on a given CPU are read from its file descriptor in the order
+ * they were produced; there is no ordering guarantee across file
+ * descriptors. Exclusive with LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING.
+ * The notifications of several file descriptors can be merged in timestamp
+ * order and read from their mmap area with
+ * LTTNG_KERNEL_ABI_RING_BUFFER_GET_NEXT_RECORDS instead of read(); both
+ * must not be mixed on a file descriptor.
+ */
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_PER_CPU	(1U << 1)
+
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CONF_PADDING 32
+struct lttng_kernel_abi_event_notifier_group_conf {
+	uint32_t flags;				/* LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_* */
+	uint32_t staging_flush_interval;	/* Staging flush period, in usecs. 0 for default. */
+	char padding[LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CONF_PADDING];
+} __attribute__((packed));
+
+/*
+ * Hot event hint for a channel. Hinted events are given the event IDs
+ * fitting in the compact event header, in hint order, and every other
+ * event of the channel uses the extended ID escape.
+ */
+#define LTTNG_KERNEL_ABI_HOT_EVENT_PADDING	32
+struct lttng_kernel_abi_hot_event {
+	char name[LTTNG_KERNEL_ABI_SYM_NAME_LEN];	/* Event name */
+	char padding[LTTNG_KERNEL_ABI_HOT_EVENT_PADDING];
+} __attribute__((packed));
+
 struct lttng_kernel_abi_tracer_version {
 	uint32_t major;
 	uint32_t minor;
@@ -248,6 +494,35 @@ struct lttng_kernel_abi_session_creation_time {
 	char iso8601[LTTNG_KERNEL_ABI_SESSION_CREATION_TIME_ISO8601_LEN];
 } __attribute__((packed));
 
+enum lttng_kernel_abi_metadata_format {
+	LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_1_8	= 0,	/* TSDL */
+	LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2		= 1,	/* JSON text sequence */
+};
+
+#define LTTNG_KERNEL_ABI_SESSION_METADATA_FORMAT_PADDING	32
+struct lttng_kernel_abi_session_metadata_format {
+	uint32_t format;			/* enum lttng_kernel_abi_metadata_format */
+	char padding[LTTNG_KERNEL_ABI_SESSION_METADATA_FORMAT_PADDING];
+} __attribute__((packed));
+
+/*
+ * Periodically record the changes of the counter @counter_fd, an
+ * aggregation map or error counter, as lttng_counter_snapshot_delta
+ * events of the session. Each event holds @id, the index of a counter
+ * element in row-major order and its change since the previous snapshot.
+ * Only changed elements are recorded, by the session channels where the
+ * event is enabled. Snapshots are taken every @period microseconds while
+ * the session is active, and when it stops. Sparse maps are not
+ * supported.
+ */
+#define LTTNG_KERNEL_ABI_SESSION_COUNTER_SNAPSHOT_PADDING	32
+struct lttng_kernel_abi_session_counter_snapshot {
+	int32_t counter_fd;
+	uint32_t period;			/* in usecs */
+	uint64_t id;
+	char padding[LTTNG_KERNEL_ABI_SESSION_COUNTER_SNAPSHOT_PADDING];
+} __attribute__((packed));
+
 enum lttng_kernel_abi_calibrate_type {
 	LTTNG_KERNEL_ABI_CALIBRATE_KRETPROBE,
 };
@@ -365,6 +640,8 @@ struct lttng_kernel_abi_tracker_args {
 #define LTTNG_KERNEL_ABI_TRACER_ABI_VERSION		\
 	_IOR(0xF6, 0x4B, struct lttng_kernel_abi_tracer_abi_version)
 #define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CREATE    _IO(0xF6, 0x4C)
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CREATE_EXT	\
+	_IOW(0xF6, 0x4D, struct lttng_kernel_abi_event_notifier_group_conf)
 
 /* Session FD ioctl */
 /* lttng/abi-old.h reserve 0x50, 0x51, 0x52, and 0x53. */
@@ -393,6 +670,8 @@ struct lttng_kernel_abi_tracker_args {
 	_IOW(0xF6, 0x5D, struct lttng_kernel_abi_session_name)
 #define LTTNG_KERNEL_ABI_SESSION_SET_CREATION_TIME		\
 	_IOW(0xF6, 0x5E, struct lttng_kernel_abi_session_creation_time)
+#define LTTNG_KERNEL_ABI_SESSION_SET_METADATA_FORMAT	\
+	_IOW(0xF6, 0x5F, struct lttng_kernel_abi_session_metadata_format)
 
 /* Channel FD ioctl */
 /* lttng/abi-old.h reserve 0x60 and 0x61. */
@@ -401,6 +680,8 @@ struct lttng_kernel_abi_tracker_args {
 	_IOW(0xF6, 0x63, struct lttng_kernel_abi_event)
 #define LTTNG_KERNEL_ABI_SYSCALL_MASK		\
 	_IOWR(0xF6, 0x64, struct lttng_kernel_abi_syscall_mask)
+#define LTTNG_KERNEL_ABI_CHANNEL_HOT_EVENT		\
+	_IOW(0xF6, 0x65, struct lttng_kernel_abi_hot_event)
 
 /* Event and Channel FD ioctl */
 /* lttng/abi-old.h reserve 0x70. */
@@ -419,6 +700,10 @@ struct lttng_kernel_abi_tracker_args {
 /* Event and Event notifier FD ioctl */
 #define LTTNG_KERNEL_ABI_FILTER			_IO(0xF6, 0x90)
 #define LTTNG_KERNEL_ABI_ADD_CALLSITE		_IO(0xF6, 0x91)
+#define LTTNG_KERNEL_ABI_EVENT_RATE_POLICY	\
+	_IOW(0xF6, 0x92, struct lttng_kernel_abi_event_rate_policy)
+#define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_RATE_POLICY	\
+	_IOW(0xF6, 0x93, struct lttng_kernel_abi_event_notifier_rate_policy)
 
 /* Session FD ioctl (continued) */
 #define LTTNG_KERNEL_ABI_SESSION_LIST_TRACKER_IDS	\
@@ -427,12 +712,16 @@ struct lttng_kernel_abi_tracker_args {
 	_IOW(0xF6, 0xA1, struct lttng_kernel_abi_tracker_args)
 #define LTTNG_KERNEL_ABI_SESSION_UNTRACK_ID		\
 	_IOW(0xF6, 0xA2, struct lttng_kernel_abi_tracker_args)
+#define LTTNG_KERNEL_ABI_SESSION_COUNTER_SNAPSHOT	\
+	_IOW(0xF6, 0xA3, struct lttng_kernel_abi_session_counter_snapshot)
 
 /* Event notifier group file descriptor ioctl */
 #define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_CREATE \
 	_IOW(0xF6, 0xB0, struct lttng_kernel_abi_event_notifier)
 #define LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_NOTIFICATION_FD \
 	_IO(0xF6, 0xB1)
+#define LTTNG_KERNEL_ABI_COUNTER_MAP \
+	_IOW(0xF6, 0xB2, struct lttng_kernel_abi_counter_conf)
 
 /* Event notifier file descriptor ioctl */
 #define LTTNG_KERNEL_ABI_CAPTURE			_IO(0xF6, 0xB8)
@@ -444,7 +733,37 @@ struct lttng_kernel_abi_tracker_args {
 	_IOWR(0xF6, 0xC1, struct lttng_kernel_abi_counter_aggregate)
 #define LTTNG_KERNEL_ABI_COUNTER_CLEAR \
 	_IOW(0xF6, 0xC2, struct lttng_kernel_abi_counter_clear)
+#define LTTNG_KERNEL_ABI_COUNTER_SNAPSHOT \
+	_IOWR(0xF6, 0xC3, struct lttng_kernel_abi_counter_snapshot)
+#define LTTNG_KERNEL_ABI_COUNTER_MMAP_INFO \
+	_IOR(0xF6, 0xC4, struct lttng_kernel_abi_counter_mmap_info)
+#define LTTNG_KERNEL_ABI_COUNTER_SPARSE_READ \
+	_IOWR(0xF6, 0xC5, struct lttng_kernel_abi_counter_sparse_read)
+
+enum lttng_kernel_abi_compression {
+	LTTNG_KERNEL_ABI_COMPRESSION_NONE	= 0,
+	LTTNG_KERNEL_ABI_COMPRESSION_LZ4	= 1,
+	LTTNG_KERNEL_ABI_COMPRESSION_ZSTD	= 2,
+};
+
+#define LTTNG_KERNEL_ABI_COMPRESSED_PACKET_MAGIC	0x4C54435AU	/* "LTCZ" */
 
+/*
+ * Header preceding each compressed packet. The payload is stored
+ * uncompressed (LTTNG_KERNEL_ABI_COMPRESSION_NONE) when compression does not
+ * reduce its size.
+ */
+struct lttng_kernel_abi_compressed_packet_header {
+	uint32_t magic;				/* LTTNG_KERNEL_ABI_COMPRESSED_PACKET_MAGIC */
+	uint32_t format;			/* enum lttng_kernel_abi_compression */
+	uint64_t compressed_size;		/* payload size, in bytes */
+	uint64_t uncompressed_size;		/* sub-buffer data size, in bytes */
+} __attribute__((packed));
+
+struct lttng_kernel_abi_compressed_subbuf {
+	uint64_t addr;				/* user-space destination */
+	uint64_t len;				/* in: destination size, out: packet size */
+} __attribute__((packed));
 
 /*
  * LTTng-specific ioctls for the lib ringbuffer.
@@ -471,6 +790,9 @@ struct lttng_kernel_abi_tracker_args {
 #define LTTNG_KERNEL_ABI_RING_BUFFER_GET_SEQ_NUM		_IOR(0xF6, 0x27, uint64_t)
 /* returns the stream instance id (invariant for the stream) */
 #define LTTNG_KERNEL_ABI_RING_BUFFER_INSTANCE_ID		_IOR(0xF6, 0x28, uint64_t)
+/* copies the current sub-buffer as a compressed packet */
+#define LTTNG_KERNEL_ABI_RING_BUFFER_GET_COMPRESSED_SUBBUF	\
+	_IOWR(0xF6, 0x29, struct lttng_kernel_abi_compressed_subbuf)
 
 /*
  * Those ioctl numbers use the wrong direction, but are kept for ABI backward
@@ -519,6 +841,9 @@ struct lttng_kernel_abi_tracker_args {
 /* returns the stream instance id (invariant for the stream) */
 #define LTTNG_KERNEL_ABI_RING_BUFFER_COMPAT_INSTANCE_ID	\
 	LTTNG_KERNEL_ABI_RING_BUFFER_INSTANCE_ID
+/* copies the current sub-buffer as a compressed packet */
+#define LTTNG_KERNEL_ABI_RING_BUFFER_COMPAT_GET_COMPRESSED_SUBBUF	\
+	LTTNG_KERNEL_ABI_RING_BUFFER_GET_COMPRESSED_SUBBUF
 #endif /* CONFIG_COMPAT */
 
 #endif /* _LTTNG_ABI_H */
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng/compress.h
+ *
+ * LTTng sub-buffer compression for the consumer read path.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#ifndef LTTNG_COMPRESS_H
+#define LTTNG_COMPRESS_H
+
+#include <lttng/abi.h>
+
+struct lttng_kernel_channel_buffer;
+struct lttng_kernel_ring_buffer;
+struct lttng_channel_compress;
+
+/*
+ * Set up compression of the sub-buffers of @chan with @format. Must be
+ * called after the ring buffer channel is created.
+ *
+ * Returns 0 on success, -ENOENT if the compression algorithm is not
+ * available in the kernel, a negative value on other errors.
+ */
+int lttng_channel_compress_create(struct lttng_kernel_channel_buffer *chan,
+		enum lttng_kernel_abi_compression format);
+
+void lttng_channel_compress_destroy(struct lttng_channel_compress *compress);
+
+/*
+ * Compress the sub-buffer currently held by the reader of @buf and copy the
+ * resulting packet, header included, to the user-space destination
+ * described by @uarg.
+ *
+ * Returns 0 on success, -EINVAL if the channel is not compressed or no
+ * sub-buffer is held, -ENOSPC if the destination is too small, a negative
+ * value on other errors.
+ */
+long lttng_channel_compress_get_subbuf(struct lttng_kernel_channel_buffer *chan,
+		struct lttng_kernel_ring_buffer *buf,
+		struct lttng_kernel_abi_compressed_subbuf __user *uarg);
+
+#endif /* LTTNG_COMPRESS_H */
@@ -19,6 +19,7 @@ enum lttng_cpuhp_component {
 	LTTNG_RING_BUFFER_BACKEND,
 	LTTNG_RING_BUFFER_ITER,
 	LTTNG_CONTEXT_PERF_COUNTERS,
+	LTTNG_COUNTER,
 };
 
 struct lttng_cpuhp_node {
@@ -47,6 +48,16 @@ void lttng_rb_set_hp_online(enum cpuhp_state val);
 extern enum cpuhp_state lttng_rb_hp_prepare;
 extern enum cpuhp_state lttng_rb_hp_online;
 
+int lttng_cpuhp_counter_prepare(unsigned int cpu,
+		struct lttng_cpuhp_node *node);
+int lttng_cpuhp_counter_dead(unsigned int cpu,
+		struct lttng_cpuhp_node *node);
+
+/* Counters are a separate library. */
+void lttng_counter_set_hp_prepare(enum cpuhp_state val);
+
+extern enum cpuhp_state lttng_counter_hp_prepare;
+
 #endif
 
 #endif /* LTTNG_CPUHOTPLUG_H */
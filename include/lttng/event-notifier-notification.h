@@ -10,9 +10,26 @@
 
 #include <lttng/events.h>
 
+struct lttng_event_notifier_rate;
+
 void lttng_event_notifier_notification_send(struct lttng_kernel_event_notifier *event_notifier,
 		const char *stack_data,
 		struct lttng_kernel_probe_ctx *probe_ctx,
 		struct lttng_kernel_notification_ctx *notif_ctx);
+void lttng_event_notifier_rate_init(struct lttng_event_notifier_rate *rate,
+		struct lttng_kernel_event_notifier *event_notifier);
+void lttng_event_notifier_rate_destroy(struct lttng_event_notifier_rate *rate);
+void lttng_event_notifier_counter_increment(struct lttng_kernel_event_notifier *event_notifier,
+		const char *stack_data,
+		struct lttng_kernel_probe_ctx *probe_ctx,
+		struct lttng_kernel_notification_ctx *notif_ctx);
+void lttng_event_notifier_timestamp_start(struct lttng_kernel_event_notifier *event_notifier,
+		const char *stack_data,
+		struct lttng_kernel_probe_ctx *probe_ctx,
+		struct lttng_kernel_notification_ctx *notif_ctx);
+void lttng_event_notifier_timestamp_stop(struct lttng_kernel_event_notifier *event_notifier,
+		const char *stack_data,
+		struct lttng_kernel_probe_ctx *probe_ctx,
+		struct lttng_kernel_notification_ctx *notif_ctx);
 
 #endif /* _LTTNG_EVENT_NOTIFIER_NOTIFICATION_H */
@@ -8,12 +8,16 @@
 #ifndef _LTTNG_EVENTS_INTERNAL_H
 #define _LTTNG_EVENTS_INTERNAL_H
 
+#include <linux/workqueue.h>
+#include <linux/irq_work.h>
+#include <asm/local.h>
 #include <wrapper/compiler_attributes.h>
 
 #include <lttng/events.h>
 
 struct lttng_syscall_filter;
 struct lttng_metadata_cache;
+struct lttng_metadata_fragment;
 struct perf_event;
 struct perf_event_attr;
 struct lttng_kernel_ring_buffer_config;
@@ -116,6 +120,11 @@ struct lttng_kernel_event_notifier_private {
 	size_t num_captures;				/* Needed to allocate the msgpack array. */
 	uint64_t error_counter_index;
 	struct list_head capture_bytecode_runtime_head;
+
+	enum lttng_kernel_abi_event_notifier_action action;
+	struct lttng_counter *counter;			/* Aggregation map, for counter increment actions */
+	uint8_t key_mode[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];	/* enum lttng_kernel_abi_counter_key_mode */
+	struct lttng_event_notifier_rate *rate;		/* Notification rate policy, NULL if none */
 };
 
 struct lttng_kernel_syscall_table {
@@ -153,6 +162,9 @@ struct lttng_kernel_channel_common_private {
 	struct lttng_kernel_syscall_table syscall_table;
 };
 
+/* Event IDs encoded in the compact event header, the next one is the escape. */
+#define LTTNG_COMPACT_EVENT_NR_IDS	31
+
 struct lttng_kernel_channel_buffer_private {
 	struct lttng_kernel_channel_common_private parent;
 
@@ -160,12 +172,23 @@ struct lttng_kernel_channel_buffer_private {
 
 	unsigned int id;			/* Channel ID */
 	unsigned int free_event_id;		/* Next event ID to allocate */
-	int header_type;			/* 0: unset, 1: compact, 2: large */
+	int header_type;			/* 0: unset, 1: compact, 2: large, 3: packed */
+	/*
+	 * Hot events ranked by user hints. When set, the compact header is
+	 * used and hot event i has ID i, other events IDs start at
+	 * LTTNG_COMPACT_EVENT_NR_IDS.
+	 */
+	char (*hot_events)[LTTNG_KERNEL_ABI_SYM_NAME_LEN];
+	unsigned int nr_hot_events;
+	unsigned long hot_events_used;		/* Bitmap of hot event IDs in use */
 
 	enum channel_type channel_type;
 	struct lttng_kernel_ctx *ctx;
 	struct lttng_kernel_ring_buffer_channel *rb_chan;		/* Ring buffer channel */
 	unsigned int metadata_dumped:1;
+	unsigned int snapshot_standby:1;	/* Standby sub-buffers for frozen snapshots */
+	unsigned int packed_header:1;		/* Use the packed event header */
+	struct lttng_channel_compress *compress;	/* Sub-buffer compression, NULL if disabled */
 	struct list_head node;			/* Channel list in session */
 	struct lttng_transport *transport;
 };
@@ -241,9 +264,69 @@ struct lttng_event_enabler_common {
 	bool published;			/* published in list. */
 };
 
+/* Sampling and rate limit policy of the events of a recorder enabler. */
+struct lttng_event_rate_policy {
+	unsigned int sample_period;		/* 0: record every occurrence */
+	unsigned int max_rate;			/* per second and cpu, 0: unlimited */
+	struct file *suppressed_counter_file;	/* NULL if suppressed occurrences are not counted */
+	size_t suppressed_counter_index;
+};
+
 struct lttng_event_recorder_enabler {
 	struct lttng_event_enabler_common parent;
 	struct lttng_kernel_channel_buffer *chan;
+	struct lttng_event_rate_policy *rate_policy;	/* NULL if none */
+};
+
+struct lttng_kernel_event_rate_state {
+	local_t seen;				/* Occurrences, for sampling */
+	local_t window_count;			/* Occurrences recorded in the window */
+	unsigned long window_start;		/* in jiffies */
+};
+
+/*
+ * Sampling and rate limit of an event, copied from the policy of the first
+ * enabler with a policy matching the event. The state is kept per cpu.
+ */
+struct lttng_kernel_event_rate {
+	unsigned int sample_period;
+	unsigned int max_rate;
+	struct lttng_counter *suppressed_counter;
+	size_t suppressed_counter_index;
+	struct lttng_kernel_event_rate_state __percpu *state;
+};
+
+/* Delay before flushing firings which were not notified, at least. */
+#define LTTNG_EVENT_NOTIFIER_RATE_FLUSH_DELAY	(NSEC_PER_SEC / 10)
+
+/*
+ * Notification rate policy of the event notifiers of an enabler. The token
+ * bucket is kept as the theoretical arrival time of the next firing
+ * (GCRA), so that it is updated with a single cmpxchg.
+ */
+struct lttng_event_notifier_rate_policy {
+	uint64_t min_interval;			/* in nsecs, 0: none */
+	uint64_t token_interval;		/* nsecs per token, 0: no bucket */
+	uint64_t bucket_depth;			/* nsecs, token_interval times burst */
+	unsigned int coalesce;			/* firings per notification */
+	unsigned long flush_delay;		/* in jiffies */
+};
+
+/*
+ * Firings which are not notified are reported by the next notification.
+ * If none is sent within the flush delay, a notification without
+ * captures is sent from a worker to report them.
+ */
+struct lttng_event_notifier_rate {
+	struct lttng_event_notifier_rate_policy policy;
+	struct lttng_kernel_event_notifier *event_notifier;
+	atomic_t batch;				/* Firings of the coalesce batches */
+	atomic_t pending;			/* Firings not notified */
+	atomic64_t last;			/* Time of the last notification */
+	atomic64_t bucket_time;			/* Theoretical arrival time */
+	unsigned long flush_armed;		/* Flush of pending firings scheduled */
+	struct irq_work flush_irq_work;
+	struct delayed_work flush_work;
 };
 
 struct lttng_event_notifier_enabler {
@@ -254,6 +337,11 @@ struct lttng_event_notifier_enabler {
 	/* head list of struct lttng_kernel_bytecode_node */
 	struct list_head capture_bytecode_head;
 	uint64_t num_captures;
+
+	enum lttng_kernel_abi_event_notifier_action action;
+	struct lttng_counter *counter;			/* Aggregation map, for counter increment actions */
+	uint8_t key_mode[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];	/* enum lttng_kernel_abi_counter_key_mode */
+	struct lttng_event_notifier_rate_policy *rate_policy;	/* NULL if none */
 };
 
 struct lttng_ctx_value {
@@ -302,23 +390,56 @@ struct lttng_kernel_ctx {
 	size_t largest_align;	/* in bytes */
 };
 
+/*
+ * The metadata cache is a list of page-sized chunks. Each metadata
+ * fragment is formatted directly at the end of the tail chunk, so the
+ * cache is never reallocated nor copied as it grows. The unused end of a
+ * chunk is skipped when a fragment does not fit in it.
+ */
+struct lttng_metadata_cache_chunk {
+	struct list_head node;		/* Chunk list node */
+	unsigned int len;		/* Number of bytes written in chunk */
+	char data[];
+};
+
+#define LTTNG_METADATA_CACHE_CHUNK_SIZE		PAGE_SIZE
+#define LTTNG_METADATA_CACHE_CHUNK_DATA_SIZE	\
+	(LTTNG_METADATA_CACHE_CHUNK_SIZE - offsetof(struct lttng_metadata_cache_chunk, data))
+
+/*
+ * The metadata log holds the metadata cache content of one metadata
+ * version. It is append-only: producers, serialized by the cache lock,
+ * append to its tail chunk and publish the end of each complete metadata
+ * transaction as the coherent watermark. Readers consume up to the
+ * watermark without taking the cache lock. Regenerating the metadata
+ * replaces the log, and the previous log is freed after a RCU grace
+ * period.
+ */
+struct lttng_metadata_log {
+	struct list_head chunks;	/* Metadata cache chunk list, never empty */
+	unsigned int coherent;		/* Bytes published to readers */
+	uint64_t version;		/* Version of the metadata */
+};
+
 struct lttng_metadata_cache {
-	char *data;			/* Metadata cache */
-	unsigned int cache_alloc;	/* Metadata allocated size (bytes) */
-	unsigned int metadata_written;	/* Number of bytes written in metadata cache */
+	struct lttng_metadata_log __rcu *log;	/* Current metadata log */
+	unsigned int metadata_written;	/* Number of bytes written in metadata log */
 	atomic_t producing;		/* Metadata being produced (incomplete) */
 	struct kref refcount;		/* Metadata cache usage */
 	struct list_head metadata_stream;	/* Metadata stream list */
 	uuid_le uuid;			/* Trace session unique ID (copy) */
-	struct mutex lock;		/* Produce/consume lock */
-	uint64_t version;		/* Current version of the metadata */
+	struct mutex lock;		/* Producer and stream list lock */
+	enum lttng_kernel_abi_metadata_format format;	/* Metadata format (copy) */
 };
 
 struct lttng_metadata_stream {
 	void *priv;			/* Ring buffer private data */
 	struct lttng_metadata_cache *metadata_cache;
 	unsigned int metadata_in;	/* Bytes read from the cache */
+	struct lttng_metadata_cache_chunk *chunk_in;	/* Chunk at metadata_in, NULL for log start */
+	unsigned int chunk_in_offset;	/* Offset of metadata_in within chunk_in */
 	unsigned int metadata_out;	/* Bytes consumed from stream */
+	struct mutex lock;		/* Reader lock, protects the stream cursor */
 	int finalized;			/* Has channel been finalized */
 	wait_queue_head_t read_wait;	/* Reader buffer-level wait queue */
 	struct list_head list;		/* Stream list */
@@ -377,6 +498,12 @@ struct lttng_kernel_channel_buffer_ops_private {
 	int (*instance_id) (const struct lttng_kernel_ring_buffer_config *config,
 			struct lttng_kernel_ring_buffer *bufb,
 			uint64_t *id);
+	/*
+	 * select_ops returns the ops specialized for the event header type
+	 * and context of the channel, or NULL to keep the generic ops.
+	 * Optional.
+	 */
+	struct lttng_kernel_channel_buffer_ops *(*select_ops)(struct lttng_kernel_channel_buffer *chan);
 };
 
 struct lttng_counter_ops {
@@ -399,6 +526,20 @@ struct lttng_counter_ops {
 	int (*counter_aggregate)(struct lib_counter *counter, const size_t *dimension_indexes,
 			int64_t *value, bool *overflow, bool *underflow);
 	int (*counter_clear)(struct lib_counter *counter, const size_t *dimension_indexes);
+	/*
+	 * counter_get_slice returns the range of elements sharing the
+	 * @nr_indexes leading dimension indexes, which counter_aggregate_range
+	 * sums over all cpus.
+	 */
+	int (*counter_get_slice)(struct lib_counter *counter, size_t nr_indexes,
+			const size_t *dimension_indexes, size_t *index, size_t *nr_elem);
+	int (*counter_aggregate_range)(struct lib_counter *counter, size_t index,
+			size_t nr_elem, int64_t *values, uint64_t *overflow_bitmap,
+			uint64_t *underflow_bitmap);
+	/* Mapping of the per-cpu counter arrays, read-only, in cpu number order. */
+	size_t (*counter_mmap_len)(struct lib_counter *counter);
+	struct page *(*counter_get_page)(struct lib_counter *counter, int cpu,
+			unsigned long offset);
 };
 
 struct lttng_counter {
@@ -407,6 +548,51 @@ struct lttng_counter {
 	struct lttng_counter_transport *transport;
 	struct lib_counter *counter;
 	struct lttng_counter_ops *ops;
+	size_t nr_dimensions;
+	size_t dimension_sizes[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+	struct list_head node;		/* Event notifier group aggregation map list */
+	struct lttng_counter_timestamp *start_timestamps;	/* Timestamp start/stop actions */
+	struct lib_sparse_counter *sparse;	/* Sparse aggregation maps, NULL for dense counters */
+};
+
+/*
+ * Start timestamps saved by timestamp start actions, in a direct-mapped
+ * table indexed by the hash of the pairing key. The key is stored
+ * encoded: LTTNG_COUNTER_TIMESTAMP_EMPTY and LTTNG_COUNTER_TIMESTAMP_BUSY
+ * are reserved for free and in-update entries.
+ */
+#define LTTNG_COUNTER_TIMESTAMP_TABLE_ORDER	14
+#define LTTNG_COUNTER_TIMESTAMP_TABLE_SIZE	(1UL << LTTNG_COUNTER_TIMESTAMP_TABLE_ORDER)
+#define LTTNG_COUNTER_TIMESTAMP_EMPTY		0UL
+#define LTTNG_COUNTER_TIMESTAMP_BUSY		1UL
+#define LTTNG_COUNTER_TIMESTAMP_KEY_BIAS	2UL
+
+struct lttng_counter_timestamp {
+	unsigned long key;
+	u64 timestamp;
+};
+
+/* Number of counter elements aggregated at once by counter snapshots. */
+#define LTTNG_COUNTER_SNAPSHOT_TIMER_CHUNK	512
+
+/*
+ * Periodic snapshot of a counter, recording the change of each element
+ * since the previous snapshot in the session trace.
+ */
+struct lttng_counter_snapshot_timer {
+	struct list_head node;			/* Session counter snapshot list */
+	struct lttng_kernel_session *session;
+	struct file *counter_file;		/* Reference held on the counter */
+	struct lttng_counter *counter;
+	uint64_t id;
+	unsigned long period;			/* in jiffies */
+	size_t nr_elem;
+	int64_t *last_values;			/* Values at the previous snapshot */
+	struct delayed_work work;
+
+	int64_t values[LTTNG_COUNTER_SNAPSHOT_TIMER_CHUNK];
+	uint64_t overflow[LTTNG_COUNTER_SNAPSHOT_TIMER_CHUNK / 64];
+	uint64_t underflow[LTTNG_COUNTER_SNAPSHOT_TIMER_CHUNK / 64];
 };
 
 #define LTTNG_EVENT_HT_BITS		12
@@ -426,14 +612,19 @@ struct lttng_event_notifier_group {
 	struct lttng_kernel_channel_buffer_ops *ops;
 	struct lttng_transport *transport;
 	struct lttng_kernel_ring_buffer_channel *chan;		/* Ring buffer channel for event notifier group. */
-	struct lttng_kernel_ring_buffer *buf;	/* Ring buffer for event notifier group. */
 	wait_queue_head_t read_wait;
 	struct irq_work wakeup_pending;	/* Pending wakeup irq work. */
+	struct mutex batch_lock;	/* Serializes notification record batches. */
 
 	struct lttng_kernel_syscall_table syscall_table;
 
 	struct lttng_counter *error_counter;
 	size_t error_counter_len;
+	struct list_head maps_head;	/* Aggregation map counters */
+
+	uint32_t flags;			/* LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_* */
+	unsigned int staging_flush_interval;	/* usecs */
+	struct lttng_event_notifier_staging *staging;	/* Owned by the ring buffer client. */
 };
 
 struct lttng_transport {
@@ -469,6 +660,8 @@ struct lttng_kernel_session_private {
 	struct lttng_event_ht events_ht;
 	char name[LTTNG_KERNEL_ABI_SESSION_NAME_LEN];
 	char creation_time[LTTNG_KERNEL_ABI_SESSION_CREATION_TIME_ISO8601_LEN];
+	enum lttng_kernel_abi_metadata_format metadata_format;
+	struct list_head counter_snapshots;	/* Periodic counter snapshots */
 };
 
 struct lttng_id_hash_node {
@@ -823,7 +1016,8 @@ void lttng_event_enabler_session_add(struct lttng_kernel_session *session,
 struct lttng_event_notifier_enabler *lttng_event_notifier_enabler_create(
 		enum lttng_enabler_format_type format_type,
 		struct lttng_kernel_abi_event_notifier *event_notifier_param,
-		struct lttng_event_notifier_group *event_notifier_group);
+		struct lttng_event_notifier_group *event_notifier_group,
+		struct lttng_counter *counter);
 void lttng_event_notifier_enabler_group_add(struct lttng_event_notifier_group *event_notifier_group,
 		struct lttng_event_notifier_enabler *event_notifier_enabler);
 int lttng_event_notifier_enabler_attach_capture_bytecode(
@@ -834,6 +1028,11 @@ int lttng_event_enabler_enable(struct lttng_event_enabler_common *event_enabler)
 int lttng_event_enabler_disable(struct lttng_event_enabler_common *event_enabler);
 int lttng_event_enabler_attach_filter_bytecode(struct lttng_event_enabler_common *event_enabler,
 		struct lttng_kernel_abi_filter_bytecode __user *bytecode);
+int lttng_event_recorder_enabler_set_rate_policy(struct lttng_event_recorder_enabler *event_enabler,
+		const struct lttng_kernel_abi_event_rate_policy *rate_param,
+		struct file *suppressed_counter_file);
+int lttng_event_notifier_enabler_set_rate_policy(struct lttng_event_notifier_enabler *event_enabler,
+		const struct lttng_kernel_abi_event_notifier_rate_policy *rate_param);
 void lttng_event_enabler_destroy(struct lttng_event_enabler_common *event_enabler);
 
 bool lttng_desc_match_enabler(const struct lttng_kernel_event_desc *desc,
@@ -1029,11 +1228,39 @@ int lttng_session_disable(struct lttng_kernel_session *session);
 void lttng_session_destroy(struct lttng_kernel_session *session);
 int lttng_session_metadata_regenerate(struct lttng_kernel_session *session);
 int lttng_session_statedump(struct lttng_kernel_session *session);
+int lttng_session_counter_snapshot_add(struct lttng_kernel_session *session,
+		struct file *counter_file, uint64_t id, unsigned int period);
 void metadata_cache_destroy(struct kref *kref);
+int lttng_session_set_metadata_format(struct lttng_kernel_session *session,
+		enum lttng_kernel_abi_metadata_format format);
+
+int lttng_metadata_printf(struct lttng_kernel_session *session,
+		const char *fmt, ...);
+struct lttng_metadata_fragment *lttng_metadata_fragment_lookup(
+		enum lttng_kernel_abi_metadata_format format,
+		const void *desc, const void *type, size_t nesting);
+void lttng_metadata_fragment_add(struct lttng_kernel_session *session,
+		enum lttng_kernel_abi_metadata_format format,
+		const void *desc, const void *type, size_t nesting,
+		const struct lttng_kernel_probe_desc *probe_desc, size_t len);
+int lttng_metadata_fragment_print(struct lttng_kernel_session *session,
+		const struct lttng_metadata_fragment *frag);
+void lttng_metadata_fragments_invalidate(const struct lttng_kernel_probe_desc *probe_desc);
+
+int lttng_metadata_ctf2_session_statedump(struct lttng_kernel_session *session,
+		int64_t clock_offset);
+int lttng_metadata_ctf2_channel_statedump(struct lttng_kernel_session *session,
+		struct lttng_kernel_channel_buffer *chan);
+int lttng_metadata_ctf2_event_recorder_statedump(struct lttng_kernel_session *session,
+		struct lttng_kernel_event_recorder *event_recorder);
 
 struct lttng_counter *lttng_kernel_counter_create(
 		const char *counter_transport_name, size_t number_dimensions,
-		const size_t *dimensions_sizes);
+		const size_t *dimensions_sizes, int64_t global_sum_step);
+struct lttng_counter *lttng_kernel_sparse_counter_create(
+		size_t number_dimensions, size_t nr_entries);
+void lttng_kernel_counter_destroy(struct lttng_counter *counter);
+int lttng_kernel_counter_alloc_start_timestamps(struct lttng_counter *counter);
 int lttng_kernel_counter_read(struct lttng_counter *counter,
 		const size_t *dimension_indexes, int32_t cpu,
 		int64_t *val, bool *overflow, bool *underflow);
@@ -1042,7 +1269,20 @@ int lttng_kernel_counter_aggregate(struct lttng_counter *counter,
 		bool *overflow, bool *underflow);
 int lttng_kernel_counter_clear(struct lttng_counter *counter,
 		const size_t *dimension_indexes);
-struct lttng_event_notifier_group *lttng_event_notifier_group_create(void);
+int lttng_kernel_counter_get_slice(struct lttng_counter *counter,
+		size_t nr_indexes, const size_t *dimension_indexes,
+		size_t *index, size_t *nr_elem);
+int lttng_kernel_counter_aggregate_range(struct lttng_counter *counter,
+		size_t index, size_t nr_elem, int64_t *values,
+		uint64_t *overflow_bitmap, uint64_t *underflow_bitmap);
+size_t lttng_kernel_counter_mmap_len(struct lttng_counter *counter);
+struct page *lttng_kernel_counter_get_page(struct lttng_counter *counter,
+		int cpu, unsigned long offset);
+int lttng_kernel_counter_sparse_read_next(struct lttng_counter *counter,
+		uint64_t *pos, uint64_t *key, int *cpu, int64_t *value);
+int64_t lttng_kernel_counter_sparse_read_overflow(struct lttng_counter *counter);
+struct lttng_event_notifier_group *lttng_event_notifier_group_create(
+		const struct lttng_kernel_abi_event_notifier_group_conf *conf);
 int lttng_event_notifier_group_create_error_counter(
 		struct file *event_notifier_group_file,
 		const struct lttng_kernel_abi_counter_conf *error_counter_conf);
@@ -1055,6 +1295,7 @@ struct lttng_kernel_channel_buffer *lttng_channel_buffer_create(struct lttng_ker
 				       size_t subbuf_size, size_t num_subbuf,
 				       unsigned int switch_timer_interval,
 				       unsigned int read_timer_interval,
+				       uint32_t flags,
 				       enum channel_type channel_type);
 struct lttng_kernel_channel_buffer *lttng_global_channel_create(struct lttng_kernel_session *session,
 				       int overwrite, void *buf_addr,
@@ -1063,6 +1304,7 @@ struct lttng_kernel_channel_buffer *lttng_global_channel_create(struct lttng_ker
 				       unsigned int read_timer_interval);
 
 void lttng_metadata_channel_destroy(struct lttng_kernel_channel_buffer *chan);
+void lttng_channel_buffer_specialize(struct lttng_kernel_channel_buffer *chan);
 struct lttng_kernel_event_common *_lttng_kernel_event_create(struct lttng_event_enabler_common *event_enabler,
 				const struct lttng_kernel_event_desc *event_desc);
 struct lttng_kernel_event_common *lttng_kernel_event_create(struct lttng_event_enabler_common *event_enabler,
@@ -1070,6 +1312,8 @@ struct lttng_kernel_event_common *lttng_kernel_event_create(struct lttng_event_e
 
 int lttng_channel_enable(struct lttng_kernel_channel_common *channel);
 int lttng_channel_disable(struct lttng_kernel_channel_common *channel);
+int lttng_channel_add_hot_event(struct lttng_kernel_channel_buffer *chan,
+		const char *event_name);
 int lttng_event_enable(struct lttng_kernel_event_common *event);
 int lttng_event_disable(struct lttng_kernel_event_common *event);
 
@@ -1122,6 +1366,8 @@ int lttng_logger_init(void);
 void lttng_logger_exit(void);
 
 extern int lttng_statedump_start(struct lttng_kernel_session *session);
+extern void lttng_counter_snapshot_emit(struct lttng_kernel_session *session,
+		uint64_t id, uint64_t index, int64_t delta);
 
 int lttng_calibrate(struct lttng_kernel_abi_calibrate *calibrate);
 
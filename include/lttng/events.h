@@ -352,12 +352,14 @@ struct lttng_kernel_event_common {
 };
 
 struct lttng_kernel_event_recorder_private;
+struct lttng_kernel_event_rate;
 
 struct lttng_kernel_event_recorder {
 	struct lttng_kernel_event_common parent;
 	struct lttng_kernel_event_recorder_private *priv;	/* Private event record interface */
 
 	struct lttng_kernel_channel_buffer *chan;
+	struct lttng_kernel_event_rate *rate;		/* Sampling and rate limit, NULL if none */
 };
 
 struct lttng_kernel_notification_ctx {
@@ -469,5 +471,6 @@ int lttng_kernel_probe_register(struct lttng_kernel_probe_desc *desc);
 void lttng_kernel_probe_unregister(struct lttng_kernel_probe_desc *desc);
 
 bool lttng_id_tracker_lookup(struct lttng_kernel_id_tracker_rcu *p, int id);
+bool lttng_event_rate_accept(struct lttng_kernel_event_rate *rate);
 
 #endif /* _LTTNG_EVENTS_H */
@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: MIT
+ *
+ * lttng/loser_tree.h
+ *
+ * Tournament (loser) tree merging sorted streams by 64-bit keys. Keys are
+ * kept in a contiguous array indexed by stream, so replaying a match never
+ * dereferences stream state. Based on Knuth, TAOCP vol. 3, section 5.4.1.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#ifndef _LTTNG_LOSER_TREE_H
+#define _LTTNG_LOSER_TREE_H
+
+#include <linux/gfp.h>
+#include <linux/types.h>
+
+/* Key of a stream which does not take part in the merge. */
+#define LTTNG_LOSER_TREE_EMPTY	((u64) -1ULL)
+
+struct lttng_loser_tree {
+	unsigned int nr_leaves;		/* Power of two */
+	u64 *keys;			/* Key of each leaf */
+	unsigned int *losers;		/*
+					 * losers[0]: overall winner leaf.
+					 * losers[i], i > 0: leaf which
+					 * lost the match at internal
+					 * node i.
+					 */
+};
+
+/**
+ * lttng_loser_tree_winner - return the leaf holding the lowest key
+ * @tree: the tree to be operated on
+ *
+ * Ties are broken in favor of the lowest leaf index. The winner key is
+ * LTTNG_LOSER_TREE_EMPTY if no leaf takes part in the merge.
+ */
+static inline unsigned int lttng_loser_tree_winner(const struct lttng_loser_tree *tree)
+{
+	return tree->losers[0];
+}
+
+/**
+ * lttng_loser_tree_key - return the key of a leaf
+ * @tree: the tree to be operated on
+ * @leaf: leaf index
+ */
+static inline u64 lttng_loser_tree_key(const struct lttng_loser_tree *tree,
+		unsigned int leaf)
+{
+	return tree->keys[leaf];
+}
+
+/**
+ * lttng_loser_tree_set_key - set the key of a leaf without replaying matches
+ * @tree: the tree to be operated on
+ * @leaf: leaf index
+ * @key: new key
+ *
+ * Allows updating many leaves at once. lttng_loser_tree_rebuild() must be
+ * called before the winner is queried again.
+ */
+static inline void lttng_loser_tree_set_key(struct lttng_loser_tree *tree,
+		unsigned int leaf, u64 key)
+{
+	tree->keys[leaf] = key;
+}
+
+/**
+ * lttng_loser_tree_init - initialize the tree
+ * @tree: the tree to initialize
+ * @nr_leaves: number of leaves (rounded up to a power of two)
+ * @gfpmask: allocation flags
+ *
+ * All leaves are initially empty. Returns -ENOMEM if out of memory.
+ */
+extern int lttng_loser_tree_init(struct lttng_loser_tree *tree,
+		unsigned int nr_leaves, gfp_t gfpmask);
+
+/**
+ * lttng_loser_tree_free - free the tree
+ * @tree: the tree to free
+ */
+extern void lttng_loser_tree_free(struct lttng_loser_tree *tree);
+
+/**
+ * lttng_loser_tree_rebuild - replay all matches
+ * @tree: the tree to be operated on
+ *
+ * O(n). Needed after changing the key of leaves other than the winner.
+ */
+extern void lttng_loser_tree_rebuild(struct lttng_loser_tree *tree);
+
+/**
+ * lttng_loser_tree_replace_winner - change the key of the winner leaf
+ * @tree: the tree to be operated on
+ * @key: new key of the winner leaf
+ *
+ * Replays the matches from the winner leaf up to the root, which is
+ * O(log(n)) with a single comparison per level. Returns the new winner.
+ */
+extern unsigned int lttng_loser_tree_replace_winner(struct lttng_loser_tree *tree,
+		u64 key);
+
+#endif /* _LTTNG_LOSER_TREE_H */
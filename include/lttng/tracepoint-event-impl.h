@@ -798,6 +798,191 @@ static inline size_t __event_get_align__##_name(void *__tp_locvar)	      \
 
 #include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
 
+/*
+ * Stage 5.1 of tracepoint event generation.
+ *
+ * Detect fixed-layout events: events whose written fields are all
+ * integers or enumerations read from kernel memory. Their payload has a
+ * size and layout known at compile time.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <lttng/events-reset.h>
+#include <lttng/events-write.h>
+
+#undef _ctf_integer_ext
+#define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, _user, _nowrite) \
+	&& !(_user)
+
+#undef _ctf_array_encoded
+#define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _byte_order, _base, _user, _nowrite) \
+	&& 0
+
+#undef _ctf_array_bitfield
+#define _ctf_array_bitfield(_type, _item, _src, _length, _user, _nowrite) \
+	&& 0
+
+#undef _ctf_sequence_encoded
+#define _ctf_sequence_encoded(_type, _item, _src, _length_type,			\
+			_src_length, _encoding, _byte_order, _base, _user, _nowrite) \
+	&& 0
+
+#undef _ctf_sequence_bitfield
+#define _ctf_sequence_bitfield(_type, _item, _src,		\
+			_length_type, _src_length,		\
+			_user, _nowrite)			\
+	&& 0
+
+#undef _ctf_string
+#define _ctf_string(_item, _src, _user, _nowrite)			\
+	&& 0
+
+#undef _ctf_enum
+#define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)		\
+	_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, 10, _user, _nowrite)
+
+#undef ctf_align
+#define ctf_align(_type)						\
+	&& 0
+
+#undef ctf_custom_field
+#define ctf_custom_field(_type, _item, _code)				\
+	&& 0
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef TP_locvar
+#define TP_locvar(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_fixed_layout__##_name = 1 _fields };
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_fixed_layout__##_name = 1 _fields };
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 5.2 of tracepoint event generation.
+ *
+ * Create the payload layout of fixed-layout events. Each integer is
+ * aligned as it would be in the ring buffer, so the structure is an
+ * image of the event payload, which starts at the largest field
+ * alignment. The payload size is the offset of the __end member, which
+ * excludes the trailing padding. Members are declared with the
+ * unqualified field type, because some fields (e.g. system call
+ * arguments) have const-qualified types and are filled by assignment.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <lttng/events-reset.h>
+#include <lttng/events-write.h>
+
+#undef _ctf_integer_ext_isuser0
+#define _ctf_integer_ext_isuser0(_type, _item, _src, _byte_order, _base, _nowrite) \
+	__typeof__(((_type) 0)) __field_##_item __attribute__((aligned(lttng_alignof(_type))));
+
+#undef _ctf_integer_ext_isuser1
+#define _ctf_integer_ext_isuser1(_type, _item, _user_src, _byte_order, _base, _nowrite)
+
+#undef _ctf_integer_ext
+#define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, _user, _nowrite) \
+	_ctf_integer_ext_isuser##_user(_type, _item, _src, _byte_order, _base, _nowrite)
+
+#undef _ctf_enum
+#define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)		\
+	_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, 10, _user, _nowrite)
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef TP_locvar
+#define TP_locvar(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+struct __event_payload__##_name {					      \
+	_fields								      \
+	char __end[0];							      \
+} __attribute__((packed));
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+struct __event_payload__##_name {					      \
+	_fields								      \
+	char __end[0];							      \
+} __attribute__((packed));
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 5.3 of tracepoint event generation.
+ *
+ * Create static inline function that fills the payload of fixed-layout
+ * events.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <lttng/events-reset.h>
+#include <lttng/events-write.h>
+
+#undef _ctf_integer_ext_isuser0
+#define _ctf_integer_ext_isuser0(_type, _item, _src, _byte_order, _base, _nowrite) \
+	__payload->__field_##_item = (_type) (_src);
+
+#undef _ctf_integer_ext_isuser1
+#define _ctf_integer_ext_isuser1(_type, _item, _user_src, _byte_order, _base, _nowrite)
+
+#undef _ctf_integer_ext
+#define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, _user, _nowrite) \
+	_ctf_integer_ext_isuser##_user(_type, _item, _src, _byte_order, _base, _nowrite)
+
+#undef _ctf_enum
+#define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)		\
+	_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, 10, _user, _nowrite)
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef TP_locvar
+#define TP_locvar(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+static inline void __event_payload_fill__##_name(			      \
+		struct __event_payload__##_name *__payload,		      \
+		void *__tp_locvar, _proto)				      \
+{									      \
+	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
+									      \
+	_fields								      \
+}
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+static inline void __event_payload_fill__##_name(			      \
+		struct __event_payload__##_name *__payload,		      \
+		void *__tp_locvar)					      \
+{									      \
+	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
+									      \
+	_fields								      \
+}
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
 /*
  * Stage 6 of tracepoint event generation.
  *
@@ -1125,6 +1310,16 @@ static void __event_probe__##_name(_data_proto)						\
 	}										\
 	if (unlikely(!READ_ONCE(__event->enabled)))					\
 		return;									\
+	if (__event->type == LTTNG_KERNEL_EVENT_TYPE_RECORDER) {			\
+		struct lttng_kernel_event_recorder *__event_recorder =			\
+			container_of(__event, struct lttng_kernel_event_recorder, parent); \
+		struct lttng_kernel_event_rate *__rate =				\
+			lttng_rcu_dereference(__event_recorder->rate);			\
+											\
+		/* Sampling and rate limit are applied before filters. */		\
+		if (unlikely(__rate) && !lttng_event_rate_accept(__rate))		\
+			return;								\
+	}										\
 	__orig_dynamic_len_offset = this_cpu_ptr(&lttng_dynamic_len_stack)->offset;	\
 	__dynamic_len_idx = __orig_dynamic_len_offset;					\
 	_code_pre									\
@@ -1147,6 +1342,24 @@ static void __event_probe__##_name(_data_proto)						\
 		size_t __event_align;							\
 		int __ret;								\
 											\
+		if (__event_fixed_layout__##_name) {					\
+			struct __event_payload__##_name __payload;			\
+			const size_t __payload_len =					\
+				offsetof(struct __event_payload__##_name, __end);	\
+											\
+			/* Payload built on stack and written at once. */		\
+			__event_payload_fill__##_name(&__payload, _locvar_args);	\
+			lib_ring_buffer_ctx_init(&__ctx, __event_recorder, __payload_len, \
+					lttng_alignof(__payload), &__lttng_probe_ctx);	\
+			__ret = __chan->ops->event_reserve(&__ctx);			\
+			if (__ret < 0)							\
+				goto __post;						\
+			if (__payload_len)						\
+				__chan->ops->event_write(&__ctx, &__payload,		\
+					__payload_len, lttng_alignof(__payload));	\
+			__chan->ops->event_commit(&__ctx);				\
+			break;								\
+		}									\
 		__event_len = __event_get_size__##_name(_locvar_args);			\
 		if (unlikely(__event_len < 0)) {					\
 			__chan->ops->lost_event_too_big(__chan);			\
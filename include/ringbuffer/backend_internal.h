@@ -30,7 +30,7 @@ int channel_backend_init(struct channel_backend *chanb,
 			 const char *name,
 			 const struct lttng_kernel_ring_buffer_config *config,
 			 void *priv, size_t subbuf_size,
-			 size_t num_subbuf);
+			 size_t num_subbuf, size_t num_standby_subbuf);
 void channel_backend_free(struct channel_backend *chanb);
 
 void lib_ring_buffer_backend_reset(struct lttng_kernel_ring_buffer_backend *bufb);
@@ -189,6 +189,29 @@ int subbuffer_id_check_index(const struct lttng_kernel_ring_buffer_config *confi
 		return 0;
 }
 
+/*
+ * Number of sub-buffers allocated for each buffer: writer sub-buffers,
+ * followed by the extra reader sub-buffer and the standby sub-buffers.
+ */
+static inline
+unsigned long channel_backend_num_subbuf_alloc(const struct channel_backend *chanb)
+{
+	unsigned long num_subbuf_alloc = chanb->num_subbuf;
+
+	if (chanb->extra_reader_sb)
+		num_subbuf_alloc++;
+	return num_subbuf_alloc + chanb->num_standby_subbuf;
+}
+
+/*
+ * Length of the mapping of a single buffer.
+ */
+static inline
+unsigned long channel_backend_mmap_len(const struct channel_backend *chanb)
+{
+	return channel_backend_num_subbuf_alloc(chanb) << chanb->subbuf_size_order;
+}
+
 static inline
 void lib_ring_buffer_backend_get_pages(const struct lttng_kernel_ring_buffer_config *config,
 			struct lttng_kernel_ring_buffer_ctx *ctx,
@@ -427,14 +450,16 @@ void lib_ring_buffer_set_noref_offset(const struct lttng_kernel_ring_buffer_conf
 }
 
 /**
- * update_read_sb_index - Read-side subbuffer index update.
+ * exchange_sb_index - Exchange a reader-owned subbuffer with a writer
+ *                     subbuffer.
+ * @sb: reader-owned subbuffer, receives the writer subbuffer on success.
  */
 static inline
-int update_read_sb_index(const struct lttng_kernel_ring_buffer_config *config,
-			 struct lttng_kernel_ring_buffer_backend *bufb,
-			 struct channel_backend *chanb,
-			 unsigned long consumed_idx,
-			 unsigned long consumed_count)
+int exchange_sb_index(const struct lttng_kernel_ring_buffer_config *config,
+		      struct lttng_kernel_ring_buffer_backend *bufb,
+		      struct lttng_kernel_ring_buffer_backend_subbuffer *sb,
+		      unsigned long consumed_idx,
+		      unsigned long consumed_count)
 {
 	unsigned long old_id, new_id;
 
@@ -456,21 +481,35 @@ int update_read_sb_index(const struct lttng_kernel_ring_buffer_config *config,
 							  consumed_count)))
 			return -EAGAIN;
 		CHAN_WARN_ON(bufb->chan,
-			     !subbuffer_id_is_noref(config, bufb->buf_rsb.id));
-		subbuffer_id_set_noref_offset(config, &bufb->buf_rsb.id,
+			     !subbuffer_id_is_noref(config, sb->id));
+		subbuffer_id_set_noref_offset(config, &sb->id,
 					      consumed_count);
 		new_id = cmpxchg(&bufb->buf_wsb[consumed_idx].id, old_id,
-				 bufb->buf_rsb.id);
+				 sb->id);
 		if (unlikely(old_id != new_id))
 			return -EAGAIN;
-		bufb->buf_rsb.id = new_id;
+		sb->id = new_id;
 	} else {
 		/* No page exchange, use the writer page directly */
-		bufb->buf_rsb.id = bufb->buf_wsb[consumed_idx].id;
+		sb->id = bufb->buf_wsb[consumed_idx].id;
 	}
 	return 0;
 }
 
+/**
+ * update_read_sb_index - Read-side subbuffer index update.
+ */
+static inline
+int update_read_sb_index(const struct lttng_kernel_ring_buffer_config *config,
+			 struct lttng_kernel_ring_buffer_backend *bufb,
+			 struct channel_backend *chanb,
+			 unsigned long consumed_idx,
+			 unsigned long consumed_count)
+{
+	return exchange_sb_index(config, bufb, &bufb->buf_rsb,
+				 consumed_idx, consumed_count);
+}
+
 static inline __attribute__((always_inline))
 void lttng_inline_memcpy(void *dest, const void *src,
 		unsigned long len)
@@ -54,6 +54,12 @@ struct lttng_kernel_ring_buffer_backend {
 	struct lttng_kernel_ring_buffer_backend_subbuffer *buf_wsb;
 	/* ring_buffer_backend_subbuffer for reader */
 	struct lttng_kernel_ring_buffer_backend_subbuffer buf_rsb;
+	/*
+	 * Array of ring_buffer_backend_subbuffer owned by the reader for
+	 * frozen snapshots. Entries below the frozen sub-buffer count hold
+	 * the frozen sub-buffers, the others are standby sub-buffers.
+	 */
+	struct lttng_kernel_ring_buffer_backend_subbuffer *buf_ssb;
 	/* Array of lib_ring_buffer_backend_counts for the packet counter */
 	struct lttng_kernel_ring_buffer_backend_counts *buf_cnt;
 	/*
@@ -79,6 +85,10 @@ struct channel_backend {
 					 */
 	unsigned int buf_size_order;	/* Order of buffer size */
 	unsigned int extra_reader_sb:1;	/* has extra reader subbuffer ? */
+	unsigned long num_standby_subbuf;	/*
+						 * Number of standby sub-buffers
+						 * for frozen snapshots.
+						 */
 	struct lttng_kernel_ring_buffer *buf;	/* Channel per-cpu buffers */
 
 	unsigned long num_subbuf;	/* Number of sub-buffers for writer */
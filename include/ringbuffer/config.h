@@ -251,12 +251,21 @@ void lib_ring_buffer_ctx_init(struct lttng_kernel_ring_buffer_ctx *ctx,
  * needed in the record header. If this flag is not set, the record header needs
  * only to contain "tsc_bits" bit of time value.
  *
+ * RING_BUFFER_RFLAG_PACKET_START
+ *
+ * Set by the frontend when the record is the first one of a sub-buffer. The
+ * sub-buffer header begin timestamp is the record timestamp, so the header
+ * acts as a timestamp anchor: RING_BUFFER_RFLAG_FULL_TSC is never set along
+ * with this flag, and the record header only needs to contain the low-order
+ * bits of the time value.
+ *
  * Reservation flags can be added by the client, starting from
  * "(RING_BUFFER_FLAGS_END << 0)". It can be used to pass information from
  * record_header_size() to lib_ring_buffer_write_record_header().
  */
 #define	RING_BUFFER_RFLAG_FULL_TSC		(1U << 0)
-#define RING_BUFFER_RFLAG_END			(1U << 1)
+#define	RING_BUFFER_RFLAG_PACKET_START		(1U << 1)
+#define RING_BUFFER_RFLAG_END			(1U << 2)
 
 #ifndef LTTNG_TRACER_CORE_H
 #error "lttng/tracer-core.h is needed for RING_BUFFER_ALIGN define"
@@ -49,6 +49,10 @@
  * buf_addr is a pointer the the beginning of the preallocated buffer contiguous
  * address mapping. It is used only by RING_BUFFER_STATIC configuration. It can
  * be set to NULL for other backends.
+ *
+ * num_standby_subbuf is the number of standby sub-buffers allocated for each
+ * buffer to take frozen snapshots of overwrite mode buffers. It can be set to
+ * 0 when frozen snapshots are not needed.
  */
 
 extern
@@ -57,7 +61,8 @@ struct lttng_kernel_ring_buffer_channel *channel_create(const struct lttng_kerne
 			       void *buf_addr,
 			       size_t subbuf_size, size_t num_subbuf,
 			       unsigned int switch_timer_interval,
-			       unsigned int read_timer_interval);
+			       unsigned int read_timer_interval,
+			       size_t num_standby_subbuf);
 
 /*
  * channel_destroy returns the private data pointer. It finalizes all channel's
@@ -104,6 +109,15 @@ extern int lib_ring_buffer_get_subbuf(struct lttng_kernel_ring_buffer *buf,
 				      unsigned long consumed);
 extern void lib_ring_buffer_put_subbuf(struct lttng_kernel_ring_buffer *buf);
 
+/*
+ * Frozen snapshot sequence: freeze, many get_frozen_subbuf/put_subbuf, thaw.
+ */
+extern int lib_ring_buffer_snapshot_freeze(struct lttng_kernel_ring_buffer *buf,
+					   unsigned long *nr_frozen);
+extern int lib_ring_buffer_get_frozen_subbuf(struct lttng_kernel_ring_buffer *buf,
+					     unsigned long index);
+extern int lib_ring_buffer_snapshot_thaw(struct lttng_kernel_ring_buffer *buf);
+
 void lib_ring_buffer_set_quiescent_channel(struct lttng_kernel_ring_buffer_channel *chan);
 void lib_ring_buffer_clear_quiescent_channel(struct lttng_kernel_ring_buffer_channel *chan);
 
@@ -94,6 +94,11 @@ int lib_ring_buffer_try_reserve(const struct lttng_kernel_ring_buffer_config *co
 	if (last_tsc_overflow(config, buf, ctx->priv.tsc))
 		ctx->priv.rflags |= RING_BUFFER_RFLAG_FULL_TSC;
 
+	/*
+	 * The first record of a sub-buffer is handled by the slow path, which
+	 * anchors its timestamp on the sub-buffer header instead of emitting
+	 * the full time value.
+	 */
 	if (unlikely(subbuf_offset(*o_begin, chan) == 0))
 		return 1;
 
@@ -107,6 +107,20 @@ int last_tsc_overflow(const struct lttng_kernel_ring_buffer_config *config,
 	else
 		return 0;
 }
+
+/*
+ * Only the high-order bits of the last TSC are kept: when it does not
+ * overflow, the delta is bounded by tsc_bits.
+ */
+static inline
+unsigned int last_tsc_delta_bits(const struct lttng_kernel_ring_buffer_config *config,
+		      struct lttng_kernel_ring_buffer *buf, u64 tsc)
+{
+	if (config->tsc_bits == 0 || config->tsc_bits == 64
+			|| last_tsc_overflow(config, buf, tsc))
+		return 64;
+	return config->tsc_bits;
+}
 #else
 static inline
 void save_last_tsc(const struct lttng_kernel_ring_buffer_config *config,
@@ -131,6 +145,20 @@ int last_tsc_overflow(const struct lttng_kernel_ring_buffer_config *config,
 	else
 		return 0;
 }
+
+/*
+ * Upper bound of the number of significant bits of the delta between @tsc
+ * and the last TSC. Races with concurrent updates of the last TSC can only
+ * make the bound larger than needed, like for last_tsc_overflow().
+ */
+static inline
+unsigned int last_tsc_delta_bits(const struct lttng_kernel_ring_buffer_config *config,
+		      struct lttng_kernel_ring_buffer *buf, u64 tsc)
+{
+	if (config->tsc_bits == 0 || config->tsc_bits == 64)
+		return 64;
+	return fls64(tsc - v_read(config, &buf->last_tsc));
+}
 #endif
 
 extern
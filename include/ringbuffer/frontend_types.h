@@ -16,7 +16,7 @@
 #include <linux/irq_work.h>
 #include <ringbuffer/config.h>
 #include <ringbuffer/backend_types.h>
-#include <lttng/prio_heap.h>	/* For per-CPU read-side iterator */
+#include <lttng/loser_tree.h>	/* For per-CPU read-side iterator */
 #include <lttng/cpuhotplug.h>
 
 /*
@@ -27,8 +27,11 @@ enum switch_mode { SWITCH_ACTIVE, SWITCH_FLUSH };
 
 /* channel-level read-side iterator */
 struct channel_iter {
-	/* Prio heap of buffers. Lowest timestamps at the top. */
-	struct lttng_ptr_heap heap;	/* Heap of struct lttng_kernel_ring_buffer ptrs */
+	/*
+	 * Loser tree of buffers, one leaf per CPU, keyed by the current
+	 * record timestamp. Lowest timestamp wins.
+	 */
+	struct lttng_loser_tree tree;
 	struct list_head empty_head;	/* Empty buffers linked-list head */
 	int read_open;			/* Opened for reading ? */
 	u64 last_qs;			/* Last quiescent state timestamp */
@@ -84,6 +87,20 @@ struct commit_counters_cold {
 	union v_atomic cc_sb;		/* Incremented _once_ at sb switch */
 };
 
+/*
+ * Number of records decoded ahead by the per-buffer read iterator, so the
+ * record headers of a sub-buffer are read in batches.
+ */
+#define RING_BUFFER_ITER_RUN_LEN	16
+
+/* Record decoded ahead by the per-buffer read iterator */
+struct lttng_kernel_ring_buffer_iter_record {
+	unsigned long offset;		/* Record header offset */
+	size_t header_len;		/* Record header length */
+	size_t payload_len;		/* Record payload length */
+	u64 timestamp;			/* Record timestamp */
+};
+
 /* Per-buffer read iterator */
 struct lttng_kernel_ring_buffer_iter {
 	u64 timestamp;			/* Current record timestamp */
@@ -92,6 +109,9 @@ struct lttng_kernel_ring_buffer_iter {
 
 	struct list_head empty_node;	/* Linked list of empty buffers */
 	unsigned long consumed, read_offset, data_size;
+	struct lttng_kernel_ring_buffer_iter_record run[RING_BUFFER_ITER_RUN_LEN];
+	unsigned int run_pos, run_len;	/* Records decoded ahead */
+	unsigned long len_left;		/* read() file operation state */
 	enum {
 		ITER_GET_SUBBUF = 0,
 		ITER_TEST_RECORD,
@@ -100,6 +120,7 @@ struct lttng_kernel_ring_buffer_iter {
 	} state;
 	unsigned int allocated:1;
 	unsigned int read_open:1;	/* Opened for reading ? */
+	unsigned int batch_pending:1;	/* Current record not described yet */
 };
 
 /* ring buffer state */
@@ -157,7 +178,10 @@ struct lttng_kernel_ring_buffer {
 	unsigned long get_subbuf_consumed;	/* Read-side consumed */
 	unsigned long prod_snapshot;	/* Producer count snapshot */
 	unsigned long cons_snapshot;	/* Consumer count snapshot */
+	unsigned long frozen_count;	/* Number of frozen sub-buffers */
+	unsigned long frozen_index;	/* Frozen sub-buffer held by reader */
 	unsigned int get_subbuf:1,	/* Sub-buffer being held by reader */
+		get_frozen_subbuf:1,	/* Held sub-buffer is frozen */
 		switch_timer_enabled:1,	/* Protected by ring_buffer_nohz_lock */
 		read_timer_enabled:1,	/* Protected by ring_buffer_nohz_lock */
 		quiescent:1;
@@ -42,6 +42,18 @@ extern void lib_ring_buffer_put_current_record(struct lttng_kernel_ring_buffer *
 extern ssize_t channel_get_next_record(struct lttng_kernel_ring_buffer_channel *chan,
 				       struct lttng_kernel_ring_buffer **ret_buf);
 
+/*
+ * lib_ring_buffer_get_next_record_batch describes the next records of several
+ * buffers of a channel, merged in timestamp order, and consumes the records
+ * described by the previous call. It returns either the number of records
+ * described, -EAGAIN if there is currently no data available, or -ENODATA if
+ * no data is available and all buffers are finalized.
+ */
+extern ssize_t lib_ring_buffer_get_next_record_batch(struct lttng_kernel_ring_buffer_channel *chan,
+		struct lttng_kernel_ring_buffer **bufs, unsigned int nr_bufs,
+		struct lttng_kernel_abi_ring_buffer_record_desc *descs,
+		unsigned int count);
+
 /**
  * read_current_record - copy the buffer current record into dest.
  * @buf: ring buffer
@@ -121,6 +121,57 @@ ssize_t vfs_lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
  */
 #define LTTNG_KERNEL_ABI_RING_BUFFER_GET_NEXT_SUBBUF_METADATA_CHECK	_IOR(0xF6, 0x12, uint32_t)
 
+/*
+ * Describe the next records of the notification streams of an event
+ * notifier group, merged in timestamp order, without copying them.
+ *
+ * Issued on a notification stream file descriptor, which is merged with
+ * the notification streams of the same group listed in stream_fds. Each
+ * record payload is described by its offset within the mmap area of the
+ * stream of its CPU (see LTTNG_KERNEL_ABI_RING_BUFFER_GET_MMAP_LEN), and
+ * stays readable until the next LTTNG_KERNEL_ABI_RING_BUFFER_GET_NEXT_RECORDS,
+ * which consumes it. The descs array holds count entries, count returns
+ * the number of records described. Returns -EAGAIN if no record is
+ * available, and -ENODATA once all streams are finalized and empty.
+ */
+#define LTTNG_KERNEL_ABI_RING_BUFFER_MAX_RECORDS		256
+
+struct lttng_kernel_abi_ring_buffer_record_desc {
+	uint64_t offset;	/* Payload offset in the stream mmap area */
+	uint64_t timestamp;	/* Trace clock, at reservation */
+	uint32_t len;		/* Payload length, in bytes */
+	uint32_t cpu;		/* CPU of the stream */
+} __attribute__((packed));
+
+struct lttng_kernel_abi_ring_buffer_record_batch {
+	uint64_t descs;		/* struct lttng_kernel_abi_ring_buffer_record_desc array */
+	uint64_t stream_fds;	/* int32_t array of the other streams to merge */
+	uint32_t nr_stream_fds;
+	uint32_t count;		/* Input: size of descs, output: records described */
+} __attribute__((packed));
+
+#define LTTNG_KERNEL_ABI_RING_BUFFER_GET_NEXT_RECORDS		\
+	_IOWR(0xF6, 0x13, struct lttng_kernel_abi_ring_buffer_record_batch)
+
+/*
+ * Frozen flight recorder snapshots (overwrite mode channels created with
+ * standby sub-buffers).
+ *
+ * LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_FREEZE swaps the readable
+ * sub-buffers out of the buffer into the standby set without stopping the
+ * writers, and returns the number of frozen sub-buffers. Each frozen
+ * sub-buffer, indexed from oldest to newest, is then held with
+ * LTTNG_KERNEL_ABI_RING_BUFFER_GET_FROZEN_SUBBUF, read like a sub-buffer
+ * obtained with LTTNG_KERNEL_ABI_RING_BUFFER_GET_SUBBUF (mmap or splice),
+ * and released with LTTNG_KERNEL_ABI_RING_BUFFER_PUT_SUBBUF.
+ * LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_THAW returns the frozen sub-buffers
+ * to the standby set. Each per-CPU stream is frozen and extracted
+ * independently, so per-CPU streams can be extracted in parallel.
+ */
+#define LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_FREEZE		_IOR(0xF6, 0x15, uint64_t)
+#define LTTNG_KERNEL_ABI_RING_BUFFER_GET_FROZEN_SUBBUF		_IOW(0xF6, 0x16, uint64_t)
+#define LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_THAW		_IO(0xF6, 0x17)
+
 #ifdef CONFIG_COMPAT
 /* Get a snapshot of the current ring buffer producer and consumer positions */
 #define LTTNG_KERNEL_ABI_RING_BUFFER_COMPAT_SNAPSHOT		LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT
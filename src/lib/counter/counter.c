@@ -7,10 +7,13 @@
 
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
 #include <lttng/tracer.h>
 #include <linux/cpumask.h>
 #include <counter/counter.h>
 #include <counter/counter-internal.h>
+#include <counter/counter-api.h>
 #include <wrapper/compiler_attributes.h>
 #include <wrapper/vmalloc.h>
 #include <wrapper/limits.h>
@@ -48,40 +51,64 @@ static int lttng_counter_layout_init(struct lib_counter *counter, int cpu)
 	struct lib_counter_layout *layout;
 	size_t counter_size;
 	size_t nr_elem = counter->allocated_elem;
+	unsigned long *overflow_bitmap, *underflow_bitmap;
+	void *counters;
 
 	if (cpu == -1)
 		layout = &counter->global_counters;
 	else
 		layout = per_cpu_ptr(counter->percpu_counters, cpu);
-	switch (counter->config.counter_size) {
+	counter_size = lttng_counter_layout_counter_size(&counter->config, cpu == -1);
+	switch (counter_size) {
 	case COUNTER_SIZE_8_BIT:
 	case COUNTER_SIZE_16_BIT:
 	case COUNTER_SIZE_32_BIT:
 	case COUNTER_SIZE_64_BIT:
-		counter_size = (size_t) counter->config.counter_size;
 		break;
 	default:
 		return -EINVAL;
 	}
-	layout->counters = lttng_kvzalloc_node(ALIGN(counter_size * nr_elem,
-						     1 << INTERNODE_CACHE_SHIFT),
-					       GFP_KERNEL | __GFP_NOWARN,
-					       cpu_to_node(max(cpu, 0)));
-	if (!layout->counters)
-		return -ENOMEM;
-	layout->overflow_bitmap = lttng_kvzalloc_node(ALIGN(ALIGN(nr_elem, 8) / 8,
+	overflow_bitmap = lttng_kvzalloc_node(ALIGN(ALIGN(nr_elem, 8) / 8,
 						     1 << INTERNODE_CACHE_SHIFT),
 					       GFP_KERNEL | __GFP_NOWARN,
 					       cpu_to_node(max(cpu, 0)));
-	if (!layout->overflow_bitmap)
-		return -ENOMEM;
-	layout->underflow_bitmap = lttng_kvzalloc_node(ALIGN(ALIGN(nr_elem, 8) / 8,
+	if (!overflow_bitmap)
+		goto error_overflow;
+	underflow_bitmap = lttng_kvzalloc_node(ALIGN(ALIGN(nr_elem, 8) / 8,
 						     1 << INTERNODE_CACHE_SHIFT),
 					       GFP_KERNEL | __GFP_NOWARN,
 					       cpu_to_node(max(cpu, 0)));
-	if (!layout->underflow_bitmap)
-		return -ENOMEM;
+	if (!underflow_bitmap)
+		goto error_underflow;
+	/*
+	 * Counters are allocated in whole pages so they can be mapped
+	 * read-only in user space.
+	 */
+	counters = vzalloc_node(PAGE_ALIGN(counter_size * nr_elem),
+				cpu_to_node(max(cpu, 0)));
+	if (!counters)
+		goto error_counters;
+	/*
+	 * Make sure we don't trigger recursive page faults in the
+	 * tracing fast path.
+	 */
+	wrapper_vmalloc_sync_mappings();
+	layout->overflow_bitmap = overflow_bitmap;
+	layout->underflow_bitmap = underflow_bitmap;
+	/*
+	 * Layouts of possible cpus are read locklessly. Publish the
+	 * counters once the layout is initialized. Matches the
+	 * load-acquire in lttng_counter_get_layout().
+	 */
+	smp_store_release(&layout->counters, counters);
 	return 0;
+
+error_counters:
+	lttng_kvfree(underflow_bitmap);
+error_underflow:
+	lttng_kvfree(overflow_bitmap);
+error_overflow:
+	return -ENOMEM;
 }
 
 static void lttng_counter_layout_fini(struct lib_counter *counter, int cpu)
@@ -93,11 +120,29 @@ static void lttng_counter_layout_fini(struct lib_counter *counter, int cpu)
 	else
 		layout = per_cpu_ptr(counter->percpu_counters, cpu);
 
-	lttng_kvfree(layout->counters);
+	vfree(layout->counters);
 	lttng_kvfree(layout->overflow_bitmap);
 	lttng_kvfree(layout->underflow_bitmap);
 }
 
+/*
+ * Get the layout of @cpu, or the global layout if @cpu is -1. Per-cpu
+ * layouts are allocated when their cpu is first brought online, NULL is
+ * returned for cpus which never were.
+ */
+static struct lib_counter_layout *lttng_counter_get_layout(struct lib_counter *counter,
+							   int cpu)
+{
+	struct lib_counter_layout *layout;
+
+	if (cpu == -1)
+		return &counter->global_counters;
+	layout = per_cpu_ptr(counter->percpu_counters, cpu);
+	if (!smp_load_acquire(&layout->counters))
+		return NULL;
+	return layout;
+}
+
 static
 int lttng_counter_set_global_sum_step(struct lib_counter *counter,
 				      int64_t global_sum_step)
@@ -137,10 +182,15 @@ int validate_args(const struct lib_counter_config *config,
 	const size_t *max_nr_elem,
 	int64_t global_sum_step)
 {
-	if (BITS_PER_LONG != 64 && config->counter_size == COUNTER_SIZE_64_BIT) {
+	if (BITS_PER_LONG != 64 && (config->counter_size == COUNTER_SIZE_64_BIT
+			|| config->wide_global)) {
 		WARN_ON_ONCE(1);
 		return -1;
 	}
+	/* Wide global counters are only used for spilling per-cpu counters. */
+	if (config->wide_global && (!(config->alloc & COUNTER_ALLOC_GLOBAL) ||
+			!(config->alloc & COUNTER_ALLOC_PER_CPU)))
+		return -1;
 	if (!max_nr_elem)
 		return -1;
 	/*
@@ -180,6 +230,8 @@ struct lib_counter *lttng_counter_create(const struct lib_counter_config *config
 		counter->percpu_counters = alloc_percpu(struct lib_counter_layout);
 		if (!counter->percpu_counters)
 			goto error_alloc_percpu;
+		if (!zalloc_cpumask_var(&counter->cpumask, GFP_KERNEL))
+			goto error_alloc_cpumask;
 	}
 
 	if (lttng_counter_init_stride(config, counter))
@@ -188,18 +240,30 @@ struct lib_counter *lttng_counter_create(const struct lib_counter_config *config
 	for (dimension = 0; dimension < counter->nr_dimensions; dimension++)
 		nr_elem *= lttng_counter_get_dimension_nr_elements(&counter->dimensions[dimension]);
 	counter->allocated_elem = nr_elem;
-	if (config->alloc & COUNTER_ALLOC_GLOBAL) {
-		ret = lttng_counter_layout_init(counter, -1);	/* global */
+	/*
+	 * The global layout also accumulates the per-cpu counters of cpus
+	 * brought offline.
+	 */
+	ret = lttng_counter_layout_init(counter, -1);	/* global */
+	if (ret)
+		goto layout_init_error;
+	if (config->alloc & COUNTER_ALLOC_PER_CPU) {
+		mutex_init(&counter->alloc_lock);
+#if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0))
+		/* Allocates the layouts of online cpus. */
+		counter->cpuhp_prepare.component = LTTNG_COUNTER;
+		ret = cpuhp_state_add_instance(lttng_counter_hp_prepare,
+			&counter->cpuhp_prepare.node);
 		if (ret)
 			goto layout_init_error;
-	}
-	if (config->alloc & COUNTER_ALLOC_PER_CPU) {
-		//TODO: integrate with CPU hotplug and online cpus
+#else /* #if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0)) */
 		for (cpu = 0; cpu < num_possible_cpus(); cpu++) {
 			ret = lttng_counter_layout_init(counter, cpu);
 			if (ret)
 				goto layout_init_error;
+			cpumask_set_cpu(cpu, counter->cpumask);
 		}
+#endif /* #else #if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0)) */
 	}
 	return counter;
 
@@ -208,9 +272,10 @@ layout_init_error:
 		for (cpu = 0; cpu < num_possible_cpus(); cpu++)
 			lttng_counter_layout_fini(counter, cpu);
 	}
-	if (config->alloc & COUNTER_ALLOC_GLOBAL)
-		lttng_counter_layout_fini(counter, -1);
+	lttng_counter_layout_fini(counter, -1);
 error_init_stride:
+	free_cpumask_var(counter->cpumask);
+error_alloc_cpumask:
 	free_percpu(counter->percpu_counters);
 error_alloc_percpu:
 	kfree(counter->dimensions);
@@ -227,17 +292,130 @@ void lttng_counter_destroy(struct lib_counter *counter)
 	int cpu;
 
 	if (config->alloc & COUNTER_ALLOC_PER_CPU) {
+#if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0))
+		int ret;
+
+		/* Do not fold the counters being destroyed. */
+		ret = cpuhp_state_remove_instance_nocalls(lttng_counter_hp_prepare,
+				&counter->cpuhp_prepare.node);
+		WARN_ON(ret);
+#endif /* #if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0)) */
 		for (cpu = 0; cpu < num_possible_cpus(); cpu++)
 			lttng_counter_layout_fini(counter, cpu);
+		free_cpumask_var(counter->cpumask);
 		free_percpu(counter->percpu_counters);
 	}
-	if (config->alloc & COUNTER_ALLOC_GLOBAL)
-		lttng_counter_layout_fini(counter, -1);
+	lttng_counter_layout_fini(counter, -1);
 	kfree(counter->dimensions);
 	kfree(counter);
 }
 EXPORT_SYMBOL_GPL(lttng_counter_destroy);
 
+/*
+ * Allocate the layout of @cpu if it was not allocated yet, either by its
+ * cpu being brought online or by a user space mapping.
+ */
+static int lttng_counter_layout_get_or_init(struct lib_counter *counter, int cpu)
+{
+	int ret = 0;
+
+	mutex_lock(&counter->alloc_lock);
+	if (!lttng_counter_get_layout(counter, cpu))
+		ret = lttng_counter_layout_init(counter, cpu);
+	mutex_unlock(&counter->alloc_lock);
+	return ret;
+}
+
+#if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0))
+
+static
+int lttng_counter_clear_cpu(const struct lib_counter_config *config,
+			    struct lib_counter *counter,
+			    const size_t *dimension_indexes,
+			    int cpu);
+
+enum cpuhp_state lttng_counter_hp_prepare;
+
+void lttng_counter_set_hp_prepare(enum cpuhp_state val)
+{
+	lttng_counter_hp_prepare = val;
+}
+EXPORT_SYMBOL_GPL(lttng_counter_set_hp_prepare);
+
+int lttng_cpuhp_counter_prepare(unsigned int cpu,
+		struct lttng_cpuhp_node *node)
+{
+	struct lib_counter *counter = container_of(node, struct lib_counter,
+					    cpuhp_prepare);
+	int ret;
+
+	ret = lttng_counter_layout_get_or_init(counter, cpu);
+	if (ret) {
+		printk(KERN_ERR
+		  "LTTng: counter: cpu %u counter allocation failed\n", cpu);
+		return ret;
+	}
+	cpumask_set_cpu(cpu, counter->cpumask);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_cpuhp_counter_prepare);
+
+/*
+ * Fold the counters of a dead cpu into the global layout, and remove the
+ * cpu from the layouts walked by aggregation. Performed by the cpu
+ * responsible for the hotunplug after the target cpu stopped running
+ * completely. The layout is cleared rather than freed, as it may be
+ * mapped in user space, and is reused if the cpu is brought online again.
+ *
+ * Each count is added to the global layout before being cleared from the
+ * cpu layout, so an aggregation running concurrently may briefly count it
+ * twice, or miss it if it read the global layout before the fold.
+ */
+int lttng_cpuhp_counter_dead(unsigned int cpu,
+		struct lttng_cpuhp_node *node)
+{
+	struct lib_counter *counter = container_of(node, struct lib_counter,
+					    cpuhp_prepare);
+	const struct lib_counter_config *config = &counter->config;
+	struct lib_counter_layout *global = &counter->global_counters;
+	size_t *dimension_indexes;
+	size_t index, dimension;
+	int64_t v;
+	bool overflow, underflow;
+
+	if (!lttng_counter_get_layout(counter, cpu))
+		return 0;
+	dimension_indexes = kcalloc(counter->nr_dimensions, sizeof(*dimension_indexes),
+				    GFP_KERNEL);
+	if (!dimension_indexes)
+		return -ENOMEM;
+	for (index = 0; index < (size_t) counter->allocated_elem; index++) {
+		for (dimension = 0; dimension < counter->nr_dimensions; dimension++) {
+			struct lib_counter_dimension *d = &counter->dimensions[dimension];
+
+			dimension_indexes[dimension] = (index / d->stride) % d->max_nr_elem;
+		}
+		if (lttng_counter_read(config, counter, dimension_indexes, cpu,
+				&v, &overflow, &underflow))
+			continue;
+		if (v)
+			__lttng_counter_add(config, COUNTER_ALLOC_GLOBAL, COUNTER_SYNC_GLOBAL,
+					counter, dimension_indexes, v, NULL);
+		if (overflow)
+			set_bit(index, global->overflow_bitmap);
+		if (underflow)
+			set_bit(index, global->underflow_bitmap);
+		if (v || overflow || underflow)
+			lttng_counter_clear_cpu(config, counter, dimension_indexes, cpu);
+	}
+	kfree(dimension_indexes);
+	cpumask_clear_cpu(cpu, counter->cpumask);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_cpuhp_counter_dead);
+
+#endif /* #if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,10,0)) */
+
 int lttng_counter_read(const struct lib_counter_config *config,
 		       struct lib_counter *counter,
 		       const size_t *dimension_indexes,
@@ -253,29 +431,32 @@ int lttng_counter_read(const struct lib_counter_config *config,
 
 	switch (config->alloc) {
 	case COUNTER_ALLOC_PER_CPU:
-		if (cpu < 0 || cpu >= num_possible_cpus())
-			return -EINVAL;
-		layout = per_cpu_ptr(counter->percpu_counters, cpu);
-		break;
+		lttng_fallthrough;
 	case COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL:
-		if (cpu >= 0) {
-			if (cpu >= num_possible_cpus())
-				return -EINVAL;
-			layout = per_cpu_ptr(counter->percpu_counters, cpu);
-		} else {
-			layout = &counter->global_counters;
-		}
+		/*
+		 * The global layout of per-cpu counters holds the counts of
+		 * offline cpus.
+		 */
+		if (cpu < -1 || cpu >= (int) num_possible_cpus())
+			return -EINVAL;
 		break;
 	case COUNTER_ALLOC_GLOBAL:
 		if (cpu >= 0)
 			return -EINVAL;
-		layout = &counter->global_counters;
 		break;
 	default:
 		return -EINVAL;
 	}
+	layout = lttng_counter_get_layout(counter, cpu);
+	if (!layout) {
+		/* Never brought online. */
+		*value = 0;
+		*overflow = false;
+		*underflow = false;
+		return 0;
+	}
 
-	switch (config->counter_size) {
+	switch (lttng_counter_layout_counter_size(config, cpu < 0)) {
 	case COUNTER_SIZE_8_BIT:
 	{
 		int8_t *int_p = (int8_t *) layout->counters + index;
@@ -324,22 +505,14 @@ int lttng_counter_aggregate(const struct lib_counter_config *config,
 	*overflow = false;
 	*underflow = false;
 
-	switch (config->alloc) {
-	case COUNTER_ALLOC_GLOBAL:
-		lttng_fallthrough;
-	case COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL:
-		/* Read global counter. */
-		ret = lttng_counter_read(config, counter, dimension_indexes,
-					 -1, &v, &of, &uf);
-		if (ret < 0)
-			return ret;
-		sum += v;
-		*overflow |= of;
-		*underflow |= uf;
-		break;
-	case COUNTER_ALLOC_PER_CPU:
-		break;
-	}
+	/* Read global counter, which includes offline cpus. */
+	ret = lttng_counter_read(config, counter, dimension_indexes,
+				 -1, &v, &of, &uf);
+	if (ret < 0)
+		return ret;
+	sum += v;
+	*overflow |= of;
+	*underflow |= uf;
 
 	switch (config->alloc) {
 	case COUNTER_ALLOC_GLOBAL:
@@ -347,8 +520,7 @@ int lttng_counter_aggregate(const struct lib_counter_config *config,
 	case COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL:
 		lttng_fallthrough;
 	case COUNTER_ALLOC_PER_CPU:
-		//TODO: integrate with CPU hotplug and online cpus
-		for (cpu = 0; cpu < num_possible_cpus(); cpu++) {
+		for_each_cpu(cpu, counter->cpumask) {
 			int64_t old = sum;
 
 			ret = lttng_counter_read(config, counter, dimension_indexes,
@@ -358,6 +530,11 @@ int lttng_counter_aggregate(const struct lib_counter_config *config,
 			*overflow |= of;
 			*underflow |= uf;
 			/* Overflow is defined on unsigned types. */
+			if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) {
+				sum = lttng_counter_saturate_add(old, v, S64_MIN, S64_MAX,
+						overflow, underflow);
+				continue;
+			}
 			sum = (int64_t) ((uint64_t) old + (uint64_t) v);
 			if (v > 0 && sum < old)
 				*overflow = true;
@@ -388,28 +565,22 @@ int lttng_counter_clear_cpu(const struct lib_counter_config *config,
 
 	switch (config->alloc) {
 	case COUNTER_ALLOC_PER_CPU:
-		if (cpu < 0 || cpu >= num_possible_cpus())
-			return -EINVAL;
-		layout = per_cpu_ptr(counter->percpu_counters, cpu);
-		break;
+		lttng_fallthrough;
 	case COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL:
-		if (cpu >= 0) {
-			if (cpu >= num_possible_cpus())
-				return -EINVAL;
-			layout = per_cpu_ptr(counter->percpu_counters, cpu);
-		} else {
-			layout = &counter->global_counters;
-		}
+		if (cpu < -1 || cpu >= (int) num_possible_cpus())
+			return -EINVAL;
 		break;
 	case COUNTER_ALLOC_GLOBAL:
 		if (cpu >= 0)
 			return -EINVAL;
-		layout = &counter->global_counters;
 		break;
 	default:
 		return -EINVAL;
 	}
-	switch (config->counter_size) {
+	layout = lttng_counter_get_layout(counter, cpu);
+	if (!layout)
+		return 0;
+	switch (lttng_counter_layout_counter_size(config, cpu < 0)) {
 	case COUNTER_SIZE_8_BIT:
 	{
 		int8_t *int_p = (int8_t *) layout->counters + index;
@@ -450,18 +621,155 @@ int lttng_counter_clear(const struct lib_counter_config *config,
 {
 	int cpu, ret;
 
+	/* Clear global counter, which includes offline cpus. */
+	ret = lttng_counter_clear_cpu(config, counter, dimension_indexes, -1);
+	if (ret < 0)
+		return ret;
+
 	switch (config->alloc) {
 	case COUNTER_ALLOC_GLOBAL:
-		lttng_fallthrough;
-	case COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL:
-		/* Clear global counter. */
-		ret = lttng_counter_clear_cpu(config, counter, dimension_indexes, -1);
-		if (ret < 0)
-			return ret;
 		break;
+	case COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL:
+		lttng_fallthrough;
 	case COUNTER_ALLOC_PER_CPU:
+		for_each_cpu(cpu, counter->cpumask) {
+			ret = lttng_counter_clear_cpu(config, counter, dimension_indexes, cpu);
+			if (ret < 0)
+				return ret;
+		}
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_counter_clear);
+
+/*
+ * Get the range of elements sharing the @nr_indexes leading dimension
+ * indexes @dimension_indexes. The whole counter if @nr_indexes is 0.
+ */
+int lttng_counter_get_slice(const struct lib_counter_config *config,
+			    struct lib_counter *counter,
+			    size_t nr_indexes,
+			    const size_t *dimension_indexes,
+			    size_t *index, size_t *nr_elem)
+{
+	size_t i;
+
+	if (nr_indexes > counter->nr_dimensions)
+		return -EINVAL;
+	*index = 0;
+	for (i = 0; i < nr_indexes; i++) {
+		struct lib_counter_dimension *dimension = &counter->dimensions[i];
+
+		if (dimension_indexes[i] >= dimension->max_nr_elem)
+			return -EOVERFLOW;
+		*index += dimension_indexes[i] * dimension->stride;
+	}
+	if (nr_indexes)
+		*nr_elem = counter->dimensions[nr_indexes - 1].stride;
+	else
+		*nr_elem = counter->allocated_elem;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_counter_get_slice);
+
+static inline
+void lttng_counter_range_set_bit(uint64_t *bitmap, size_t bit)
+{
+	bitmap[bit / 64] |= 1ULL << (bit % 64);
+}
+
+#define LTTNG_COUNTER_SUM_RANGE(_type)						\
+	do {									\
+		const _type *int_p = (const _type *) layout->counters + index;	\
+		size_t i;							\
+										\
+		for (i = 0; i < nr_elem; i++) {					\
+			int64_t old = values[i], v = (int64_t) READ_ONCE(int_p[i]); \
+										\
+			/* Overflow is defined on unsigned types. */		\
+			values[i] = (int64_t) ((uint64_t) old + (uint64_t) v);	\
+			if (v > 0 && values[i] < old) {				\
+				lttng_counter_range_set_bit(overflow_bitmap, i); \
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) \
+					values[i] = S64_MAX;			\
+			} else if (v < 0 && values[i] > old) {			\
+				lttng_counter_range_set_bit(underflow_bitmap, i); \
+				if (config->arithmetic == COUNTER_ARITHMETIC_SATURATE) \
+					values[i] = S64_MIN;			\
+			}							\
+		}								\
+	} while (0)
+
+/*
+ * Add the @nr_elem counters of @layout starting at @index to @values.
+ * Each layout is swept contiguously, which keeps the cross-cpu sum of a
+ * range within a single pass over each per-cpu array.
+ */
+static
+void lttng_counter_layout_sum_range(const struct lib_counter_config *config,
+				    struct lib_counter_layout *layout, bool global,
+				    size_t index, size_t nr_elem,
+				    int64_t *values,
+				    uint64_t *overflow_bitmap,
+				    uint64_t *underflow_bitmap)
+{
+	size_t end = index + nr_elem, bit;
+
+	switch (lttng_counter_layout_counter_size(config, global)) {
+	case COUNTER_SIZE_8_BIT:
+		LTTNG_COUNTER_SUM_RANGE(int8_t);
+		break;
+	case COUNTER_SIZE_16_BIT:
+		LTTNG_COUNTER_SUM_RANGE(int16_t);
+		break;
+	case COUNTER_SIZE_32_BIT:
+		LTTNG_COUNTER_SUM_RANGE(int32_t);
 		break;
+#if BITS_PER_LONG == 64
+	case COUNTER_SIZE_64_BIT:
+		LTTNG_COUNTER_SUM_RANGE(int64_t);
+		break;
+#endif
+	default:
+		WARN_ON_ONCE(1);
 	}
+	for (bit = find_next_bit(layout->overflow_bitmap, end, index); bit < end;
+			bit = find_next_bit(layout->overflow_bitmap, end, bit + 1))
+		lttng_counter_range_set_bit(overflow_bitmap, bit - index);
+	for (bit = find_next_bit(layout->underflow_bitmap, end, index); bit < end;
+			bit = find_next_bit(layout->underflow_bitmap, end, bit + 1))
+		lttng_counter_range_set_bit(underflow_bitmap, bit - index);
+}
+
+#undef LTTNG_COUNTER_SUM_RANGE
+
+/*
+ * Aggregate the @nr_elem counters starting at @index over all cpus into
+ * @values. Only the layouts of online cpus are walked: the counts of
+ * offline cpus are read from the global layout they were folded into.
+ * @overflow_bitmap and @underflow_bitmap hold one bit per element, bit
+ * (i % 64) of word (i / 64) for element i.
+ */
+int lttng_counter_aggregate_range(const struct lib_counter_config *config,
+				  struct lib_counter *counter,
+				  size_t index, size_t nr_elem,
+				  int64_t *values,
+				  uint64_t *overflow_bitmap,
+				  uint64_t *underflow_bitmap)
+{
+	int cpu;
+
+	if (index > counter->allocated_elem || nr_elem > counter->allocated_elem - index)
+		return -EOVERFLOW;
+	memset(values, 0, nr_elem * sizeof(*values));
+	memset(overflow_bitmap, 0, DIV_ROUND_UP(nr_elem, 64) * sizeof(uint64_t));
+	memset(underflow_bitmap, 0, DIV_ROUND_UP(nr_elem, 64) * sizeof(uint64_t));
+
+	lttng_counter_layout_sum_range(config, &counter->global_counters, true,
+			index, nr_elem, values, overflow_bitmap, underflow_bitmap);
 
 	switch (config->alloc) {
 	case COUNTER_ALLOC_GLOBAL:
@@ -469,11 +777,11 @@ int lttng_counter_clear(const struct lib_counter_config *config,
 	case COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL:
 		lttng_fallthrough;
 	case COUNTER_ALLOC_PER_CPU:
-		//TODO: integrate with CPU hotplug and online cpus
-		for (cpu = 0; cpu < num_possible_cpus(); cpu++) {
-			ret = lttng_counter_clear_cpu(config, counter, dimension_indexes, cpu);
-			if (ret < 0)
-				return ret;
+		for_each_cpu(cpu, counter->cpumask) {
+			lttng_counter_layout_sum_range(config,
+					lttng_counter_get_layout(counter, cpu), false,
+					index, nr_elem, values, overflow_bitmap,
+					underflow_bitmap);
 		}
 		break;
 	default:
@@ -481,7 +789,50 @@ int lttng_counter_clear(const struct lib_counter_config *config,
 	}
 	return 0;
 }
-EXPORT_SYMBOL_GPL(lttng_counter_clear);
+EXPORT_SYMBOL_GPL(lttng_counter_aggregate_range);
+
+/*
+ * Length of the mapping of one counter array. User space maps the arrays
+ * of each possible cpu contiguously, in cpu number order, followed by the
+ * global array holding the counts of offline cpus. Counters spilling into
+ * global counters on a sum step cannot be aggregated from the mapping
+ * consistently, and are not mapped.
+ */
+size_t lttng_counter_get_mmap_len(const struct lib_counter_config *config,
+				  struct lib_counter *counter)
+{
+	if (config->alloc != COUNTER_ALLOC_PER_CPU)
+		return 0;
+	return PAGE_ALIGN((size_t) config->counter_size * counter->allocated_elem);
+}
+EXPORT_SYMBOL_GPL(lttng_counter_get_mmap_len);
+
+/*
+ * Get the page at @offset of the counter array of @cpu, or of the global
+ * array if @cpu is -1. The array of a cpu which was never brought online
+ * is allocated on first access.
+ */
+struct page *lttng_counter_get_page(const struct lib_counter_config *config,
+				    struct lib_counter *counter,
+				    int cpu, unsigned long offset)
+{
+	struct lib_counter_layout *layout;
+
+	if (config->alloc != COUNTER_ALLOC_PER_CPU)
+		return NULL;
+	if (cpu < -1 || cpu >= (int) num_possible_cpus())
+		return NULL;
+	if (offset >= lttng_counter_get_mmap_len(config, counter))
+		return NULL;
+	layout = lttng_counter_get_layout(counter, cpu);
+	if (!layout) {
+		if (lttng_counter_layout_get_or_init(counter, cpu))
+			return NULL;
+		layout = lttng_counter_get_layout(counter, cpu);
+	}
+	return vmalloc_to_page((char *) layout->counters + offset);
+}
+EXPORT_SYMBOL_GPL(lttng_counter_get_page);
 
 int lttng_counter_get_nr_dimensions(const struct lib_counter_config *config,
 				    struct lib_counter *counter,
@@ -0,0 +1,193 @@
+/* SPDX-License-Identifier: (GPL-2.0-only OR LGPL-2.1-only)
+ *
+ * sparse-counter.c
+ *
+ * LTTng sparse counters, keyed by tuples of 64-bit integers.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/math64.h>
+#include <linux/log2.h>
+#include <linux/string.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <counter/sparse-counter.h>
+#include <wrapper/vmalloc.h>
+
+/*
+ * Entries are only claimed and updated by the cpu owning the table,
+ * with local atomic operations, so nested tracepoint, interrupt and NMI
+ * contexts can add concurrently. Readers and clear run on other cpus.
+ * A key is claimed by moving an empty entry to busy, writing the key,
+ * then publishing the entry as used. A context nested within a claim
+ * skips the busy entry, so the same key may end up in more than one
+ * entry of a table: readers sum the entries of equal keys.
+ */
+
+struct lib_sparse_counter *lttng_sparse_counter_create(size_t key_len,
+						       size_t nr_entries)
+{
+	struct lib_sparse_counter *counter;
+	int cpu;
+
+	if (!key_len || key_len > LIB_SPARSE_COUNTER_KEY_MAX)
+		return NULL;
+	if (!nr_entries || !is_power_of_2(nr_entries))
+		return NULL;
+	counter = kzalloc(sizeof(struct lib_sparse_counter), GFP_KERNEL);
+	if (!counter)
+		return NULL;
+	counter->key_len = key_len;
+	counter->nr_entries = nr_entries;
+	counter->tables = alloc_percpu(struct lib_sparse_counter_table);
+	if (!counter->tables)
+		goto error_alloc_percpu;
+	for (cpu = 0; cpu < num_possible_cpus(); cpu++) {
+		struct lib_sparse_counter_table *table = per_cpu_ptr(counter->tables, cpu);
+
+		table->entries = vzalloc_node(nr_entries * sizeof(struct lib_sparse_counter_entry),
+					      cpu_to_node(cpu));
+		if (!table->entries)
+			goto error_alloc_entries;
+		atomic64_set(&table->overflow, 0);
+	}
+	/*
+	 * Make sure we don't trigger recursive page faults in the
+	 * tracing fast path.
+	 */
+	wrapper_vmalloc_sync_mappings();
+	return counter;
+
+error_alloc_entries:
+	for (cpu = 0; cpu < num_possible_cpus(); cpu++)
+		vfree(per_cpu_ptr(counter->tables, cpu)->entries);
+	free_percpu(counter->tables);
+error_alloc_percpu:
+	kfree(counter);
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(lttng_sparse_counter_create);
+
+void lttng_sparse_counter_destroy(struct lib_sparse_counter *counter)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < num_possible_cpus(); cpu++)
+		vfree(per_cpu_ptr(counter->tables, cpu)->entries);
+	free_percpu(counter->tables);
+	kfree(counter);
+}
+EXPORT_SYMBOL_GPL(lttng_sparse_counter_destroy);
+
+static
+bool lttng_sparse_counter_key_match(struct lib_sparse_counter *counter,
+				    const struct lib_sparse_counter_entry *entry,
+				    const uint64_t *key)
+{
+	return !memcmp(entry->key, key, counter->key_len * sizeof(uint64_t));
+}
+
+/*
+ * Add @v to the counter of @key on the current cpu. Called with
+ * preemption disabled. Keys which find no entry within
+ * LIB_SPARSE_COUNTER_MAX_PROBE probes, when the table is full or too
+ * crowded, are accounted in the table overflow rather than evicting
+ * existing keys.
+ */
+void lttng_sparse_counter_add(struct lib_sparse_counter *counter,
+			      const uint64_t *key, int64_t v)
+{
+	struct lib_sparse_counter_table *table = this_cpu_ptr(counter->tables);
+	size_t mask = counter->nr_entries - 1, i;
+	u32 hash;
+
+	hash = jhash2((const u32 *) key, counter->key_len * 2, 0);
+	for (i = 0; i < min_t(size_t, LIB_SPARSE_COUNTER_MAX_PROBE, counter->nr_entries); i++) {
+		struct lib_sparse_counter_entry *entry = &table->entries[(hash + i) & mask];
+
+		switch (READ_ONCE(entry->state)) {
+		case LIB_SPARSE_COUNTER_ENTRY_USED:
+			if (!lttng_sparse_counter_key_match(counter, entry, key))
+				break;
+			local64_add(v, &entry->value);
+			return;
+		case LIB_SPARSE_COUNTER_ENTRY_EMPTY:
+			if (cmpxchg_local(&entry->state, LIB_SPARSE_COUNTER_ENTRY_EMPTY,
+					LIB_SPARSE_COUNTER_ENTRY_BUSY) != LIB_SPARSE_COUNTER_ENTRY_EMPTY)
+				break;	/* Claimed by a nested context. */
+			memcpy(entry->key, key, counter->key_len * sizeof(uint64_t));
+			local64_set(&entry->value, v);
+			/* Publish the key and value before the entry. */
+			smp_store_release(&entry->state, LIB_SPARSE_COUNTER_ENTRY_USED);
+			return;
+		case LIB_SPARSE_COUNTER_ENTRY_BUSY:
+			break;
+		}
+	}
+	atomic64_add(v, &table->overflow);
+}
+EXPORT_SYMBOL_GPL(lttng_sparse_counter_add);
+
+int lttng_sparse_counter_read_next(struct lib_sparse_counter *counter,
+				   uint64_t *pos, uint64_t *key,
+				   int *cpu, int64_t *value)
+{
+	uint64_t end = (uint64_t) num_possible_cpus() * counter->nr_entries;
+
+	for (; *pos < end; (*pos)++) {
+		struct lib_sparse_counter_table *table;
+		struct lib_sparse_counter_entry *entry;
+		int entry_cpu = (int) div_u64(*pos, counter->nr_entries);
+
+		table = per_cpu_ptr(counter->tables, entry_cpu);
+		entry = &table->entries[*pos & (counter->nr_entries - 1)];
+		/* Matches store-release in lttng_sparse_counter_add. */
+		if (smp_load_acquire(&entry->state) != LIB_SPARSE_COUNTER_ENTRY_USED)
+			continue;
+		memcpy(key, entry->key, counter->key_len * sizeof(uint64_t));
+		*value = local64_read(&entry->value);
+		*cpu = entry_cpu;
+		(*pos)++;
+		return 0;
+	}
+	return -ENOENT;
+}
+EXPORT_SYMBOL_GPL(lttng_sparse_counter_read_next);
+
+int64_t lttng_sparse_counter_read_overflow(struct lib_sparse_counter *counter)
+{
+	int64_t sum = 0;
+	int cpu;
+
+	for (cpu = 0; cpu < num_possible_cpus(); cpu++)
+		sum += atomic64_read(&per_cpu_ptr(counter->tables, cpu)->overflow);
+	return sum;
+}
+EXPORT_SYMBOL_GPL(lttng_sparse_counter_read_overflow);
+
+/*
+ * Release all the entries. Only used entries are released, entries being
+ * claimed concurrently are kept. Values added concurrently with the clear
+ * may be lost.
+ */
+void lttng_sparse_counter_clear(struct lib_sparse_counter *counter)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < num_possible_cpus(); cpu++) {
+		struct lib_sparse_counter_table *table = per_cpu_ptr(counter->tables, cpu);
+		size_t i;
+
+		for (i = 0; i < counter->nr_entries; i++)
+			(void) cmpxchg(&table->entries[i].state, LIB_SPARSE_COUNTER_ENTRY_USED,
+					LIB_SPARSE_COUNTER_ENTRY_EMPTY);
+		atomic64_set(&table->overflow, 0);
+		cond_resched();
+	}
+}
+EXPORT_SYMBOL_GPL(lttng_sparse_counter_clear);
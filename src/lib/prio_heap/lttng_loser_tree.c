@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: MIT
+ *
+ * lttng_loser_tree.c
+ *
+ * Tournament (loser) tree merging sorted streams by 64-bit keys. Based on
+ * Knuth, TAOCP vol. 3, section 5.4.1.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/log2.h>
+#include <linux/slab.h>
+#include <lttng/loser_tree.h>
+#include <wrapper/vmalloc.h>
+
+/*
+ * Leaf a wins against leaf b if it has a lower key, or the same key and a
+ * lower index.
+ */
+static inline
+bool leaf_wins(const u64 *keys, unsigned int a, unsigned int b)
+{
+	return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+}
+
+/*
+ * Play all matches of the sub-tree rooted at @node, returning its winner.
+ * Recursion depth is bounded by log2(nr_leaves).
+ */
+static
+unsigned int loser_tree_play(struct lttng_loser_tree *tree, unsigned int node)
+{
+	unsigned int l, r;
+
+	if (node >= tree->nr_leaves)
+		return node - tree->nr_leaves;
+	l = loser_tree_play(tree, node << 1);
+	r = loser_tree_play(tree, (node << 1) + 1);
+	if (leaf_wins(tree->keys, l, r)) {
+		tree->losers[node] = r;
+		return l;
+	} else {
+		tree->losers[node] = l;
+		return r;
+	}
+}
+
+void lttng_loser_tree_rebuild(struct lttng_loser_tree *tree)
+{
+	tree->losers[0] = loser_tree_play(tree, 1);
+}
+
+int lttng_loser_tree_init(struct lttng_loser_tree *tree,
+		unsigned int nr_leaves, gfp_t gfpmask)
+{
+	unsigned int i;
+
+	tree->nr_leaves = roundup_pow_of_two(max(nr_leaves, 1U));
+	tree->keys = lttng_kvmalloc(tree->nr_leaves * sizeof(*tree->keys),
+				    gfpmask);
+	if (!tree->keys)
+		return -ENOMEM;
+	tree->losers = lttng_kvmalloc(tree->nr_leaves * sizeof(*tree->losers),
+				      gfpmask);
+	if (!tree->losers) {
+		lttng_kvfree(tree->keys);
+		return -ENOMEM;
+	}
+	for (i = 0; i < tree->nr_leaves; i++)
+		tree->keys[i] = LTTNG_LOSER_TREE_EMPTY;
+	lttng_loser_tree_rebuild(tree);
+	return 0;
+}
+
+void lttng_loser_tree_free(struct lttng_loser_tree *tree)
+{
+	lttng_kvfree(tree->losers);
+	lttng_kvfree(tree->keys);
+}
+
+unsigned int lttng_loser_tree_replace_winner(struct lttng_loser_tree *tree,
+		u64 key)
+{
+	unsigned int winner = tree->losers[0], node;
+
+	tree->keys[winner] = key;
+	for (node = (winner + tree->nr_leaves) >> 1; node; node >>= 1) {
+		unsigned int loser = tree->losers[node];
+
+		if (leaf_wins(tree->keys, loser, winner)) {
+			tree->losers[node] = winner;
+			winner = loser;
+		}
+	}
+	tree->losers[0] = winner;
+	return winner;
+}
@@ -29,12 +29,14 @@
  * @size: total size of the buffer
  * @num_subbuf: number of subbuffers
  * @extra_reader_sb: need extra subbuffer for reader
+ * @num_standby_subbuf: number of standby subbuffers for frozen snapshots
  */
 static
 int lib_ring_buffer_backend_allocate(const struct lttng_kernel_ring_buffer_config *config,
 				     struct lttng_kernel_ring_buffer_backend *bufb,
 				     size_t size, size_t num_subbuf,
-				     int extra_reader_sb)
+				     int extra_reader_sb,
+				     size_t num_standby_subbuf)
 {
 	struct channel_backend *chanb = &bufb->chan->backend;
 	unsigned long j, num_pages, num_pages_per_subbuf, page_idx = 0;
@@ -71,6 +73,9 @@ int lib_ring_buffer_backend_allocate(const struct lttng_kernel_ring_buffer_confi
 		num_pages += num_pages_per_subbuf; /* Add pages for reader */
 		num_subbuf_alloc++;
 	}
+	/* Add pages for standby subbuffers */
+	num_pages += num_pages_per_subbuf * num_standby_subbuf;
+	num_subbuf_alloc += num_standby_subbuf;
 
 	pages = vmalloc_node(ALIGN(sizeof(*pages) * num_pages,
 				   1 << INTERNODE_CACHE_SHIFT),
@@ -128,6 +133,21 @@ int lib_ring_buffer_backend_allocate(const struct lttng_kernel_ring_buffer_confi
 	else
 		bufb->buf_rsb.id = subbuffer_id(config, 0, 1, 0);
 
+	/* Allocate standby subbuffer table, following the reader subbuffer */
+	if (num_standby_subbuf) {
+		bufb->buf_ssb = lttng_kvzalloc_node(ALIGN(
+				sizeof(struct lttng_kernel_ring_buffer_backend_subbuffer)
+				* num_standby_subbuf,
+				1 << INTERNODE_CACHE_SHIFT),
+				GFP_KERNEL | __GFP_NOWARN,
+				cpu_to_node(max(bufb->cpu, 0)));
+		if (unlikely(!bufb->buf_ssb))
+			goto free_wsb;
+		for (i = 0; i < num_standby_subbuf; i++)
+			bufb->buf_ssb[i].id = subbuffer_id(config, 0, 1,
+						num_subbuf + 1 + i);
+	}
+
 	/* Allocate subbuffer packet counter table */
 	bufb->buf_cnt = lttng_kvzalloc_node(ALIGN(
 				sizeof(struct lttng_kernel_ring_buffer_backend_counts)
@@ -136,7 +156,7 @@ int lib_ring_buffer_backend_allocate(const struct lttng_kernel_ring_buffer_confi
 			GFP_KERNEL | __GFP_NOWARN,
 			cpu_to_node(max(bufb->cpu, 0)));
 	if (unlikely(!bufb->buf_cnt))
-		goto free_wsb;
+		goto free_ssb;
 
 	/* Assign pages to page index */
 	for (i = 0; i < num_subbuf_alloc; i++) {
@@ -146,7 +166,9 @@ int lib_ring_buffer_backend_allocate(const struct lttng_kernel_ring_buffer_confi
 			bufb->array[i]->p[j].pfn = page_to_pfn(pages[page_idx]);
 			page_idx++;
 		}
-		if (config->output == RING_BUFFER_MMAP) {
+		/* Iterator records are described by their mmap offset. */
+		if (config->output == RING_BUFFER_MMAP
+				|| config->output == RING_BUFFER_ITERATOR) {
 			bufb->array[i]->mmap_offset = mmap_offset;
 			mmap_offset += subbuf_size;
 		}
@@ -161,6 +183,8 @@ int lib_ring_buffer_backend_allocate(const struct lttng_kernel_ring_buffer_confi
 	vfree(pages);
 	return 0;
 
+free_ssb:
+	lttng_kvfree(bufb->buf_ssb);
 free_wsb:
 	lttng_kvfree(bufb->buf_wsb);
 free_array:
@@ -189,7 +213,8 @@ int lib_ring_buffer_backend_create(struct lttng_kernel_ring_buffer_backend *bufb
 
 	return lib_ring_buffer_backend_allocate(config, bufb, chanb->buf_size,
 						chanb->num_subbuf,
-						chanb->extra_reader_sb);
+						chanb->extra_reader_sb,
+						chanb->num_standby_subbuf);
 }
 
 void lib_ring_buffer_backend_free(struct lttng_kernel_ring_buffer_backend *bufb)
@@ -197,11 +222,10 @@ void lib_ring_buffer_backend_free(struct lttng_kernel_ring_buffer_backend *bufb)
 	struct channel_backend *chanb = &bufb->chan->backend;
 	unsigned long i, j, num_subbuf_alloc;
 
-	num_subbuf_alloc = chanb->num_subbuf;
-	if (chanb->extra_reader_sb)
-		num_subbuf_alloc++;
+	num_subbuf_alloc = channel_backend_num_subbuf_alloc(chanb);
 
 	lttng_kvfree(bufb->buf_wsb);
+	lttng_kvfree(bufb->buf_ssb);
 	lttng_kvfree(bufb->buf_cnt);
 	for (i = 0; i < num_subbuf_alloc; i++) {
 		for (j = 0; j < bufb->num_pages_per_subbuf; j++)
@@ -219,17 +243,18 @@ void lib_ring_buffer_backend_reset(struct lttng_kernel_ring_buffer_backend *bufb
 	unsigned long num_subbuf_alloc;
 	unsigned int i;
 
-	num_subbuf_alloc = chanb->num_subbuf;
-	if (chanb->extra_reader_sb)
-		num_subbuf_alloc++;
+	num_subbuf_alloc = channel_backend_num_subbuf_alloc(chanb);
 
 	for (i = 0; i < chanb->num_subbuf; i++)
 		bufb->buf_wsb[i].id = subbuffer_id(config, 0, 1, i);
 	if (chanb->extra_reader_sb)
 		bufb->buf_rsb.id = subbuffer_id(config, 0, 1,
-						num_subbuf_alloc - 1);
+						chanb->num_subbuf);
 	else
 		bufb->buf_rsb.id = subbuffer_id(config, 0, 1, 0);
+	for (i = 0; i < chanb->num_standby_subbuf; i++)
+		bufb->buf_ssb[i].id = subbuffer_id(config, 0, 1,
+					chanb->num_subbuf + 1 + i);
 
 	for (i = 0; i < num_subbuf_alloc; i++) {
 		/* Don't reset mmap_offset */
@@ -352,6 +377,8 @@ int lib_ring_buffer_cpu_hp_callback(struct notifier_block *nb,
  * @parent: dentry of parent directory, %NULL for root directory
  * @subbuf_size: size of sub-buffers (> PAGE_SIZE, power of 2)
  * @num_subbuf: number of sub-buffers (power of 2)
+ * @num_standby_subbuf: number of standby sub-buffers for frozen snapshots
+ *                      (overwrite mode only, 0 to disable)
  *
  * Returns channel pointer if successful, %NULL otherwise.
  *
@@ -364,7 +391,8 @@ int lib_ring_buffer_cpu_hp_callback(struct notifier_block *nb,
 int channel_backend_init(struct channel_backend *chanb,
 			 const char *name,
 			 const struct lttng_kernel_ring_buffer_config *config,
-			 void *priv, size_t subbuf_size, size_t num_subbuf)
+			 void *priv, size_t subbuf_size, size_t num_subbuf,
+			 size_t num_standby_subbuf)
 {
 	struct lttng_kernel_ring_buffer_channel *chan = container_of(chanb, struct lttng_kernel_ring_buffer_channel, backend);
 	unsigned int i;
@@ -391,8 +419,14 @@ int channel_backend_init(struct channel_backend *chanb,
 	 */
 	if (config->mode == RING_BUFFER_OVERWRITE && num_subbuf < 2)
 		return -EINVAL;
+	/*
+	 * Standby subbuffers are exchanged with writer subbuffers, which
+	 * requires the overwrite mode subbuffer exchange protocol.
+	 */
+	if (num_standby_subbuf && config->mode != RING_BUFFER_OVERWRITE)
+		return -EINVAL;
 
-	ret = subbuffer_id_check_index(config, num_subbuf);
+	ret = subbuffer_id_check_index(config, num_subbuf + 1 + num_standby_subbuf);
 	if (ret)
 		return ret;
 
@@ -405,6 +439,7 @@ int channel_backend_init(struct channel_backend *chanb,
 	chanb->extra_reader_sb =
 			(config->mode == RING_BUFFER_OVERWRITE) ? 1 : 0;
 	chanb->num_subbuf = num_subbuf;
+	chanb->num_standby_subbuf = num_standby_subbuf;
 	strlcpy(chanb->name, name, NAME_MAX);
 	memcpy(&chanb->config, config, sizeof(chanb->config));
 
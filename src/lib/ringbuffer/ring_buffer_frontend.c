@@ -182,6 +182,7 @@ void lib_ring_buffer_reset(struct lttng_kernel_ring_buffer *buf)
 	v_set(config, &buf->records_count, 0);
 	v_set(config, &buf->records_overrun, 0);
 	buf->finalized = 0;
+	buf->frozen_count = 0;
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_reset);
 
@@ -835,6 +836,8 @@ static void channel_free(struct lttng_kernel_ring_buffer_channel *chan)
  *                         padding to let readers get those sub-buffers.
  *                         Used for live streaming.
  * @read_timer_interval: Time interval (in us) to wake up pending readers.
+ * @num_standby_subbuf: number of standby subbuffers per buffer, used by
+ *                      frozen snapshots (overwrite mode only, 0 to disable).
  *
  * Holds cpu hotplug.
  * Returns NULL on failure.
@@ -843,7 +846,8 @@ struct lttng_kernel_ring_buffer_channel *channel_create(const struct lttng_kerne
 		   const char *name, void *priv, void *buf_addr,
 		   size_t subbuf_size,
 		   size_t num_subbuf, unsigned int switch_timer_interval,
-		   unsigned int read_timer_interval)
+		   unsigned int read_timer_interval,
+		   size_t num_standby_subbuf)
 {
 	int ret;
 	struct lttng_kernel_ring_buffer_channel *chan;
@@ -857,7 +861,7 @@ struct lttng_kernel_ring_buffer_channel *channel_create(const struct lttng_kerne
 		return NULL;
 
 	ret = channel_backend_init(&chan->backend, name, config, priv,
-				   subbuf_size, num_subbuf);
+				   subbuf_size, num_subbuf, num_standby_subbuf);
 	if (ret)
 		goto error;
 
@@ -1057,6 +1061,7 @@ void lib_ring_buffer_release_read(struct lttng_kernel_ring_buffer *buf)
 	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
 
 	CHAN_WARN_ON(chan, atomic_long_read(&buf->active_readers) != 1);
+	buf->frozen_count = 0;
 	lttng_smp_mb__before_atomic();
 	atomic_long_dec(&buf->active_readers);
 	kref_put(&chan->ref, channel_release);
@@ -1239,17 +1244,18 @@ static void lib_ring_buffer_flush_read_subbuf_dcache(
 }
 #endif
 
-/**
- * lib_ring_buffer_get_subbuf - get exclusive access to subbuffer for reading
- * @buf: ring buffer
- * @consumed: consumed count indicating the position where to read
+/*
+ * Exchange the fully committed subbuffer at position @consumed with the
+ * reader-owned subbuffer @sb.
  *
  * Returns -ENODATA if buffer is finalized, -EAGAIN if there is currently no
- * data to read at consumed position, or 0 if the get operation succeeds.
+ * data to read at consumed position, or 0 if the exchange succeeds.
  * Busy-loop trying to get data if the tick_nohz sequence lock is held.
  */
-int lib_ring_buffer_get_subbuf(struct lttng_kernel_ring_buffer *buf,
-			       unsigned long consumed)
+static
+int lib_ring_buffer_grab_subbuf(struct lttng_kernel_ring_buffer *buf,
+				unsigned long consumed,
+				struct lttng_kernel_ring_buffer_backend_subbuffer *sb)
 {
 	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
 	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
@@ -1257,13 +1263,6 @@ int lib_ring_buffer_get_subbuf(struct lttng_kernel_ring_buffer *buf,
 	int ret;
 	int finalized;
 
-	if (buf->get_subbuf) {
-		/*
-		 * Reader is trying to get a subbuffer twice.
-		 */
-		CHAN_WARN_ON(chan, 1);
-		return -EBUSY;
-	}
 retry:
 	finalized = LTTNG_READ_ONCE(buf->finalized);
 	/*
@@ -1372,17 +1371,10 @@ retry:
 	 * access to. Also checks that the "consumed" buffer count we are
 	 * looking for matches the one contained in the subbuffer id.
 	 */
-	ret = update_read_sb_index(config, &buf->backend, &chan->backend,
-				   consumed_idx, buf_trunc_val(consumed, chan));
+	ret = exchange_sb_index(config, &buf->backend, sb,
+				consumed_idx, buf_trunc_val(consumed, chan));
 	if (ret)
 		goto retry;
-	subbuffer_id_clear_noref(config, &buf->backend.buf_rsb.id);
-
-	buf->get_subbuf_consumed = consumed;
-	buf->get_subbuf = 1;
-
-	lib_ring_buffer_flush_read_subbuf_dcache(config, chan, buf);
-
 	return 0;
 
 nodata:
@@ -1397,6 +1389,42 @@ nodata:
 	else
 		return -EAGAIN;
 }
+
+/**
+ * lib_ring_buffer_get_subbuf - get exclusive access to subbuffer for reading
+ * @buf: ring buffer
+ * @consumed: consumed count indicating the position where to read
+ *
+ * Returns -ENODATA if buffer is finalized, -EAGAIN if there is currently no
+ * data to read at consumed position, or 0 if the get operation succeeds.
+ * Busy-loop trying to get data if the tick_nohz sequence lock is held.
+ */
+int lib_ring_buffer_get_subbuf(struct lttng_kernel_ring_buffer *buf,
+			       unsigned long consumed)
+{
+	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
+	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
+	int ret;
+
+	if (buf->get_subbuf) {
+		/*
+		 * Reader is trying to get a subbuffer twice.
+		 */
+		CHAN_WARN_ON(chan, 1);
+		return -EBUSY;
+	}
+	ret = lib_ring_buffer_grab_subbuf(buf, consumed, &buf->backend.buf_rsb);
+	if (ret)
+		return ret;
+	subbuffer_id_clear_noref(config, &buf->backend.buf_rsb.id);
+
+	buf->get_subbuf_consumed = consumed;
+	buf->get_subbuf = 1;
+
+	lib_ring_buffer_flush_read_subbuf_dcache(config, chan, buf);
+
+	return 0;
+}
 EXPORT_SYMBOL_GPL(lib_ring_buffer_get_subbuf);
 
 /**
@@ -1438,6 +1466,13 @@ void lib_ring_buffer_put_subbuf(struct lttng_kernel_ring_buffer *buf)
 		     && subbuffer_id_is_noref(config, bufb->buf_rsb.id));
 	subbuffer_id_set_noref(config, &bufb->buf_rsb.id);
 
+	if (buf->get_frozen_subbuf) {
+		/* Hand the frozen subbuffer back to the frozen set. */
+		swap(bufb->buf_rsb.id, bufb->buf_ssb[buf->frozen_index].id);
+		buf->get_frozen_subbuf = 0;
+		return;
+	}
+
 	/*
 	 * Exchange the reader subbuffer with the one we put in its place in the
 	 * writer subbuffer table. Expect the original consumed count. If
@@ -1456,6 +1491,122 @@ void lib_ring_buffer_put_subbuf(struct lttng_kernel_ring_buffer *buf)
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_put_subbuf);
 
+/**
+ * lib_ring_buffer_snapshot_freeze - freeze the readable subbuffers
+ * @buf: ring buffer
+ * @nr_frozen: number of frozen subbuffers (output)
+ *
+ * Flight recorder snapshot which does not require stopping the writers:
+ * each fully committed subbuffer between the consumed position and the
+ * write head is exchanged with a standby subbuffer, using the same
+ * exchange protocol as lib_ring_buffer_get_subbuf(). Writers keep going
+ * on the standby pages, while the frozen subbuffers can be read at the
+ * reader's pace with lib_ring_buffer_get_frozen_subbuf(). The consumed
+ * position is pushed past the frozen subbuffers.
+ *
+ * The frozen subbuffers are ordered from oldest to newest. A subbuffer
+ * overwritten by the writer while freezing is skipped.
+ *
+ * Returns -EINVAL if the buffer has no standby subbuffers, -EBUSY if a
+ * subbuffer is held by the reader or if a frozen snapshot is in progress,
+ * 0 otherwise.
+ */
+int lib_ring_buffer_snapshot_freeze(struct lttng_kernel_ring_buffer *buf,
+				    unsigned long *nr_frozen)
+{
+	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
+	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
+	unsigned long num_standby = chan->backend.num_standby_subbuf;
+	unsigned long consumed, consumed_cur, write_offset, count = 0;
+	int ret;
+
+	if (config->mode != RING_BUFFER_OVERWRITE || !num_standby)
+		return -EINVAL;
+	if (buf->get_subbuf || buf->frozen_count)
+		return -EBUSY;
+
+	consumed = subbuf_trunc(atomic_long_read(&buf->consumed), chan);
+	write_offset = v_read(config, &buf->offset);
+	/* Only keep the newest subbuffers if there are more than standby ones. */
+	if ((long) (subbuf_trunc(write_offset, chan) - consumed)
+	    > (long) (num_standby << chan->backend.subbuf_size_order))
+		consumed = subbuf_trunc(write_offset, chan)
+			- (num_standby << chan->backend.subbuf_size_order);
+
+	while (count < num_standby) {
+		ret = lib_ring_buffer_grab_subbuf(buf, consumed,
+				&buf->backend.buf_ssb[count]);
+		if (!ret) {
+			count++;
+			consumed += chan->backend.subbuf_size;
+			continue;
+		}
+		/*
+		 * Either the writer head is reached, or the writer pushed the
+		 * consumed position past the subbuffer we tried to freeze.
+		 */
+		consumed_cur = subbuf_trunc(atomic_long_read(&buf->consumed), chan);
+		if ((long) (consumed_cur - consumed) <= 0)
+			break;
+		consumed = consumed_cur;
+	}
+
+	if (count)
+		lib_ring_buffer_move_consumer(buf, consumed);
+	buf->frozen_count = count;
+	*nr_frozen = count;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_snapshot_freeze);
+
+/**
+ * lib_ring_buffer_get_frozen_subbuf - get exclusive access to a frozen subbuffer
+ * @buf: ring buffer
+ * @index: index of the frozen subbuffer, from oldest to newest
+ *
+ * The frozen subbuffer becomes the reader subbuffer until
+ * lib_ring_buffer_put_subbuf() is called, so it can be read with the same
+ * operations as a subbuffer obtained by lib_ring_buffer_get_subbuf().
+ */
+int lib_ring_buffer_get_frozen_subbuf(struct lttng_kernel_ring_buffer *buf,
+				      unsigned long index)
+{
+	struct lttng_kernel_ring_buffer_backend *bufb = &buf->backend;
+	struct lttng_kernel_ring_buffer_channel *chan = bufb->chan;
+	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
+
+	if (buf->get_subbuf)
+		return -EBUSY;
+	if (index >= buf->frozen_count)
+		return -EINVAL;
+	swap(bufb->buf_rsb.id, bufb->buf_ssb[index].id);
+	subbuffer_id_clear_noref(config, &bufb->buf_rsb.id);
+	buf->frozen_index = index;
+	buf->get_frozen_subbuf = 1;
+	buf->get_subbuf = 1;
+
+	lib_ring_buffer_flush_read_subbuf_dcache(config, chan, buf);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_get_frozen_subbuf);
+
+/**
+ * lib_ring_buffer_snapshot_thaw - release the frozen subbuffers
+ * @buf: ring buffer
+ *
+ * The frozen subbuffers become standby subbuffers for the next frozen
+ * snapshot.
+ */
+int lib_ring_buffer_snapshot_thaw(struct lttng_kernel_ring_buffer *buf)
+{
+	if (buf->get_frozen_subbuf)
+		return -EBUSY;
+	buf->frozen_count = 0;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_snapshot_thaw);
+
 /*
  * cons_offset is an iterator on all subbuffer offsets between the reader
  * position and the writer position. (inclusive)
@@ -2018,6 +2169,7 @@ retry:
 	offsets->switch_new_end = 0;
 	offsets->switch_old_end = 0;
 	offsets->pre_header_padding = 0;
+	ctx->priv.rflags &= ~RING_BUFFER_RFLAG_PACKET_START;
 
 	ctx->priv.tsc = config->cb.ring_buffer_clock_read(chan);
 	if ((int64_t) ctx->priv.tsc == -EIO)
@@ -2112,6 +2264,14 @@ retry:
 			v_inc(config, &buf->records_lost_wrap);
 			return -EIO;
 		}
+		/*
+		 * The new sub-buffer begin timestamp is this record timestamp
+		 * (see lib_ring_buffer_switch_new_start()), so the sub-buffer
+		 * header anchors the time value: the record never needs the
+		 * full timestamp, even after a long quiet period.
+		 */
+		ctx->priv.rflags &= ~RING_BUFFER_RFLAG_FULL_TSC;
+		ctx->priv.rflags |= RING_BUFFER_RFLAG_PACKET_START;
 		offsets->size =
 			config->cb.record_header_size(config, chan,
 						offsets->begin,
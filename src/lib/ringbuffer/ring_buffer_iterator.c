@@ -3,8 +3,9 @@
  * ring_buffer_iterator.c
  *
  * Ring buffer and channel iterators. Get each event of a channel in order. Uses
- * a prio heap for per-cpu buffers, giving a O(log(NR_CPUS)) algorithmic
- * complexity for the "get next event" operation.
+ * a loser tree for per-cpu buffers, giving a O(log(NR_CPUS)) algorithmic
+ * complexity for the "get next event" operation, with a single comparison per
+ * level on a contiguous array of timestamps.
  *
  * Copyright (C) 2010-2012 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
  */
@@ -28,6 +29,35 @@
  */
 #define MAX_CLOCK_DELTA		(jiffies_to_usecs(1) * 1000)
 
+/*
+ * Decode the headers of the next records of the current sub-buffer, so the
+ * sub-buffer is walked in batches rather than one record per call.
+ */
+static
+void lib_ring_buffer_iter_refill_run(const struct lttng_kernel_ring_buffer_config *config,
+				     struct lttng_kernel_ring_buffer_channel *chan,
+				     struct lttng_kernel_ring_buffer *buf)
+{
+	struct lttng_kernel_ring_buffer_iter *iter = &buf->iter;
+	unsigned long offset = iter->read_offset;
+	unsigned int i;
+
+	for (i = 0; i < RING_BUFFER_ITER_RUN_LEN; i++) {
+		struct lttng_kernel_ring_buffer_iter_record *rec = &iter->run[i];
+
+		if (offset - iter->consumed >= iter->data_size)
+			break;
+		rec->offset = offset;
+		config->cb.record_get(config, chan, buf, offset,
+				      &rec->header_len,
+				      &rec->payload_len,
+				      &rec->timestamp);
+		offset += rec->header_len + rec->payload_len;
+	}
+	iter->run_pos = 0;
+	iter->run_len = i;
+}
+
 /**
  * lib_ring_buffer_get_next_record - Get the next record in a buffer.
  * @chan: channel
@@ -73,18 +103,24 @@ restart:
 		iter->read_offset = iter->consumed;
 		/* skip header */
 		iter->read_offset += config->cb.subbuffer_header_size();
+		iter->run_pos = iter->run_len = 0;
 		iter->state = ITER_TEST_RECORD;
 		goto restart;
 	case ITER_TEST_RECORD:
-		if (iter->read_offset - iter->consumed >= iter->data_size) {
+		if (iter->run_pos == iter->run_len) {
+			CHAN_WARN_ON(chan, !config->cb.record_get);
+			lib_ring_buffer_iter_refill_run(config, chan, buf);
+		}
+		if (iter->run_pos == iter->run_len) {
 			iter->state = ITER_PUT_SUBBUF;
 		} else {
-			CHAN_WARN_ON(chan, !config->cb.record_get);
-			config->cb.record_get(config, chan, buf,
-					      iter->read_offset,
-					      &iter->header_len,
-					      &iter->payload_len,
-					      &iter->timestamp);
+			struct lttng_kernel_ring_buffer_iter_record *rec =
+				&iter->run[iter->run_pos++];
+
+			CHAN_WARN_ON(chan, rec->offset != iter->read_offset);
+			iter->header_len = rec->header_len;
+			iter->payload_len = rec->payload_len;
+			iter->timestamp = rec->timestamp;
 			iter->read_offset += iter->header_len;
 			subbuffer_consume_record(config, &buf->backend);
 			iter->state = ITER_NEXT_RECORD;
@@ -124,21 +160,130 @@ void lib_ring_buffer_put_current_record(struct lttng_kernel_ring_buffer *buf)
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_put_current_record);
 
-static int buf_is_higher(void *a, void *b)
+/*
+ * Get the current record of @buf if it has not been described in a batch
+ * yet, else the next one.
+ */
+static
+ssize_t lib_ring_buffer_batch_peek(struct lttng_kernel_ring_buffer_channel *chan,
+				   struct lttng_kernel_ring_buffer *buf)
 {
-	struct lttng_kernel_ring_buffer *bufa = a;
-	struct lttng_kernel_ring_buffer *bufb = b;
+	ssize_t len;
 
-	/* Consider lowest timestamps to be at the top of the heap */
-	return (bufa->iter.timestamp < bufb->iter.timestamp);
+	if (buf->iter.batch_pending)
+		return buf->iter.payload_len;
+	len = lib_ring_buffer_get_next_record(chan, buf);
+	if (len >= 0)
+		buf->iter.batch_pending = 1;
+	return len;
+}
+
+/**
+ * lib_ring_buffer_get_next_record_batch - Describe the next records of buffers.
+ * @chan: channel
+ * @bufs: buffers of @chan, opened for reading
+ * @nr_bufs: number of buffers
+ * @descs: record descriptors (output)
+ * @count: maximum number of records to describe
+ *
+ * Records are merged with a loser tree keyed by timestamp, and described by
+ * their payload offset in the mmap area of their buffer. The batch ends after
+ * the last record of a sub-buffer, so every record described stays in a
+ * sub-buffer held by the reader until the next call, which consumes it. Only
+ * the buffers holding a record when the batch starts are merged: a buffer
+ * found empty may later provide records older than those described.
+ *
+ * Returns the number of records described, -EAGAIN if all buffers are empty,
+ * -ENODATA if all buffers are empty and finalized. The buffers must already be
+ * opened for reading, and must not be read with lib_ring_buffer_get_next_record
+ * by other means.
+ */
+ssize_t lib_ring_buffer_get_next_record_batch(struct lttng_kernel_ring_buffer_channel *chan,
+		struct lttng_kernel_ring_buffer **bufs, unsigned int nr_bufs,
+		struct lttng_kernel_abi_ring_buffer_record_desc *descs,
+		unsigned int count)
+{
+	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
+	struct lttng_loser_tree tree;
+	unsigned int i, nr = 0, nr_finalized = 0;
+	ssize_t len;
+	int ret;
+
+	ret = lttng_loser_tree_init(&tree, nr_bufs, GFP_KERNEL);
+	if (ret)
+		return ret;
+	for (i = 0; i < nr_bufs; i++) {
+		len = lib_ring_buffer_batch_peek(chan, bufs[i]);
+		if (len >= 0)
+			lttng_loser_tree_set_key(&tree, i, bufs[i]->iter.timestamp);
+		else if (len == -ENODATA)
+			nr_finalized++;
+		else
+			CHAN_WARN_ON(chan, len != -EAGAIN);
+	}
+	lttng_loser_tree_rebuild(&tree);
+
+	while (nr < count) {
+		unsigned int leaf = lttng_loser_tree_winner(&tree);
+		struct lttng_kernel_abi_ring_buffer_record_desc *desc;
+		struct lttng_kernel_ring_buffer *buf;
+		struct lttng_kernel_ring_buffer_iter *iter;
+		unsigned long sb_bindex;
+
+		if (lttng_loser_tree_key(&tree, leaf) == LTTNG_LOSER_TREE_EMPTY)
+			break;
+		buf = bufs[leaf];
+		iter = &buf->iter;
+		sb_bindex = subbuffer_id_get_index(config, buf->backend.buf_rsb.id);
+		desc = &descs[nr++];
+		desc->offset = buf->backend.array[sb_bindex]->mmap_offset
+				+ subbuf_offset(iter->read_offset, chan);
+		desc->timestamp = iter->timestamp;
+		desc->len = iter->payload_len;
+		desc->cpu = max(buf->backend.cpu, 0);
+		iter->batch_pending = 0;
+		/* Getting the next record would put the sub-buffer. */
+		if (iter->read_offset + iter->payload_len - iter->consumed
+				>= iter->data_size)
+			break;
+		len = lib_ring_buffer_batch_peek(chan, buf);
+		CHAN_WARN_ON(chan, len < 0);
+		lttng_loser_tree_replace_winner(&tree,
+				len >= 0 ? iter->timestamp : LTTNG_LOSER_TREE_EMPTY);
+	}
+	lttng_loser_tree_free(&tree);
+
+	if (nr)
+		return nr;
+	if (nr_finalized == nr_bufs)
+		return -ENODATA;
+	return -EAGAIN;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_get_next_record_batch);
+
+/*
+ * Buffer holding the record with the lowest timestamp, or NULL if no buffer
+ * currently has a record.
+ */
+static
+struct lttng_kernel_ring_buffer *channel_iter_top_buf(const struct lttng_kernel_ring_buffer_config *config,
+						      struct lttng_kernel_ring_buffer_channel *chan)
+{
+	struct lttng_loser_tree *tree = &chan->iter.tree;
+	unsigned int cpu = lttng_loser_tree_winner(tree);
+
+	if (lttng_loser_tree_key(tree, cpu) == LTTNG_LOSER_TREE_EMPTY)
+		return NULL;
+	return channel_get_ring_buffer(config, chan, cpu);
 }
 
 static
 void lib_ring_buffer_get_empty_buf_records(const struct lttng_kernel_ring_buffer_config *config,
 					   struct lttng_kernel_ring_buffer_channel *chan)
 {
-	struct lttng_ptr_heap *heap = &chan->iter.heap;
+	struct lttng_loser_tree *tree = &chan->iter.tree;
 	struct lttng_kernel_ring_buffer *buf, *tmp;
+	bool inserted = false;
 	ssize_t len;
 
 	list_for_each_entry_safe(buf, tmp, &chan->iter.empty_head,
@@ -167,14 +312,19 @@ void lib_ring_buffer_get_empty_buf_records(const struct lttng_kernel_ring_buffer
 			break;
 		default:
 			/*
-			 * Insert buffer into the heap, remove from empty buffer
+			 * Insert buffer into the tree, remove from empty buffer
 			 * list.
 			 */
 			CHAN_WARN_ON(chan, len < 0);
 			list_del(&buf->iter.empty_node);
-			CHAN_WARN_ON(chan, lttng_heap_insert(heap, buf));
+			lttng_loser_tree_set_key(tree, buf->backend.cpu,
+						 buf->iter.timestamp);
+			inserted = true;
 		}
 	}
+	/* Replay all matches once for all inserted buffers. */
+	if (inserted)
+		lttng_loser_tree_rebuild(tree);
 }
 
 static
@@ -194,7 +344,7 @@ void lib_ring_buffer_wait_for_qs(const struct lttng_kernel_ring_buffer_config *c
 	/*
 	 * We need to consider previously empty buffers.
 	 * Do a get next buf record on each of them. Add them to
-	 * the heap if they have data. If at least one of them
+	 * the tree if they have data. If at least one of them
 	 * don't have data, we need to wait for
 	 * switch_timer_interval + MAX_SYSTEM_LATENCY (so we are sure the
 	 * buffers have been switched either by the timer or idle entry) and
@@ -244,7 +394,7 @@ ssize_t channel_get_next_record(struct lttng_kernel_ring_buffer_channel *chan,
 {
 	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
 	struct lttng_kernel_ring_buffer *buf;
-	struct lttng_ptr_heap *heap;
+	struct lttng_loser_tree *tree;
 	ssize_t len;
 
 	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
@@ -252,12 +402,12 @@ ssize_t channel_get_next_record(struct lttng_kernel_ring_buffer_channel *chan,
 		return lib_ring_buffer_get_next_record(chan, *ret_buf);
 	}
 
-	heap = &chan->iter.heap;
+	tree = &chan->iter.tree;
 
 	/*
 	 * get next record for topmost buffer.
 	 */
-	buf = lttng_heap_maximum(heap);
+	buf = channel_iter_top_buf(config, chan);
 	if (buf) {
 		len = lib_ring_buffer_get_next_record(chan, buf);
 		/*
@@ -268,43 +418,45 @@ ssize_t channel_get_next_record(struct lttng_kernel_ring_buffer_channel *chan,
 		case -EAGAIN:
 			buf->iter.timestamp = 0;
 			list_add(&buf->iter.empty_node, &chan->iter.empty_head);
-			/* Remove topmost buffer from the heap */
-			CHAN_WARN_ON(chan, lttng_heap_remove(heap) != buf);
+			/* Remove topmost buffer from the tree */
+			lttng_loser_tree_replace_winner(tree,
+					LTTNG_LOSER_TREE_EMPTY);
 			break;
 		case -ENODATA:
 			/*
-			 * Buffer is finalized. Remove buffer from heap and
+			 * Buffer is finalized. Remove buffer from tree and
 			 * don't add to list of empty buffer, because it has no
 			 * more data to provide, ever.
 			 */
-			CHAN_WARN_ON(chan, lttng_heap_remove(heap) != buf);
+			lttng_loser_tree_replace_winner(tree,
+					LTTNG_LOSER_TREE_EMPTY);
 			break;
 		case -EBUSY:
 			CHAN_WARN_ON(chan, 1);
 			break;
 		default:
 			/*
-			 * Reinsert buffer into the heap. Note that heap can be
-			 * partially empty, so we need to use
-			 * lttng_heap_replace_max().
+			 * Replay the matches of the topmost buffer with its
+			 * new record timestamp.
 			 */
 			CHAN_WARN_ON(chan, len < 0);
-			CHAN_WARN_ON(chan, lttng_heap_replace_max(heap, buf) != buf);
+			lttng_loser_tree_replace_winner(tree,
+					buf->iter.timestamp);
 			break;
 		}
 	}
 
-	buf = lttng_heap_maximum(heap);
+	buf = channel_iter_top_buf(config, chan);
 	if (!buf || buf->iter.timestamp > chan->iter.last_qs) {
 		/*
 		 * Deal with buffers previously showing no data.
-		 * Add buffers containing data to the heap, update
+		 * Add buffers containing data to the tree, update
 		 * last_qs.
 		 */
 		lib_ring_buffer_wait_for_qs(config, chan);
 	}
 
-	*ret_buf = buf = lttng_heap_maximum(heap);
+	*ret_buf = buf = channel_iter_top_buf(config, chan);
 	if (buf) {
 		/*
 		 * If this warning triggers, you probably need to check your
@@ -328,7 +480,7 @@ ssize_t channel_get_next_record(struct lttng_kernel_ring_buffer_channel *chan,
 		chan->iter.last_cpu = buf->backend.cpu;
 		return buf->iter.payload_len;
 	} else {
-		/* Heap is empty */
+		/* Tree is empty */
 		if (list_empty(&chan->iter.empty_head))
 			return -ENODATA;	/* All buffers finalized */
 		else
@@ -414,9 +566,8 @@ int channel_iterator_init(struct lttng_kernel_ring_buffer_channel *chan)
 		int ret;
 
 		INIT_LIST_HEAD(&chan->iter.empty_head);
-		ret = lttng_heap_init(&chan->iter.heap,
-				num_possible_cpus(),
-				GFP_KERNEL, buf_is_higher);
+		ret = lttng_loser_tree_init(&chan->iter.tree,
+				nr_cpu_ids, GFP_KERNEL);
 		if (ret)
 			return ret;
 
@@ -488,7 +639,7 @@ void channel_iterator_free(struct lttng_kernel_ring_buffer_channel *chan)
 	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
 
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		lttng_heap_free(&chan->iter.heap);
+		lttng_loser_tree_free(&chan->iter.tree);
 }
 
 int lib_ring_buffer_iterator_open(struct lttng_kernel_ring_buffer *buf)
@@ -572,18 +723,29 @@ void lib_ring_buffer_iterator_reset(struct lttng_kernel_ring_buffer *buf)
 {
 	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
 
+	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
+
 	if (buf->iter.state != ITER_GET_SUBBUF)
 		lib_ring_buffer_put_next_subbuf(buf);
 	buf->iter.state = ITER_GET_SUBBUF;
-	/* Remove from heap (if present). */
-	if (lttng_heap_cherrypick(&chan->iter.heap, buf))
+	/* Remove from tree (if present). */
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU
+	    && lttng_loser_tree_key(&chan->iter.tree, buf->backend.cpu)
+			!= LTTNG_LOSER_TREE_EMPTY) {
+		lttng_loser_tree_set_key(&chan->iter.tree, buf->backend.cpu,
+					 LTTNG_LOSER_TREE_EMPTY);
+		lttng_loser_tree_rebuild(&chan->iter.tree);
 		list_add(&buf->iter.empty_node, &chan->iter.empty_head);
+	}
 	buf->iter.timestamp = 0;
 	buf->iter.header_len = 0;
 	buf->iter.payload_len = 0;
 	buf->iter.consumed = 0;
 	buf->iter.read_offset = 0;
 	buf->iter.data_size = 0;
+	buf->iter.run_pos = 0;
+	buf->iter.run_len = 0;
+	buf->iter.batch_pending = 0;
 	/* Don't reset allocated and read_open */
 }
 
@@ -593,9 +755,19 @@ void channel_iterator_reset(struct lttng_kernel_ring_buffer_channel *chan)
 	struct lttng_kernel_ring_buffer *buf;
 	int cpu;
 
-	/* Empty heap, put into empty_head */
-	while ((buf = lttng_heap_remove(&chan->iter.heap)) != NULL)
-		list_add(&buf->iter.empty_node, &chan->iter.empty_head);
+	/* Empty tree, put into empty_head */
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+		for_each_channel_cpu(cpu, chan) {
+			if (lttng_loser_tree_key(&chan->iter.tree, cpu)
+					== LTTNG_LOSER_TREE_EMPTY)
+				continue;
+			lttng_loser_tree_set_key(&chan->iter.tree, cpu,
+						 LTTNG_LOSER_TREE_EMPTY);
+			buf = channel_get_ring_buffer(config, chan, cpu);
+			list_add(&buf->iter.empty_node, &chan->iter.empty_head);
+		}
+		lttng_loser_tree_rebuild(&chan->iter.tree);
+	}
 
 	for_each_channel_cpu(cpu, chan) {
 		buf = channel_get_ring_buffer(config, chan, cpu);
@@ -635,7 +807,7 @@ ssize_t channel_ring_buffer_file_read(struct file *filp,
 			read_offset = *ppos;
 			if (config->alloc == RING_BUFFER_ALLOC_PER_CPU
 			    && fusionmerge)
-				buf = lttng_heap_maximum(&chan->iter.heap);
+				buf = channel_iter_top_buf(config, chan);
 			CHAN_WARN_ON(chan, !buf);
 			goto skip_get_next;
 		}
@@ -102,13 +102,11 @@ static int lib_ring_buffer_mmap_buf(struct lttng_kernel_ring_buffer *buf,
 	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
 	unsigned long mmap_buf_len;
 
-	if (config->output != RING_BUFFER_MMAP)
+	if (config->output != RING_BUFFER_MMAP
+			&& config->output != RING_BUFFER_ITERATOR)
 		return -EINVAL;
 
-	mmap_buf_len = chan->backend.buf_size;
-	if (chan->backend.extra_reader_sb)
-		mmap_buf_len += chan->backend.subbuf_size;
-
+	mmap_buf_len = channel_backend_mmap_len(&chan->backend);
 	if (length != mmap_buf_len)
 		return -EINVAL;
 
@@ -29,6 +29,47 @@ static int compat_put_ulong(compat_ulong_t val, unsigned long arg)
 }
 #endif
 
+/*
+ * Frozen snapshot commands use 64-bit arguments, shared by the native and
+ * compat ioctl.
+ */
+static long lib_ring_buffer_frozen_ioctl(struct file *filp, unsigned int cmd,
+		uint64_t __user *uarg, struct lttng_kernel_ring_buffer *buf)
+{
+	switch (cmd) {
+	case LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_FREEZE:
+	{
+		unsigned long nr_frozen;
+		long ret;
+
+		ret = lib_ring_buffer_snapshot_freeze(buf, &nr_frozen);
+		if (ret)
+			return ret;
+		return put_user((uint64_t) nr_frozen, uarg);
+	}
+	case LTTNG_KERNEL_ABI_RING_BUFFER_GET_FROZEN_SUBBUF:
+	{
+		uint64_t index;
+		long ret;
+
+		if (get_user(index, uarg))
+			return -EFAULT;
+		if (index > ULONG_MAX)
+			return -EINVAL;
+		ret = lib_ring_buffer_get_frozen_subbuf(buf, index);
+		if (!ret) {
+			/* Set file position to zero at each successful "get" */
+			filp->f_pos = 0;
+		}
+		return ret;
+	}
+	case LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_THAW:
+		return lib_ring_buffer_snapshot_thaw(buf);
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
 /*
  * This is not used by anonymous file descriptors. This code is left
  * there if we ever want to implement an inode with open() operation.
@@ -237,11 +278,10 @@ long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
 	{
 		unsigned long mmap_buf_len;
 
-		if (config->output != RING_BUFFER_MMAP)
+		if (config->output != RING_BUFFER_MMAP
+				&& config->output != RING_BUFFER_ITERATOR)
 			return -EINVAL;
-		mmap_buf_len = chan->backend.buf_size;
-		if (chan->backend.extra_reader_sb)
-			mmap_buf_len += chan->backend.subbuf_size;
+		mmap_buf_len = channel_backend_mmap_len(&chan->backend);
 		if (mmap_buf_len > INT_MAX)
 			return -EFBIG;
 		return put_ulong(mmap_buf_len, arg);
@@ -266,6 +306,11 @@ long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
 	case LTTNG_KERNEL_ABI_RING_BUFFER_CLEAR:
 		lib_ring_buffer_clear(buf);
 		return 0;
+	case LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_FREEZE:
+	case LTTNG_KERNEL_ABI_RING_BUFFER_GET_FROZEN_SUBBUF:
+	case LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_THAW:
+		return lib_ring_buffer_frozen_ioctl(filp, cmd,
+				(uint64_t __user *) arg, buf);
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -389,11 +434,10 @@ long lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 	{
 		unsigned long mmap_buf_len;
 
-		if (config->output != RING_BUFFER_MMAP)
+		if (config->output != RING_BUFFER_MMAP
+				&& config->output != RING_BUFFER_ITERATOR)
 			return -EINVAL;
-		mmap_buf_len = chan->backend.buf_size;
-		if (chan->backend.extra_reader_sb)
-			mmap_buf_len += chan->backend.subbuf_size;
+		mmap_buf_len = channel_backend_mmap_len(&chan->backend);
 		if (mmap_buf_len > UINT_MAX)
 			return -EFBIG;
 		return compat_put_ulong(mmap_buf_len, arg);
@@ -420,6 +464,11 @@ long lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 	case LTTNG_KERNEL_ABI_RING_BUFFER_COMPAT_CLEAR:
 		lib_ring_buffer_clear(buf);
 		return 0;
+	case LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_FREEZE:
+	case LTTNG_KERNEL_ABI_RING_BUFFER_GET_FROZEN_SUBBUF:
+	case LTTNG_KERNEL_ABI_RING_BUFFER_SNAPSHOT_THAW:
+		return lib_ring_buffer_frozen_ioctl(filp, cmd,
+				(uint64_t __user *) compat_ptr(arg), buf);
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -30,6 +30,9 @@
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/compat.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
 #include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_mappings() */
 #include <ringbuffer/vfs.h>
 #include <ringbuffer/backend.h>
@@ -46,6 +49,7 @@
 #include <lttng/events-internal.h>
 #include <lttng/tracer.h>
 #include <lttng/tp-mempool.h>
+#include <lttng/compress.h>
 #include <ringbuffer/frontend_types.h>
 #include <ringbuffer/iterator.h>
 
@@ -64,6 +68,7 @@ static const struct file_operations lttng_proc_ops;
 
 static const struct file_operations lttng_session_fops;
 static const struct file_operations lttng_event_notifier_group_fops;
+static const struct file_operations lttng_event_notifier_group_notif_fops;
 static const struct file_operations lttng_channel_fops;
 static const struct file_operations lttng_metadata_fops;
 static const struct file_operations lttng_event_recorder_event_fops;
@@ -131,13 +136,20 @@ void event_notifier_send_notification_work_wakeup(struct irq_work *entry)
 }
 
 static
-int lttng_abi_create_event_notifier_group(void)
+int lttng_abi_create_event_notifier_group(const struct lttng_kernel_abi_event_notifier_group_conf *conf)
 {
 	struct lttng_event_notifier_group *event_notifier_group;
 	struct file *event_notifier_group_file;
 	int event_notifier_group_fd, ret;
 
-	event_notifier_group = lttng_event_notifier_group_create();
+	if (conf && (conf->flags & ~(LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING
+				| LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_PER_CPU)))
+		return -EINVAL;
+	/* Per-CPU buffers need no staging. */
+	if (conf && (conf->flags & LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING)
+			&& (conf->flags & LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_PER_CPU))
+		return -EINVAL;
+	event_notifier_group = lttng_event_notifier_group_create(conf);
 	if (!event_notifier_group)
 		return -ENOMEM;
 
@@ -156,6 +168,7 @@ int lttng_abi_create_event_notifier_group(void)
 
 	event_notifier_group->file = event_notifier_group_file;
 	init_waitqueue_head(&event_notifier_group->read_wait);
+	mutex_init(&event_notifier_group->batch_lock);
 	init_irq_work(&event_notifier_group->wakeup_pending,
 		      event_notifier_send_notification_work_wakeup);
 	fd_install(event_notifier_group_fd, event_notifier_group_file);
@@ -371,6 +384,9 @@ long lttng_abi_add_context(struct file *file,
  *		Returns the LTTng kernel tracer ABI version
  *	LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CREATE
  *		Returns a LTTng event notifier group file descriptor
+ *	LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CREATE_EXT
+ *		Returns a LTTng event notifier group file descriptor,
+ *		configured by struct lttng_kernel_abi_event_notifier_group_conf
  *
  * The returned session will be deleted when its file descriptor is closed.
  */
@@ -382,7 +398,17 @@ long lttng_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case LTTNG_KERNEL_ABI_SESSION:
 		return lttng_abi_create_session();
 	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CREATE:
-		return lttng_abi_create_event_notifier_group();
+		return lttng_abi_create_event_notifier_group(NULL);
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_CREATE_EXT:
+	{
+		struct lttng_kernel_abi_event_notifier_group_conf conf;
+
+		if (copy_from_user(&conf,
+				(struct lttng_kernel_abi_event_notifier_group_conf __user *) arg,
+				sizeof(conf)))
+			return -EFAULT;
+		return lttng_abi_create_event_notifier_group(&conf);
+	}
 	case LTTNG_KERNEL_ABI_OLD_TRACER_VERSION:
 	{
 		struct lttng_kernel_abi_tracer_version v;
@@ -497,6 +523,26 @@ int lttng_abi_create_channel(struct file *session_file,
 	int chan_fd;
 	int ret = 0;
 
+	if (chan_param->flags & ~(LTTNG_KERNEL_ABI_CHANNEL_FLAG_SNAPSHOT_STANDBY
+				| LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_LZ4
+				| LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_ZSTD
+				| LTTNG_KERNEL_ABI_CHANNEL_FLAG_PACKED_HEADER))
+		return -EINVAL;
+	if ((chan_param->flags & LTTNG_KERNEL_ABI_CHANNEL_FLAG_PACKED_HEADER)
+	    && channel_type != PER_CPU_CHANNEL)
+		return -EINVAL;
+	if ((chan_param->flags & LTTNG_KERNEL_ABI_CHANNEL_FLAG_SNAPSHOT_STANDBY)
+	    && (channel_type != PER_CPU_CHANNEL || !chan_param->overwrite))
+		return -EINVAL;
+	if (chan_param->flags & (LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_LZ4
+				| LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_ZSTD)) {
+		/* At most one compression format, data channels only. */
+		if ((chan_param->flags & LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_LZ4)
+		    && (chan_param->flags & LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_ZSTD))
+			return -EINVAL;
+		if (channel_type != PER_CPU_CHANNEL)
+			return -EINVAL;
+	}
 	chan_fd = lttng_get_unused_fd();
 	if (chan_fd < 0) {
 		ret = chan_fd;
@@ -555,9 +601,10 @@ int lttng_abi_create_channel(struct file *session_file,
 				  chan_param->num_subbuf,
 				  chan_param->switch_timer_interval,
 				  chan_param->read_timer_interval,
+				  chan_param->flags,
 				  channel_type);
-	if (!chan) {
-		ret = -EINVAL;
+	if (IS_ERR(chan)) {
+		ret = PTR_ERR(chan);
 		goto chan_error;
 	}
 	chan->priv->parent.file = chan_file;
@@ -626,6 +673,138 @@ int lttng_counter_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+/* Number of counter elements aggregated per copy to user space. */
+#define LTTNG_COUNTER_SNAPSHOT_CHUNK	512
+
+struct lttng_counter_snapshot_chunk {
+	int64_t values[LTTNG_COUNTER_SNAPSHOT_CHUNK];
+	uint64_t overflow[LTTNG_COUNTER_SNAPSHOT_CHUNK / 64];
+	uint64_t underflow[LTTNG_COUNTER_SNAPSHOT_CHUNK / 64];
+};
+
+static
+long lttng_counter_snapshot(struct lttng_counter *counter,
+		struct lttng_kernel_abi_counter_snapshot __user *usnapshot)
+{
+	size_t indexes[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX] = { 0 };
+	struct lttng_kernel_abi_counter_snapshot local_snapshot;
+	struct lttng_counter_snapshot_chunk *chunk;
+	int64_t __user *uvalues;
+	uint64_t __user *uoverflow, __user *uunderflow;
+	size_t index, nr_elem, i;
+	long ret;
+
+	if (copy_from_user(&local_snapshot, usnapshot, sizeof(local_snapshot)))
+		return -EFAULT;
+	if (validate_zeroed_padding(local_snapshot.padding,
+			sizeof(local_snapshot.padding)))
+		return -EINVAL;
+	if (local_snapshot.index.number_dimensions > LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX)
+		return -EINVAL;
+
+	/* Cast all indexes into size_t. */
+	for (i = 0; i < local_snapshot.index.number_dimensions; i++)
+		indexes[i] = (size_t) local_snapshot.index.dimension_indexes[i];
+
+	ret = lttng_kernel_counter_get_slice(counter,
+			local_snapshot.index.number_dimensions, indexes,
+			&index, &nr_elem);
+	if (ret)
+		return ret;
+	if (put_user((uint64_t) nr_elem, &usnapshot->nr_elem))
+		return -EFAULT;
+	if (nr_elem > local_snapshot.nr_elem)
+		return -ENOSPC;
+
+	uvalues = (int64_t __user *) (unsigned long) local_snapshot.values;
+	uoverflow = (uint64_t __user *) (unsigned long) local_snapshot.overflow;
+	uunderflow = (uint64_t __user *) (unsigned long) local_snapshot.underflow;
+	chunk = kmalloc(sizeof(*chunk), GFP_KERNEL);
+	if (!chunk)
+		return -ENOMEM;
+	for (i = 0; i < nr_elem; i += LTTNG_COUNTER_SNAPSHOT_CHUNK) {
+		size_t len = min_t(size_t, nr_elem - i, LTTNG_COUNTER_SNAPSHOT_CHUNK);
+		size_t bitmap_len = DIV_ROUND_UP(len, 64) * sizeof(uint64_t);
+
+		ret = lttng_kernel_counter_aggregate_range(counter, index + i, len,
+				chunk->values, chunk->overflow, chunk->underflow);
+		if (ret)
+			goto end;
+		if (copy_to_user(uvalues + i, chunk->values, len * sizeof(int64_t))
+				|| (uoverflow && copy_to_user(uoverflow + i / 64,
+						chunk->overflow, bitmap_len))
+				|| (uunderflow && copy_to_user(uunderflow + i / 64,
+						chunk->underflow, bitmap_len))) {
+			ret = -EFAULT;
+			goto end;
+		}
+		cond_resched();
+	}
+end:
+	kfree(chunk);
+	return ret;
+}
+
+/* Number of sparse counter entries read per copy to user space. */
+#define LTTNG_COUNTER_SPARSE_READ_CHUNK	128
+
+static
+long lttng_counter_sparse_read(struct lttng_counter *counter,
+		struct lttng_kernel_abi_counter_sparse_read __user *usparse_read)
+{
+	struct lttng_kernel_abi_counter_sparse_read local_sparse_read;
+	struct lttng_kernel_abi_counter_sparse_entry *chunk;
+	struct lttng_kernel_abi_counter_sparse_entry __user *uentries;
+	uint64_t pos, nr_read = 0;
+	long ret = 0;
+
+	if (!counter->sparse)
+		return -EINVAL;
+	if (copy_from_user(&local_sparse_read, usparse_read, sizeof(local_sparse_read)))
+		return -EFAULT;
+	if (validate_zeroed_padding(local_sparse_read.padding,
+			sizeof(local_sparse_read.padding)))
+		return -EINVAL;
+
+	uentries = (struct lttng_kernel_abi_counter_sparse_entry __user *)
+			(unsigned long) local_sparse_read.entries;
+	chunk = kcalloc(LTTNG_COUNTER_SPARSE_READ_CHUNK, sizeof(*chunk), GFP_KERNEL);
+	if (!chunk)
+		return -ENOMEM;
+	pos = local_sparse_read.pos;
+	while (nr_read < local_sparse_read.nr_entries) {
+		size_t len = min_t(uint64_t, local_sparse_read.nr_entries - nr_read,
+				LTTNG_COUNTER_SPARSE_READ_CHUNK), i;
+
+		for (i = 0; i < len; i++) {
+			struct lttng_kernel_abi_counter_sparse_entry *entry = &chunk[i];
+			int cpu;
+
+			memset(entry->key, 0, sizeof(entry->key));
+			if (lttng_kernel_counter_sparse_read_next(counter, &pos,
+					entry->key, &cpu, &entry->value))
+				break;
+			entry->cpu = cpu;
+		}
+		if (copy_to_user(uentries + nr_read, chunk, i * sizeof(*chunk))) {
+			ret = -EFAULT;
+			goto end;
+		}
+		nr_read += i;
+		if (i < len)
+			break;	/* End of iteration. */
+		cond_resched();
+	}
+	local_sparse_read.pos = pos;
+	local_sparse_read.nr_entries = nr_read;
+	local_sparse_read.overflow = lttng_kernel_counter_sparse_read_overflow(counter);
+	if (copy_to_user(usparse_read, &local_sparse_read, sizeof(local_sparse_read)))
+		ret = -EFAULT;
+end:
+	kfree(chunk);
+	return ret;
+}
+
 static
 long lttng_counter_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
@@ -708,6 +887,24 @@ long lttng_counter_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 
 		return 0;
 	}
+	case LTTNG_KERNEL_ABI_COUNTER_SNAPSHOT:
+		return lttng_counter_snapshot(counter,
+				(struct lttng_kernel_abi_counter_snapshot __user *) arg);
+	case LTTNG_KERNEL_ABI_COUNTER_SPARSE_READ:
+		return lttng_counter_sparse_read(counter,
+				(struct lttng_kernel_abi_counter_sparse_read __user *) arg);
+	case LTTNG_KERNEL_ABI_COUNTER_MMAP_INFO:
+	{
+		struct lttng_kernel_abi_counter_mmap_info local_mmap_info = {
+			.cpu_stride = lttng_kernel_counter_mmap_len(counter),
+			.nr_cpus = num_possible_cpus(),
+		};
+
+		if (copy_to_user((struct lttng_kernel_abi_counter_mmap_info __user *) arg,
+				&local_mmap_info, sizeof(local_mmap_info)))
+			return -EFAULT;
+		return 0;
+	}
 	case LTTNG_KERNEL_ABI_COUNTER_CLEAR:
 	{
 		struct lttng_kernel_abi_counter_clear local_counter_clear;
@@ -734,9 +931,87 @@ long lttng_counter_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	}
 }
 
+/*
+ * fault() vm_op implementation for counter mappings. The mapping contains
+ * the counter array of each possible cpu, in cpu number order.
+ */
+#if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(5,1,0) || \
+	LTTNG_RHEL_KERNEL_RANGE(4,18,0,193,0,0, 4,19,0,0,0,0))
+static vm_fault_t lttng_counter_fault_compat(struct vm_area_struct *vma, struct vm_fault *vmf)
+#else
+static int lttng_counter_fault_compat(struct vm_area_struct *vma, struct vm_fault *vmf)
+#endif
+{
+	struct lttng_counter *counter = vma->vm_private_data;
+	unsigned long offset = vmf->pgoff << PAGE_SHIFT;
+	size_t cpu_stride = lttng_kernel_counter_mmap_len(counter);
+	int cpu = offset / cpu_stride;
+	struct page *page;
+
+	/* The global array, holding offline cpus counts, follows the per-cpu arrays. */
+	if (cpu == num_possible_cpus())
+		cpu = -1;
+	page = lttng_kernel_counter_get_page(counter, cpu, offset % cpu_stride);
+	if (!page)
+		return VM_FAULT_SIGBUS;
+	get_page(page);
+	vmf->page = page;
+
+	return 0;
+}
+
+#if (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(5,1,0) || \
+	LTTNG_RHEL_KERNEL_RANGE(4,18,0,193,0,0, 4,19,0,0,0,0))
+static vm_fault_t lttng_counter_fault(struct vm_fault *vmf)
+{
+	return lttng_counter_fault_compat(vmf->vma, vmf);
+}
+#elif (LTTNG_LINUX_VERSION_CODE >= LTTNG_KERNEL_VERSION(4,11,0))
+static int lttng_counter_fault(struct vm_fault *vmf)
+{
+	return lttng_counter_fault_compat(vmf->vma, vmf);
+}
+#else
+static int lttng_counter_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+	return lttng_counter_fault_compat(vma, vmf);
+}
+#endif
+
+static const struct vm_operations_struct lttng_counter_mmap_ops = {
+	.fault = lttng_counter_fault,
+};
+
+/*
+ * Map the per-cpu and global counter arrays read-only, so they can be
+ * summed from user space without system calls.
+ */
+static
+int lttng_counter_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct lttng_counter *counter = file->private_data;
+	unsigned long length = vma->vm_end - vma->vm_start;
+
+	if (!lttng_kernel_counter_mmap_len(counter))
+		return -EINVAL;
+	if (vma->vm_pgoff != 0
+			|| length != lttng_kernel_counter_mmap_len(counter) * (num_possible_cpus() + 1))
+		return -EINVAL;
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_ops = &lttng_counter_mmap_ops;
+	vma->vm_flags |= VM_DONTEXPAND;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_private_data = counter;
+
+	return 0;
+}
+
 static const struct file_operations lttng_counter_fops = {
 	.owner = THIS_MODULE,
 	.release = lttng_counter_release,
+	.mmap = lttng_counter_mmap,
 	.unlocked_ioctl = lttng_counter_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = lttng_counter_ioctl,
@@ -765,6 +1040,35 @@ enum tracker_type get_tracker_type(struct lttng_kernel_abi_tracker_args *tracker
 	}
 }
 
+static
+int lttng_abi_session_counter_snapshot(struct lttng_kernel_session *session,
+		const struct lttng_kernel_abi_session_counter_snapshot *snapshot_param)
+{
+	struct file *counter_file;
+	int ret;
+
+	if (validate_zeroed_padding((char *) snapshot_param->padding,
+			sizeof(snapshot_param->padding)))
+		return -EINVAL;
+	counter_file = fget(snapshot_param->counter_fd);
+	if (!counter_file)
+		return -EBADF;
+	if (counter_file->f_op != &lttng_counter_fops) {
+		ret = -EINVAL;
+		goto error;
+	}
+	/* The counter file reference is owned by the snapshot timer. */
+	ret = lttng_session_counter_snapshot_add(session, counter_file,
+			snapshot_param->id, snapshot_param->period);
+	if (ret)
+		goto error;
+	return 0;
+
+error:
+	fput(counter_file);
+	return ret;
+}
+
 /**
  *	lttng_session_ioctl - lttng session fd ioctl
  *
@@ -789,6 +1093,11 @@ enum tracker_type get_tracker_type(struct lttng_kernel_abi_tracker_args *tracker
  *		Add ID to tracker
  *	LTTNG_KERNEL_ABI_SESSION_UNTRACK_ID
  *		Remove ID from tracker
+ *	LTTNG_KERNEL_ABI_SESSION_SET_METADATA_FORMAT
+ *		Select the metadata format (CTF 1.8 or CTF 2) before the
+ *		session is first started
+ *	LTTNG_KERNEL_ABI_SESSION_COUNTER_SNAPSHOT
+ *		Periodically record the changes of a counter in the session
  *
  * The returned channel will be deleted when its file descriptor is closed.
  */
@@ -837,6 +1146,7 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				(struct lttng_kernel_abi_old_channel __user *) arg,
 				sizeof(struct lttng_kernel_abi_old_channel)))
 			return -EFAULT;
+		memset(&chan_param, 0, sizeof(chan_param));
 		chan_param.overwrite = old_chan_param.overwrite;
 		chan_param.subbuf_size = old_chan_param.subbuf_size;
 		chan_param.num_subbuf = old_chan_param.num_subbuf;
@@ -872,6 +1182,7 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				(struct lttng_kernel_abi_old_channel __user *) arg,
 				sizeof(struct lttng_kernel_abi_old_channel)))
 			return -EFAULT;
+		memset(&chan_param, 0, sizeof(chan_param));
 		chan_param.overwrite = old_chan_param.overwrite;
 		chan_param.subbuf_size = old_chan_param.subbuf_size;
 		chan_param.num_subbuf = old_chan_param.num_subbuf;
@@ -944,6 +1255,16 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		return lttng_session_metadata_regenerate(session);
 	case LTTNG_KERNEL_ABI_SESSION_STATEDUMP:
 		return lttng_session_statedump(session);
+	case LTTNG_KERNEL_ABI_SESSION_COUNTER_SNAPSHOT:
+	{
+		struct lttng_kernel_abi_session_counter_snapshot snapshot_param;
+
+		if (copy_from_user(&snapshot_param,
+				(struct lttng_kernel_abi_session_counter_snapshot __user *) arg,
+				sizeof(struct lttng_kernel_abi_session_counter_snapshot)))
+			return -EFAULT;
+		return lttng_abi_session_counter_snapshot(session, &snapshot_param);
+	}
 	case LTTNG_KERNEL_ABI_SESSION_SET_NAME:
 	{
 		struct lttng_kernel_abi_session_name name;
@@ -964,6 +1285,16 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			return -EFAULT;
 		return lttng_abi_session_set_creation_time(session, &time);
 	}
+	case LTTNG_KERNEL_ABI_SESSION_SET_METADATA_FORMAT:
+	{
+		struct lttng_kernel_abi_session_metadata_format format;
+
+		if (copy_from_user(&format,
+				(struct lttng_kernel_abi_session_metadata_format __user *) arg,
+				sizeof(struct lttng_kernel_abi_session_metadata_format)))
+			return -EFAULT;
+		return lttng_session_set_metadata_format(session, format.format);
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -1004,9 +1335,9 @@ static
 ssize_t lttng_event_notifier_group_notif_read(struct file *filp, char __user *user_buf,
 		size_t count, loff_t *ppos)
 {
-	struct lttng_event_notifier_group *event_notifier_group = filp->private_data;
-	struct lttng_kernel_ring_buffer_channel *chan = event_notifier_group->chan;
-	struct lttng_kernel_ring_buffer *buf = event_notifier_group->buf;
+	struct lttng_kernel_ring_buffer *buf = filp->private_data;
+	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
+	struct lttng_event_notifier_group *event_notifier_group = channel_get_private(chan);
 	ssize_t read_count = 0, len;
 	size_t read_offset;
 
@@ -1017,7 +1348,7 @@ ssize_t lttng_event_notifier_group_notif_read(struct file *filp, char __user *us
 	/* Finish copy of previous record */
 	if (*ppos != 0) {
 		if (count != 0) {
-			len = chan->iter.len_left;
+			len = buf->iter.len_left;
 			read_offset = *ppos;
 			goto skip_get_next;
 		}
@@ -1071,11 +1402,11 @@ skip_get_next:
 		space_left = count - read_count;
 		if (len <= space_left) {
 			copy_len = len;
-			chan->iter.len_left = 0;
+			buf->iter.len_left = 0;
 			*ppos = 0;
 		} else {
 			copy_len = space_left;
-			chan->iter.len_left = len - copy_len;
+			buf->iter.len_left = len - copy_len;
 			*ppos = read_offset + copy_len;
 		}
 		if (__lib_ring_buffer_copy_to_user(&buf->backend, read_offset,
@@ -1093,7 +1424,7 @@ skip_get_next:
 
 nodata:
 	*ppos = 0;
-	chan->iter.len_left = 0;
+	buf->iter.len_left = 0;
 
 put_record:
 	if (*ppos == 0)
@@ -1111,16 +1442,21 @@ unsigned int lttng_event_notifier_group_notif_poll(struct file *filp,
 		poll_table *wait)
 {
 	unsigned int mask = 0;
-	struct lttng_event_notifier_group *event_notifier_group = filp->private_data;
-	struct lttng_kernel_ring_buffer_channel *chan = event_notifier_group->chan;
-	struct lttng_kernel_ring_buffer *buf = event_notifier_group->buf;
+	struct lttng_kernel_ring_buffer *buf = filp->private_data;
+	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
+	struct lttng_event_notifier_group *event_notifier_group = channel_get_private(chan);
 	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
 	int finalized, disabled;
 	unsigned long consumed, offset;
 	size_t subbuffer_header_size = config->cb.subbuffer_header_size();
 
 	if (filp->f_mode & FMODE_READ) {
-		poll_wait_set_exclusive(wait);
+		/*
+		 * The group wait queue is shared by the file descriptors of
+		 * per-CPU buffers: wake up all of them.
+		 */
+		if (config->alloc == RING_BUFFER_ALLOC_GLOBAL)
+			poll_wait_set_exclusive(wait);
 		poll_wait(filp, &event_notifier_group->read_wait, wait);
 
 		finalized = lib_ring_buffer_is_finalized(config, buf);
@@ -1185,10 +1521,9 @@ retry:
  */
 static int lttng_event_notifier_group_notif_open(struct inode *inode, struct file *file)
 {
-	struct lttng_event_notifier_group *event_notifier_group = inode->i_private;
-	struct lttng_kernel_ring_buffer *buf = event_notifier_group->buf;
+	struct lttng_kernel_ring_buffer *buf = inode->i_private;
 
-	file->private_data = event_notifier_group;
+	file->private_data = buf;
 	return lib_ring_buffer_open(inode, file, buf);
 }
 
@@ -1201,8 +1536,9 @@ static int lttng_event_notifier_group_notif_open(struct inode *inode, struct fil
  */
 static int lttng_event_notifier_group_notif_release(struct inode *inode, struct file *file)
 {
-	struct lttng_event_notifier_group *event_notifier_group = file->private_data;
-	struct lttng_kernel_ring_buffer *buf = event_notifier_group->buf;
+	struct lttng_kernel_ring_buffer *buf = file->private_data;
+	struct lttng_event_notifier_group *event_notifier_group =
+		channel_get_private(buf->backend.chan);
 	int ret;
 
 	ret = lib_ring_buffer_release(inode, file, buf);
@@ -1212,12 +1548,154 @@ static int lttng_event_notifier_group_notif_release(struct inode *inode, struct
 	return 0;
 }
 
+/*
+ * Describe the next records of the notification stream of @filp and of the
+ * streams listed in the batch, merged in timestamp order. The scratch
+ * buffers are allocated for each call, and batches of a group are
+ * serialized, so readers sharing streams don't need to coordinate.
+ */
+static
+long lttng_event_notifier_group_notif_get_next_records(struct file *filp,
+		struct lttng_kernel_abi_ring_buffer_record_batch __user *ubatch)
+{
+	struct lttng_kernel_ring_buffer *buf = filp->private_data;
+	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
+	struct lttng_event_notifier_group *event_notifier_group = channel_get_private(chan);
+	struct lttng_kernel_abi_ring_buffer_record_batch batch;
+	struct lttng_kernel_abi_ring_buffer_record_desc *descs;
+	struct lttng_kernel_ring_buffer **bufs;
+	struct file **files;
+	int32_t __user *ufds;
+	unsigned int i, j, nr_files = 0;
+	ssize_t nr;
+	long ret;
+
+	if (copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+	if (!batch.count || batch.count > LTTNG_KERNEL_ABI_RING_BUFFER_MAX_RECORDS)
+		return -EINVAL;
+	if (batch.nr_stream_fds >= nr_cpu_ids)
+		return -EINVAL;
+	descs = kmalloc_array(batch.count, sizeof(*descs), GFP_KERNEL);
+	bufs = kmalloc_array(batch.nr_stream_fds + 1, sizeof(*bufs), GFP_KERNEL);
+	files = kmalloc_array(batch.nr_stream_fds, sizeof(*files), GFP_KERNEL);
+	if (!descs || !bufs || !files) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	bufs[0] = buf;
+	ufds = (int32_t __user *) (unsigned long) batch.stream_fds;
+	for (i = 0; i < batch.nr_stream_fds; i++) {
+		struct file *stream_file;
+		int32_t fd;
+
+		if (get_user(fd, &ufds[i])) {
+			ret = -EFAULT;
+			goto end;
+		}
+		stream_file = fget(fd);
+		if (!stream_file) {
+			ret = -EBADF;
+			goto end;
+		}
+		files[nr_files++] = stream_file;
+		if (stream_file->f_op != &lttng_event_notifier_group_notif_fops) {
+			ret = -EINVAL;
+			goto end;
+		}
+		bufs[i + 1] = stream_file->private_data;
+		if (bufs[i + 1]->backend.chan != chan) {
+			ret = -EINVAL;
+			goto end;
+		}
+		for (j = 0; j <= i; j++) {
+			if (bufs[j] == bufs[i + 1]) {
+				ret = -EINVAL;
+				goto end;
+			}
+		}
+	}
+
+	mutex_lock(&event_notifier_group->batch_lock);
+	nr = lib_ring_buffer_get_next_record_batch(chan, bufs,
+			batch.nr_stream_fds + 1, descs, batch.count);
+	mutex_unlock(&event_notifier_group->batch_lock);
+	if (nr < 0) {
+		ret = nr;
+		goto end;
+	}
+	if (copy_to_user((void __user *) (unsigned long) batch.descs, descs,
+			nr * sizeof(*descs))
+			|| put_user((uint32_t) nr, &ubatch->count)) {
+		ret = -EFAULT;
+		goto end;
+	}
+	ret = 0;
+end:
+	while (nr_files)
+		fput(files[--nr_files]);
+	kfree(files);
+	kfree(bufs);
+	kfree(descs);
+	return ret;
+}
+
+static
+long lttng_event_notifier_group_notif_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg)
+{
+	struct lttng_kernel_ring_buffer *buf = filp->private_data;
+
+	switch (cmd) {
+	case LTTNG_KERNEL_ABI_RING_BUFFER_GET_MMAP_LEN:
+		return lib_ring_buffer_ioctl(filp, cmd, arg, buf);
+	case LTTNG_KERNEL_ABI_RING_BUFFER_GET_NEXT_RECORDS:
+		return lttng_event_notifier_group_notif_get_next_records(filp,
+			(struct lttng_kernel_abi_ring_buffer_record_batch __user *) arg);
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
+#ifdef CONFIG_COMPAT
+static
+long lttng_event_notifier_group_notif_compat_ioctl(struct file *filp,
+		unsigned int cmd, unsigned long arg)
+{
+	struct lttng_kernel_ring_buffer *buf = filp->private_data;
+
+	switch (cmd) {
+	case LTTNG_KERNEL_ABI_RING_BUFFER_COMPAT_GET_MMAP_LEN:
+		return lib_ring_buffer_compat_ioctl(filp, cmd, arg, buf);
+	case LTTNG_KERNEL_ABI_RING_BUFFER_GET_NEXT_RECORDS:
+		return lttng_event_notifier_group_notif_get_next_records(filp,
+			(struct lttng_kernel_abi_ring_buffer_record_batch __user *) compat_ptr(arg));
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+#endif /* CONFIG_COMPAT */
+
+static
+int lttng_event_notifier_group_notif_mmap(struct file *filp,
+		struct vm_area_struct *vma)
+{
+	struct lttng_kernel_ring_buffer *buf = filp->private_data;
+
+	return lib_ring_buffer_mmap(filp, vma, buf);
+}
+
 static const struct file_operations lttng_event_notifier_group_notif_fops = {
 	.owner = THIS_MODULE,
 	.open = lttng_event_notifier_group_notif_open,
 	.release = lttng_event_notifier_group_notif_release,
 	.read = lttng_event_notifier_group_notif_read,
 	.poll = lttng_event_notifier_group_notif_poll,
+	.mmap = lttng_event_notifier_group_notif_mmap,
+	.unlocked_ioctl = lttng_event_notifier_group_notif_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl = lttng_event_notifier_group_notif_compat_ioctl,
+#endif
 };
 
 /**
@@ -1233,6 +1711,7 @@ unsigned int lttng_metadata_ring_buffer_poll(struct file *filp,
 {
 	struct lttng_metadata_stream *stream = filp->private_data;
 	struct lttng_kernel_ring_buffer *buf = stream->priv;
+	struct lttng_metadata_log *log;
 	int finalized;
 	unsigned int mask = 0;
 
@@ -1251,11 +1730,13 @@ unsigned int lttng_metadata_ring_buffer_poll(struct file *filp,
 		if (finalized)
 			mask |= POLLHUP;
 
-		mutex_lock(&stream->metadata_cache->lock);
-		if (stream->metadata_cache->metadata_written >
-				stream->metadata_out)
+		rcu_read_lock();
+		log = rcu_dereference(stream->metadata_cache->log);
+		/* A new metadata version is always readable from its start. */
+		if (log->version != READ_ONCE(stream->version)
+				|| READ_ONCE(log->coherent) > READ_ONCE(stream->metadata_out))
 			mask |= POLLIN;
-		mutex_unlock(&stream->metadata_cache->lock);
+		rcu_read_unlock();
 	}
 
 	return mask;
@@ -1285,20 +1766,25 @@ static
 int lttng_metadata_cache_dump(struct lttng_metadata_stream *stream)
 {
 	int ret;
-	struct lttng_metadata_cache *cache = stream->metadata_cache;
+	struct lttng_metadata_log *log;
 
-	mutex_lock(&cache->lock);
-	if (stream->metadata_out != cache->metadata_written) {
+	mutex_lock(&stream->lock);
+	rcu_read_lock();
+	log = rcu_dereference(stream->metadata_cache->log);
+	if (log->version != stream->version
+			|| stream->metadata_out != smp_load_acquire(&log->coherent)) {
 		ret = -EBUSY;
 		goto end;
 	}
 	stream->metadata_out = 0;
 	stream->metadata_in = 0;
+	stream->chunk_in = NULL;
 	wake_up_interruptible(&stream->read_wait);
 	ret = 0;
 
 end:
-	mutex_unlock(&cache->lock);
+	rcu_read_unlock();
+	mutex_unlock(&stream->lock);
 	return ret;
 }
 
@@ -1680,6 +2166,7 @@ int lttng_abi_open_metadata_stream(struct file *channel_file)
 		goto nomem;
 	}
 	metadata_stream->metadata_cache = session->priv->metadata_cache;
+	mutex_init(&metadata_stream->lock);
 	init_waitqueue_head(&metadata_stream->read_wait);
 	metadata_stream->priv = buf;
 	stream_priv = metadata_stream;
@@ -1743,8 +2230,7 @@ int lttng_abi_open_event_notifier_group_stream(struct file *notif_file)
 		ret = -EOVERFLOW;
 		goto refcount_error;
 	}
-	event_notifier_group->buf = buf;
-	stream_priv = event_notifier_group;
+	stream_priv = buf;
 	ret = lttng_abi_create_stream_fd(notif_file, stream_priv,
 			&lttng_event_notifier_group_notif_fops,
 			"[lttng_event_notifier_stream]");
@@ -2005,6 +2491,20 @@ long lttng_event_notifier_enabler_ioctl(struct file *file, unsigned int cmd, uns
 			(struct lttng_kernel_abi_capture_bytecode __user *) arg);
 	case LTTNG_KERNEL_ABI_ADD_CALLSITE:
 		return -EINVAL;
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_RATE_POLICY:
+	{
+		struct lttng_kernel_abi_event_notifier_rate_policy rate_param;
+
+		if (copy_from_user(&rate_param,
+				(struct lttng_kernel_abi_event_notifier_rate_policy __user *) arg,
+				sizeof(struct lttng_kernel_abi_event_notifier_rate_policy)))
+			return -EFAULT;
+		if (validate_zeroed_padding(rate_param.padding,
+				sizeof(rate_param.padding)))
+			return -EINVAL;
+		return lttng_event_notifier_enabler_set_rate_policy(
+			event_notifier_enabler, &rate_param);
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -2048,6 +2548,50 @@ static const struct file_operations lttng_event_notifier_enabler_fops = {
 #endif
 };
 
+/*
+ * Resolve the aggregation map targeted by a counter increment action. The
+ * map must have been created on the same event notifier group, and stays
+ * valid until the group is destroyed.
+ */
+static
+struct lttng_counter *lttng_abi_event_notifier_group_get_map(
+		struct lttng_event_notifier_group *event_notifier_group,
+		const struct lttng_kernel_abi_event_notifier *event_notifier_param)
+{
+	struct lttng_counter *counter;
+	struct file *counter_file;
+	unsigned int i;
+
+	counter_file = fget(event_notifier_param->counter_fd);
+	if (!counter_file)
+		return ERR_PTR(-EBADF);
+	if (counter_file->f_op != &lttng_counter_fops) {
+		counter = ERR_PTR(-EINVAL);
+		goto end;
+	}
+	counter = counter_file->private_data;
+	if (counter->owner != event_notifier_group->file
+			|| counter == event_notifier_group->error_counter) {
+		counter = ERR_PTR(-EINVAL);
+		goto end;
+	}
+	for (i = 0; i < LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX; i++) {
+		switch (event_notifier_param->key_mode[i]) {
+		case LTTNG_KERNEL_ABI_COUNTER_KEY_DIRECT:
+		case LTTNG_KERNEL_ABI_COUNTER_KEY_HASH:
+		case LTTNG_KERNEL_ABI_COUNTER_KEY_LOG2:
+		case LTTNG_KERNEL_ABI_COUNTER_KEY_LOG_LINEAR:
+			break;
+		default:
+			counter = ERR_PTR(-EINVAL);
+			goto end;
+		}
+	}
+end:
+	fput(counter_file);
+	return counter;
+}
+
 static
 int lttng_abi_create_event_notifier(struct file *event_notifier_group_file,
 		struct lttng_kernel_abi_event_notifier *event_notifier_param)
@@ -2055,6 +2599,7 @@ int lttng_abi_create_event_notifier(struct file *event_notifier_group_file,
 	struct lttng_event_notifier_group *event_notifier_group =
 			event_notifier_group_file->private_data;
 	const struct file_operations *fops;
+	struct lttng_counter *counter = NULL;
 	int event_notifier_fd, ret;
 	struct file *event_notifier_file;
 	void *priv;
@@ -2102,6 +2647,37 @@ int lttng_abi_create_event_notifier(struct file *event_notifier_group_file,
 
 	event_notifier_param->event.name[LTTNG_KERNEL_ABI_SYM_NAME_LEN - 1] = '\0';
 
+	switch (event_notifier_param->action) {
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_NOTIFY:
+		break;
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_COUNTER_INCREMENT:
+		counter = lttng_abi_event_notifier_group_get_map(event_notifier_group,
+				event_notifier_param);
+		if (IS_ERR(counter)) {
+			ret = PTR_ERR(counter);
+			goto inval_instr;
+		}
+		break;
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_START:
+		lttng_fallthrough;
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_STOP:
+		counter = lttng_abi_event_notifier_group_get_map(event_notifier_group,
+				event_notifier_param);
+		if (IS_ERR(counter)) {
+			ret = PTR_ERR(counter);
+			goto inval_instr;
+		}
+		lttng_lock_sessions();
+		ret = lttng_kernel_counter_alloc_start_timestamps(counter);
+		lttng_unlock_sessions();
+		if (ret)
+			goto inval_instr;
+		break;
+	default:
+		ret = -EINVAL;
+		goto inval_instr;
+	}
+
 	event_notifier_fd = lttng_get_unused_fd();
 	if (event_notifier_fd < 0) {
 		ret = event_notifier_fd;
@@ -2140,12 +2716,12 @@ int lttng_abi_create_event_notifier(struct file *event_notifier_group_file,
 			enabler = lttng_event_notifier_enabler_create(
 					LTTNG_ENABLER_FORMAT_STAR_GLOB,
 					event_notifier_param,
-					event_notifier_group);
+					event_notifier_group, counter);
 		} else {
 			enabler = lttng_event_notifier_enabler_create(
 					LTTNG_ENABLER_FORMAT_NAME,
 					event_notifier_param,
-					event_notifier_group);
+					event_notifier_group, counter);
 		}
 		if (enabler)
 			lttng_event_notifier_enabler_group_add(event_notifier_group, enabler);
@@ -2163,7 +2739,7 @@ int lttng_abi_create_event_notifier(struct file *event_notifier_group_file,
 		struct lttng_event_notifier_enabler *event_notifier_enabler;
 
 		event_notifier_enabler = lttng_event_notifier_enabler_create(LTTNG_ENABLER_FORMAT_NAME,
-				event_notifier_param, event_notifier_group);
+				event_notifier_param, event_notifier_group, counter);
 		if (!event_notifier_enabler) {
 			ret = -ENOMEM;
 			goto event_notifier_error;
@@ -2225,6 +2801,11 @@ long lttng_abi_event_notifier_group_create_error_counter(
 		return -EINVAL;
 	}
 
+	if (error_counter_conf->sparse_nr_entries) {
+		printk(KERN_ERR "LTTng: event_notifier: Error counter cannot be sparse.\n");
+		return -EINVAL;
+	}
+
 	switch (error_counter_conf->bitness) {
 	case LTTNG_KERNEL_ABI_COUNTER_BITNESS_64:
 		counter_transport_name = "counter-per-cpu-64-modular";
@@ -2271,7 +2852,7 @@ long lttng_abi_event_notifier_group_create_error_counter(
 	}
 
 	counter = lttng_kernel_counter_create(counter_transport_name,
-			1, &counter_len);
+			1, &counter_len, 0);
 	if (!counter) {
 		ret = -EINVAL;
 		goto counter_error;
@@ -2307,6 +2888,154 @@ fd_error:
 	return ret;
 }
 
+/*
+ * Select the counter transport matching @conf. Counters without global
+ * sum step are per-cpu only. With a global sum step, narrow per-cpu
+ * counters spill into 64-bit global counters.
+ */
+static
+const char *lttng_abi_counter_transport_name(const struct lttng_kernel_abi_counter_conf *conf)
+{
+	bool saturate;
+
+	switch (conf->arithmetic) {
+	case LTTNG_KERNEL_ABI_COUNTER_ARITHMETIC_MODULAR:
+		saturate = false;
+		break;
+	case LTTNG_KERNEL_ABI_COUNTER_ARITHMETIC_SATURATE:
+		saturate = true;
+		break;
+	default:
+		return NULL;
+	}
+
+	if (conf->global_sum_step < 0)
+		return NULL;
+	if (!conf->global_sum_step) {
+		switch (conf->bitness) {
+		case LTTNG_KERNEL_ABI_COUNTER_BITNESS_64:
+			return saturate ? "counter-per-cpu-64-saturate" : "counter-per-cpu-64-modular";
+		case LTTNG_KERNEL_ABI_COUNTER_BITNESS_32:
+			return saturate ? "counter-per-cpu-32-saturate" : "counter-per-cpu-32-modular";
+		default:
+			return NULL;
+		}
+	}
+	switch (conf->bitness) {
+	case LTTNG_KERNEL_ABI_COUNTER_BITNESS_32:
+		return saturate ? "counter-per-cpu-32-global-64-saturate" :
+			"counter-per-cpu-32-global-64-modular";
+	case LTTNG_KERNEL_ABI_COUNTER_BITNESS_16:
+		return saturate ? "counter-per-cpu-16-global-64-saturate" :
+			"counter-per-cpu-16-global-64-modular";
+	default:
+		return NULL;
+	}
+}
+
+static
+long lttng_abi_event_notifier_group_create_map(
+		struct file *event_notifier_group_file,
+		const struct lttng_kernel_abi_counter_conf *map_conf)
+{
+	size_t dimension_sizes[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+	int counter_fd, ret;
+	const char *counter_transport_name = NULL;
+	struct lttng_counter *counter = NULL;
+	struct file *counter_file;
+	struct lttng_event_notifier_group *event_notifier_group =
+			(struct lttng_event_notifier_group *) event_notifier_group_file->private_data;
+	unsigned int i;
+
+	if (!map_conf->number_dimensions
+			|| map_conf->number_dimensions > LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX) {
+		printk(KERN_ERR "LTTng: event_notifier: Aggregation map has an invalid number of dimensions.\n");
+		return -EINVAL;
+	}
+
+	if (map_conf->sparse_nr_entries) {
+		if (map_conf->sparse_nr_entries > LTTNG_KERNEL_ABI_COUNTER_SPARSE_MAX_ENTRIES
+				|| !is_power_of_2(map_conf->sparse_nr_entries)
+				|| map_conf->arithmetic != LTTNG_KERNEL_ABI_COUNTER_ARITHMETIC_MODULAR
+				|| map_conf->bitness != LTTNG_KERNEL_ABI_COUNTER_BITNESS_64
+				|| map_conf->global_sum_step) {
+			printk(KERN_ERR "LTTng: event_notifier: Unsupported sparse aggregation map configuration.\n");
+			return -EINVAL;
+		}
+	} else {
+		for (i = 0; i < map_conf->number_dimensions; i++) {
+			if (!map_conf->dimensions[i].size)
+				return -EINVAL;
+			dimension_sizes[i] = map_conf->dimensions[i].size;
+		}
+
+		counter_transport_name = lttng_abi_counter_transport_name(map_conf);
+		if (!counter_transport_name) {
+			printk(KERN_ERR "LTTng: event_notifier: Unsupported aggregation map arithmetic, bitness or global sum step.\n");
+			return -EINVAL;
+		}
+	}
+
+	/*
+	 * Lock sessions to provide mutual exclusion against concurrent
+	 * modification of the event_notifier group map list.
+	 */
+	lttng_lock_sessions();
+
+	counter_fd = lttng_get_unused_fd();
+	if (counter_fd < 0) {
+		ret = counter_fd;
+		goto fd_error;
+	}
+
+	counter_file = anon_inode_getfile("[lttng_counter]",
+				       &lttng_counter_fops,
+				       NULL, O_RDONLY);
+	if (IS_ERR(counter_file)) {
+		ret = PTR_ERR(counter_file);
+		goto file_error;
+	}
+
+	if (!atomic_long_add_unless(&event_notifier_group_file->f_count, 1, LONG_MAX)) {
+		ret = -EOVERFLOW;
+		goto refcount_error;
+	}
+
+	if (map_conf->sparse_nr_entries)
+		counter = lttng_kernel_sparse_counter_create(map_conf->number_dimensions,
+				map_conf->sparse_nr_entries);
+	else
+		counter = lttng_kernel_counter_create(counter_transport_name,
+				map_conf->number_dimensions, dimension_sizes,
+				map_conf->global_sum_step);
+	if (!counter) {
+		ret = -EINVAL;
+		goto counter_error;
+	}
+
+	list_add(&counter->node, &event_notifier_group->maps_head);
+	counter->file = counter_file;
+	counter->owner = event_notifier_group->file;
+	counter_file->private_data = counter;
+	/* Ownership transferred. */
+	counter = NULL;
+
+	fd_install(counter_fd, counter_file);
+	lttng_unlock_sessions();
+
+	return counter_fd;
+
+counter_error:
+	atomic_long_dec(&event_notifier_group_file->f_count);
+refcount_error:
+	fput(counter_file);
+file_error:
+	put_unused_fd(counter_fd);
+fd_error:
+	lttng_unlock_sessions();
+	return ret;
+}
+
 static
 long lttng_event_notifier_group_ioctl(struct file *file, unsigned int cmd,
 		unsigned long arg)
@@ -2337,6 +3066,16 @@ long lttng_event_notifier_group_ioctl(struct file *file, unsigned int cmd,
 		return lttng_abi_event_notifier_group_create_error_counter(file,
 				&uerror_counter_conf);
 	}
+	case LTTNG_KERNEL_ABI_COUNTER_MAP:
+	{
+		struct lttng_kernel_abi_counter_conf umap_conf;
+
+		if (copy_from_user(&umap_conf,
+				(struct lttng_kernel_abi_counter_conf __user *) arg,
+				sizeof(umap_conf)))
+			return -EFAULT;
+		return lttng_abi_event_notifier_group_create_map(file, &umap_conf);
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -2382,6 +3121,9 @@ static const struct file_operations lttng_event_notifier_group_fops = {
  *		Enable recording for events in this channel (weak enable)
  *	LTTNG_KERNEL_ABI_DISABLE
  *		Disable recording for events in this channel (strong disable)
+ *	LTTNG_KERNEL_ABI_CHANNEL_HOT_EVENT
+ *		Rank an event among the most frequent of this channel, so it
+ *		is given a compact event header ID
  *
  * Channel and event file descriptors also hold a reference on the session.
  */
@@ -2541,6 +3283,17 @@ old_ctx_end:
 	case LTTNG_KERNEL_ABI_SYSCALL_MASK:
 		return lttng_syscall_table_get_active_mask(&channel->priv->parent.syscall_table,
 			(struct lttng_kernel_abi_syscall_mask __user *) arg);
+	case LTTNG_KERNEL_ABI_CHANNEL_HOT_EVENT:
+	{
+		struct lttng_kernel_abi_hot_event hot_event;
+
+		if (copy_from_user(&hot_event,
+				(struct lttng_kernel_abi_hot_event __user *) arg,
+				sizeof(hot_event)))
+			return -EFAULT;
+		hot_event.name[LTTNG_KERNEL_ABI_SYM_NAME_LEN - 1] = '\0';
+		return lttng_channel_add_hot_event(channel, hot_event.name);
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -2688,6 +3441,38 @@ long lttng_event_recorder_event_ioctl(struct file *file, unsigned int cmd, unsig
 	}
 }
 
+static
+int lttng_abi_event_rate_policy(struct lttng_event_recorder_enabler *event_enabler,
+		const struct lttng_kernel_abi_event_rate_policy *rate_param)
+{
+	struct file *counter_file = NULL;
+	int ret;
+
+	if (validate_zeroed_padding((char *) rate_param->padding,
+			sizeof(rate_param->padding)))
+		return -EINVAL;
+	if (rate_param->suppressed_counter_fd != -1) {
+		counter_file = fget(rate_param->suppressed_counter_fd);
+		if (!counter_file)
+			return -EBADF;
+		if (counter_file->f_op != &lttng_counter_fops) {
+			ret = -EINVAL;
+			goto error;
+		}
+	}
+	/* The counter file reference is owned by the enabler policy. */
+	ret = lttng_event_recorder_enabler_set_rate_policy(event_enabler,
+			rate_param, counter_file);
+	if (ret)
+		goto error;
+	return 0;
+
+error:
+	if (counter_file)
+		fput(counter_file);
+	return ret;
+}
+
 /**
  *	lttng_event_recorder_enabler_ioctl - lttng syscall through ioctl
  *
@@ -2702,6 +3487,8 @@ long lttng_event_recorder_event_ioctl(struct file *file, unsigned int cmd, unsig
  *		Enable recording for this event (weak enable)
  *	LTTNG_KERNEL_ABI_DISABLE
  *		Disable recording for this event (strong disable)
+ *	LTTNG_KERNEL_ABI_EVENT_RATE_POLICY
+ *		Sample and rate limit the recording of the enabler events
  */
 static
 long lttng_event_recorder_enabler_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
@@ -2730,6 +3517,16 @@ long lttng_event_recorder_enabler_ioctl(struct file *file, unsigned int cmd, uns
 			(struct lttng_kernel_abi_filter_bytecode __user *) arg);
 	case LTTNG_KERNEL_ABI_ADD_CALLSITE:
 		return -EINVAL;
+	case LTTNG_KERNEL_ABI_EVENT_RATE_POLICY:
+	{
+		struct lttng_kernel_abi_event_rate_policy rate_param;
+
+		if (copy_from_user(&rate_param,
+				(struct lttng_kernel_abi_event_rate_policy __user *) arg,
+				sizeof(struct lttng_kernel_abi_event_rate_policy)))
+			return -EFAULT;
+		return lttng_abi_event_rate_policy(event_enabler, &rate_param);
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -2877,6 +3674,9 @@ static long lttng_stream_ring_buffer_ioctl(struct file *filp,
 			goto error;
 		return put_u64(id, arg);
 	}
+	case LTTNG_KERNEL_ABI_RING_BUFFER_GET_COMPRESSED_SUBBUF:
+		return lttng_channel_compress_get_subbuf(channel_get_private(chan),
+				buf, (struct lttng_kernel_abi_compressed_subbuf __user *) arg);
 	default:
 		return lib_ring_buffer_file_operations.unlocked_ioctl(filp,
 				cmd, arg);
@@ -2981,6 +3781,9 @@ static long lttng_stream_ring_buffer_compat_ioctl(struct file *filp,
 			goto error;
 		return put_u64(id, arg);
 	}
+	case LTTNG_KERNEL_ABI_RING_BUFFER_COMPAT_GET_COMPRESSED_SUBBUF:
+		return lttng_channel_compress_get_subbuf(channel_get_private(chan),
+				buf, (struct lttng_kernel_abi_compressed_subbuf __user *) compat_ptr(arg));
 	default:
 		return lib_ring_buffer_file_operations.compat_ioctl(filp,
 				cmd, arg);
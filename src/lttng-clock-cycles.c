@@ -0,0 +1,187 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-clock-cycles.c
+ *
+ * LTTng raw cycle counter trace clock. Events are timestamped with the
+ * invariant cycle counter of the architecture (TSC on x86, CNTVCT_EL0 on
+ * arm64) and conversion to nanoseconds is left to the trace reader, using
+ * the clock frequency and offset found in the metadata, refined by
+ * periodic per-CPU clock correlation events.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/timex.h>
+#include <linux/smp.h>
+#include <linux/workqueue.h>
+
+#if defined(CONFIG_X86)
+#include <asm/cpufeature.h>
+#include <asm/tsc.h>
+#elif defined(CONFIG_ARM64)
+#include <asm/arch_timer.h>
+#endif
+
+#include <lttng/events.h>
+#include <lttng/tracer.h>
+#include <lttng/clock.h>
+#include <wrapper/random.h>
+#include <wrapper/tracepoint.h>
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events
+#define TRACE_INCLUDE_FILE lttng-clock
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-clock.h>
+
+LTTNG_DEFINE_TRACE(lttng_clock_correlation,
+	PARAMS(int cpu, u64 cycles, u64 monotonic, u64 realtime),
+	PARAMS(cpu, cycles, monotonic, realtime)
+);
+
+static unsigned int correlation_period_ms = 1000;
+module_param(correlation_period_ms, uint, 0444);
+MODULE_PARM_DESC(correlation_period_ms, "Period of the clock correlation events, in milliseconds (0: disabled)");
+
+static u64 cycles_freq;
+
+static void lttng_clock_correlation_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(correlation_work, lttng_clock_correlation_work);
+
+/*
+ * The cycle counter is read without serializing instruction: ordering
+ * against surrounding loads and stores is irrelevant for event
+ * timestamps, and the counter is invariant and synchronized across CPUs
+ * when this clock is available.
+ */
+static u64 trace_clock_read64_cycles(void)
+{
+	return (u64) get_cycles();
+}
+
+static u64 trace_clock_freq_cycles(void)
+{
+	return cycles_freq;
+}
+
+static int trace_clock_uuid_cycles(char *uuid)
+{
+	/* The cycle counter is reset at boot, like the monotonic clock. */
+	return wrapper_get_bootid(uuid);
+}
+
+static const char *trace_clock_name_cycles(void)
+{
+	return "cycles";
+}
+
+static const char *trace_clock_description_cycles(void)
+{
+	return "Invariant CPU cycle counter";
+}
+
+static
+struct lttng_trace_clock ltc = {
+	.read64 = trace_clock_read64_cycles,
+	.freq = trace_clock_freq_cycles,
+	.uuid = trace_clock_uuid_cycles,
+	.name = trace_clock_name_cycles,
+	.description = trace_clock_description_cycles,
+};
+
+/*
+ * Returns the frequency of the cycle counter, or 0 if it cannot be used
+ * as a trace clock on this system.
+ */
+static
+u64 lttng_clock_cycles_probe_freq(void)
+{
+#if defined(CONFIG_X86)
+	if (!boot_cpu_has(X86_FEATURE_TSC)
+			|| !boot_cpu_has(X86_FEATURE_CONSTANT_TSC)
+			|| !boot_cpu_has(X86_FEATURE_NONSTOP_TSC)
+			|| check_tsc_unstable())
+		return 0;
+	return (u64) tsc_khz * 1000;
+#elif defined(CONFIG_ARM64)
+	return arch_timer_get_cntfrq();
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Called from IPI on each online CPU. The cycle counter is sampled on
+ * each side of the kernel clock reads so the reader can use the midpoint
+ * and bound the correlation error.
+ */
+static
+void lttng_clock_correlation_sample(void *info)
+{
+	u64 cycles[2], monotonic, realtime;
+
+	cycles[0] = trace_clock_read64_cycles();
+	monotonic = ktime_to_ns(ktime_get());
+	realtime = ktime_to_ns(ktime_get_real());
+	cycles[1] = trace_clock_read64_cycles();
+	trace_lttng_clock_correlation(smp_processor_id(),
+		cycles[0] + ((cycles[1] - cycles[0]) >> 1),
+		monotonic, realtime);
+}
+
+static
+void lttng_clock_correlation_work(struct work_struct *work)
+{
+	on_each_cpu(lttng_clock_correlation_sample, NULL, 1);
+	schedule_delayed_work(&correlation_work,
+		msecs_to_jiffies(correlation_period_ms));
+}
+
+static
+int __init lttng_clock_cycles_init(void)
+{
+	int ret;
+
+	cycles_freq = lttng_clock_cycles_probe_freq();
+	if (!cycles_freq) {
+		printk(KERN_WARNING "LTTng: No invariant cycle counter available for the cycles trace clock\n");
+		return -ENODEV;
+	}
+	ret = __lttng_events_init__lttng_clock();
+	if (ret)
+		return ret;
+	ret = lttng_clock_register_plugin(&ltc, THIS_MODULE);
+	if (ret)
+		goto error_register;
+	if (correlation_period_ms)
+		schedule_delayed_work(&correlation_work,
+			msecs_to_jiffies(correlation_period_ms));
+	return 0;
+
+error_register:
+	__lttng_events_exit__lttng_clock();
+	return ret;
+}
+module_init(lttng_clock_cycles_init);
+
+static
+void __exit lttng_clock_cycles_exit(void)
+{
+	cancel_delayed_work_sync(&correlation_work);
+	lttng_clock_unregister_plugin(&ltc, THIS_MODULE);
+	__lttng_events_exit__lttng_clock();
+}
+module_exit(lttng_clock_cycles_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("EfficiOS Inc.");
+MODULE_DESCRIPTION("LTTng raw cycle counter trace clock");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,266 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-compress.c
+ *
+ * LTTng sub-buffer compression for the consumer read path.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/slab.h>
+#include <linux/crypto.h>
+#include <linux/uaccess.h>
+#include <linux/topology.h>
+
+#include <wrapper/vmalloc.h>
+#include <lttng/events.h>
+#include <lttng/events-internal.h>
+#include <lttng/compress.h>
+#include <ringbuffer/backend.h>
+#include <ringbuffer/frontend.h>
+
+/*
+ * Compression state of a buffer. Only used by the buffer reader, which
+ * is exclusive.
+ */
+struct lttng_compress_buf {
+	struct lttng_channel_compress *compress;
+	void *tfm;		/* Compression transform */
+	void *src;		/* Linearized sub-buffer data */
+	void *dst;		/* Packet header and compressed payload */
+	size_t len;		/* Packet length */
+};
+
+struct lttng_channel_compress {
+	enum lttng_kernel_abi_compression format;
+	const char *alg_name;
+	size_t subbuf_size;
+	unsigned int nr_bufs;
+	struct lttng_compress_buf **bufs;	/* Lazily allocated, per buffer */
+};
+
+#if IS_ENABLED(CONFIG_CRYPTO)
+static
+bool lttng_compress_alg_available(const char *alg_name)
+{
+	return crypto_has_comp(alg_name, 0, 0);
+}
+
+static
+void *lttng_compress_tfm_alloc(const char *alg_name)
+{
+	struct crypto_comp *tfm;
+
+	tfm = crypto_alloc_comp(alg_name, 0, 0);
+	if (IS_ERR(tfm))
+		return NULL;
+	return tfm;
+}
+
+static
+void lttng_compress_tfm_free(void *tfm)
+{
+	crypto_free_comp(tfm);
+}
+
+static
+int lttng_compress_tfm_compress(void *tfm, const void *src, unsigned int slen,
+		void *dst, unsigned int *dlen)
+{
+	return crypto_comp_compress(tfm, src, slen, dst, dlen);
+}
+#else /* IS_ENABLED(CONFIG_CRYPTO) */
+static
+bool lttng_compress_alg_available(const char *alg_name)
+{
+	return false;
+}
+
+static
+void *lttng_compress_tfm_alloc(const char *alg_name)
+{
+	return NULL;
+}
+
+static
+void lttng_compress_tfm_free(void *tfm)
+{
+}
+
+static
+int lttng_compress_tfm_compress(void *tfm, const void *src, unsigned int slen,
+		void *dst, unsigned int *dlen)
+{
+	return -EOPNOTSUPP;
+}
+#endif /* IS_ENABLED(CONFIG_CRYPTO) */
+
+/*
+ * Compress the sub-buffer currently held by the reader of @buf into
+ * the packet buffer of @cbuf. Runs in the context of the consumer
+ * ioctl, so the compression cost is charged to the consumer rather
+ * than to the CPU being traced.
+ */
+static
+void lttng_compress_subbuf(struct lttng_compress_buf *cbuf,
+		struct lttng_kernel_ring_buffer *buf)
+{
+	struct lttng_kernel_abi_compressed_packet_header *header = cbuf->dst;
+	struct lttng_kernel_ring_buffer_channel *chan = buf->backend.chan;
+	const struct lttng_kernel_ring_buffer_config *config = &chan->backend.config;
+	unsigned long data_size;
+	unsigned int dlen;
+	int ret;
+
+	data_size = lib_ring_buffer_get_read_data_size(config, buf);
+	lib_ring_buffer_read(&buf->backend, 0, cbuf->src, data_size);
+	/*
+	 * Store the payload uncompressed if it does not shrink, so the
+	 * packet is never larger than the sub-buffer data and its header.
+	 */
+	dlen = data_size;
+	ret = lttng_compress_tfm_compress(cbuf->tfm, cbuf->src, data_size,
+			header + 1, &dlen);
+	if (!ret && dlen < data_size) {
+		header->format = cbuf->compress->format;
+	} else {
+		memcpy(header + 1, cbuf->src, data_size);
+		header->format = LTTNG_KERNEL_ABI_COMPRESSION_NONE;
+		dlen = data_size;
+	}
+	header->magic = LTTNG_KERNEL_ABI_COMPRESSED_PACKET_MAGIC;
+	header->compressed_size = dlen;
+	header->uncompressed_size = data_size;
+	cbuf->len = sizeof(*header) + dlen;
+}
+
+static
+void lttng_compress_buf_free(struct lttng_compress_buf *cbuf)
+{
+	if (!cbuf)
+		return;
+	if (cbuf->tfm)
+		lttng_compress_tfm_free(cbuf->tfm);
+	lttng_kvfree(cbuf->src);
+	lttng_kvfree(cbuf->dst);
+	kfree(cbuf);
+}
+
+static
+struct lttng_compress_buf *lttng_compress_buf_alloc(struct lttng_channel_compress *compress,
+		int node)
+{
+	struct lttng_compress_buf *cbuf;
+
+	cbuf = kzalloc_node(sizeof(*cbuf), GFP_KERNEL, node);
+	if (!cbuf)
+		return NULL;
+	cbuf->compress = compress;
+	cbuf->src = lttng_kvmalloc_node(compress->subbuf_size, GFP_KERNEL, node);
+	if (!cbuf->src)
+		goto error;
+	cbuf->dst = lttng_kvmalloc_node(sizeof(struct lttng_kernel_abi_compressed_packet_header)
+			+ compress->subbuf_size, GFP_KERNEL, node);
+	if (!cbuf->dst)
+		goto error;
+	cbuf->tfm = lttng_compress_tfm_alloc(compress->alg_name);
+	if (!cbuf->tfm)
+		goto error;
+	return cbuf;
+
+error:
+	lttng_compress_buf_free(cbuf);
+	return NULL;
+}
+
+int lttng_channel_compress_create(struct lttng_kernel_channel_buffer *chan,
+		enum lttng_kernel_abi_compression format)
+{
+	struct lttng_kernel_ring_buffer_channel *rb_chan = chan->priv->rb_chan;
+	const struct lttng_kernel_ring_buffer_config *config = &rb_chan->backend.config;
+	struct lttng_channel_compress *compress;
+
+	compress = kzalloc(sizeof(*compress), GFP_KERNEL);
+	if (!compress)
+		return -ENOMEM;
+	compress->format = format;
+	switch (format) {
+	case LTTNG_KERNEL_ABI_COMPRESSION_LZ4:
+		compress->alg_name = "lz4";
+		break;
+	case LTTNG_KERNEL_ABI_COMPRESSION_ZSTD:
+		compress->alg_name = "zstd";
+		break;
+	default:
+		kfree(compress);
+		return -EINVAL;
+	}
+	if (!lttng_compress_alg_available(compress->alg_name)) {
+		kfree(compress);
+		return -ENOENT;
+	}
+	compress->subbuf_size = rb_chan->backend.subbuf_size;
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+		compress->nr_bufs = nr_cpu_ids;
+	else
+		compress->nr_bufs = 1;
+	compress->bufs = kcalloc(compress->nr_bufs, sizeof(*compress->bufs),
+			GFP_KERNEL);
+	if (!compress->bufs) {
+		kfree(compress);
+		return -ENOMEM;
+	}
+	chan->priv->compress = compress;
+	return 0;
+}
+
+void lttng_channel_compress_destroy(struct lttng_channel_compress *compress)
+{
+	unsigned int i;
+
+	if (!compress)
+		return;
+	for (i = 0; i < compress->nr_bufs; i++)
+		lttng_compress_buf_free(compress->bufs[i]);
+	kfree(compress->bufs);
+	kfree(compress);
+}
+
+long lttng_channel_compress_get_subbuf(struct lttng_kernel_channel_buffer *chan,
+		struct lttng_kernel_ring_buffer *buf,
+		struct lttng_kernel_abi_compressed_subbuf __user *uarg)
+{
+	struct lttng_channel_compress *compress = chan->priv->compress;
+	struct lttng_kernel_abi_compressed_subbuf csb;
+	struct lttng_compress_buf *cbuf;
+	unsigned int index;
+
+	if (!compress || !buf->get_subbuf)
+		return -EINVAL;
+	if (copy_from_user(&csb, uarg, sizeof(csb)))
+		return -EFAULT;
+	index = buf->backend.cpu >= 0 ? buf->backend.cpu : 0;
+	cbuf = compress->bufs[index];
+	if (!cbuf) {
+		cbuf = lttng_compress_buf_alloc(compress,
+			buf->backend.cpu >= 0 ? cpu_to_node(buf->backend.cpu) : NUMA_NO_NODE);
+		if (!cbuf)
+			return -ENOMEM;
+		compress->bufs[index] = cbuf;
+	}
+	lttng_compress_subbuf(cbuf, buf);
+	if (csb.len < cbuf->len) {
+		/* Report the required destination size. */
+		csb.len = cbuf->len;
+		if (copy_to_user(uarg, &csb, sizeof(csb)))
+			return -EFAULT;
+		return -ENOSPC;
+	}
+	if (copy_to_user((void __user *)(unsigned long) csb.addr, cbuf->dst,
+			cbuf->len))
+		return -EFAULT;
+	csb.len = cbuf->len;
+	if (copy_to_user(uarg, &csb, sizeof(csb)))
+		return -EFAULT;
+	return 0;
+}
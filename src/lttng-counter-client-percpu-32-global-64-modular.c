@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-counter-client-percpu-32-global-64-modular.c
+ *
+ * LTTng lib counter client. Per-cpu 32-bit counters spilling
+ * into 64-bit global counters, in overflow arithmetic.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#define COUNTER_ALLOC_TEMPLATE		(COUNTER_ALLOC_PER_CPU | COUNTER_ALLOC_GLOBAL)
+#define COUNTER_ARITHMETIC_TEMPLATE	COUNTER_ARITHMETIC_MODULAR
+#define COUNTER_SIZE_TEMPLATE		COUNTER_SIZE_32_BIT
+#define COUNTER_WIDE_GLOBAL_TEMPLATE	true
+#define COUNTER_TRANSPORT_NAME_TEMPLATE	"counter-per-cpu-32-global-64-modular"
+#define COUNTER_DESCRIPTION_TEMPLATE	"LTTng counter per-cpu 32-bit, global 64-bit overflow client"
+#include "lttng-counter-client.h"
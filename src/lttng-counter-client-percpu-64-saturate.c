@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-counter-client-percpu-64-saturate.c
+ *
+ * LTTng lib counter client. Per-cpu 64-bit counters in saturating
+ * arithmetic.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#define COUNTER_ALLOC_TEMPLATE		COUNTER_ALLOC_PER_CPU
+#define COUNTER_ARITHMETIC_TEMPLATE	COUNTER_ARITHMETIC_SATURATE
+#define COUNTER_SIZE_TEMPLATE		COUNTER_SIZE_64_BIT
+#define COUNTER_WIDE_GLOBAL_TEMPLATE	false
+#define COUNTER_TRANSPORT_NAME_TEMPLATE	"counter-per-cpu-64-saturate"
+#define COUNTER_DESCRIPTION_TEMPLATE	"LTTng counter per-cpu 64-bit saturating client"
+#include "lttng-counter-client.h"
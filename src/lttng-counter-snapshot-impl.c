@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-counter-snapshot-impl.c
+ *
+ * LTTng counter snapshot provider. Defines the tracepoints recording the
+ * periodic counter snapshots of a session.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+
+#include <lttng/events.h>
+#include <lttng/events-internal.h>
+#include <lttng/tracer.h>
+#include <wrapper/tracepoint.h>
+
+/* Define the tracepoints, but do not build the probes */
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events
+#define TRACE_INCLUDE_FILE lttng-counter-snapshot
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-counter-snapshot.h>
+
+LTTNG_DEFINE_TRACE(lttng_counter_snapshot_delta,
+	TP_PROTO(struct lttng_kernel_session *session,
+		uint64_t id, uint64_t index, int64_t delta),
+	TP_ARGS(session, id, index, delta));
+
+/*
+ * Record the change of the counter element @index of the snapshot @id
+ * in @session.
+ */
+void lttng_counter_snapshot_emit(struct lttng_kernel_session *session,
+		uint64_t id, uint64_t index, int64_t delta)
+{
+	trace_lttng_counter_snapshot_delta(session, id, index, delta);
+}
+EXPORT_SYMBOL_GPL(lttng_counter_snapshot_emit);
+
+static
+int __init lttng_counter_snapshot_init(void)
+{
+	/* Allow module to load even if the fixup cannot be done. */
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	return 0;
+}
+
+module_init(lttng_counter_snapshot_init);
+
+static
+void __exit lttng_counter_snapshot_exit(void)
+{
+}
+
+module_exit(lttng_counter_snapshot_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("EfficiOS Inc.");
+MODULE_DESCRIPTION("LTTng counter snapshot provider");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -6,13 +6,21 @@
  */
 
 #include <linux/bug.h>
+#include <linux/hash.h>
+#include <linux/irq_work.h>
+#include <linux/jhash.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 
 #include <lttng/lttng-bytecode.h>
 #include <lttng/events.h>
 #include <lttng/msgpack.h>
 #include <lttng/event-notifier-notification.h>
 #include <lttng/events-internal.h>
+#include <counter/sparse-counter.h>
 #include <wrapper/barrier.h>
+#include <wrapper/rcu.h>
 
 /*
  * The capture buffer size needs to be below 1024 bytes to avoid the
@@ -378,16 +386,18 @@ void record_error(struct lttng_kernel_event_notifier *event_notifier)
 
 static
 void notification_send(struct lttng_event_notifier_notification *notif,
-		struct lttng_kernel_event_notifier *event_notifier)
+		struct lttng_kernel_event_notifier *event_notifier,
+		uint32_t coalesced)
 {
 	struct lttng_event_notifier_group *event_notifier_group = event_notifier->priv->group;
 	struct lttng_kernel_ring_buffer_ctx ctx;
-	struct lttng_kernel_abi_event_notifier_notification kernel_notif;
+	struct lttng_kernel_abi_event_notifier_notification kernel_notif = { 0 };
 	size_t capture_buffer_content_len, reserve_size;
 	int ret;
 
 	reserve_size = sizeof(kernel_notif);
 	kernel_notif.token = event_notifier->priv->parent.user_token;
+	kernel_notif.coalesced = coalesced;
 
 	if (notif->has_captures) {
 		capture_buffer_content_len = notif->writer.write_pos - notif->writer.buffer;
@@ -420,7 +430,156 @@ void notification_send(struct lttng_event_notifier_notification *notif,
 			capture_buffer_content_len, 1);
 
 	event_notifier_group->ops->event_commit(&ctx);
-	irq_work_queue(&event_notifier_group->wakeup_pending);
+	/* Staged notifications wake up the reader when they are published. */
+	if (!event_notifier_group->staging)
+		irq_work_queue(&event_notifier_group->wakeup_pending);
+}
+
+/*
+ * Whether the interval and token bucket of a rate policy let a
+ * notification through at @now, in nanoseconds of the monotonic clock.
+ * The trace clock is not used, as it may count cycles when a clock
+ * plugin is loaded. Only the notifications which pass all the checks
+ * start a new interval. Concurrent notifications may let a few more
+ * notifications through, or consume a token without notifying.
+ */
+static
+bool notification_rate_accept(struct lttng_event_notifier_rate *rate, uint64_t now)
+{
+	const struct lttng_event_notifier_rate_policy *policy = &rate->policy;
+	uint64_t last = 0;
+
+	if (policy->min_interval) {
+		last = (uint64_t) atomic64_read(&rate->last);
+		if (now - last < policy->min_interval)
+			return false;
+	}
+	if (policy->token_interval) {
+		uint64_t old_time, time;
+
+		do {
+			old_time = (uint64_t) atomic64_read(&rate->bucket_time);
+			/* A bucket unused for a while is full. */
+			time = (int64_t) (old_time - now) < 0 ? now : old_time;
+			if (time - now > policy->bucket_depth - policy->token_interval)
+				return false;
+		} while (atomic64_cmpxchg(&rate->bucket_time, (s64) old_time,
+				(s64) (time + policy->token_interval)) != (s64) old_time);
+	}
+	/* Only one of concurrent notifications starts the next interval. */
+	if (policy->min_interval
+			&& atomic64_cmpxchg(&rate->last, (s64) last, (s64) now) != (s64) last)
+		return false;
+	return true;
+}
+
+/*
+ * Apply the rate policy of an event notifier to a firing. The first
+ * firing of each batch of @coalesce firings is notified, provided the
+ * interval and token bucket allow it. Returns true if the firing is
+ * notified, with the number of previous firings which were not notified
+ * in *@coalesced. Otherwise, the firing is left pending and a flush is
+ * scheduled.
+ */
+static
+bool notification_rate_fire(struct lttng_event_notifier_rate *rate,
+		uint32_t *coalesced)
+{
+	const struct lttng_event_notifier_rate_policy *policy = &rate->policy;
+	uint64_t now = 0;
+
+	if (policy->coalesce > 1
+			&& ((unsigned int) atomic_inc_return(&rate->batch) - 1) % policy->coalesce)
+		goto pending;
+	if (policy->min_interval || policy->token_interval)
+		now = ktime_get_mono_fast_ns();
+	if (!notification_rate_accept(rate, now))
+		goto pending;
+	*coalesced = (uint32_t) atomic_xchg(&rate->pending, 0);
+	return true;
+
+pending:
+	atomic_inc(&rate->pending);
+	/* Workqueues cannot be used from the probe context. */
+	if (!test_and_set_bit(0, &rate->flush_armed))
+		irq_work_queue(&rate->flush_irq_work);
+	return false;
+}
+
+static
+void notification_rate_flush_irq_work(struct irq_work *entry)
+{
+	struct lttng_event_notifier_rate *rate =
+		container_of(entry, struct lttng_event_notifier_rate, flush_irq_work);
+
+	schedule_delayed_work(&rate->flush_work, rate->policy.flush_delay);
+}
+
+/*
+ * Report the pending firings of an event notifier with a notification
+ * holding empty captures, unless a notification reported them in the
+ * meantime.
+ */
+static
+void notification_rate_flush_work(struct work_struct *work)
+{
+	struct lttng_event_notifier_rate *rate =
+		container_of(work, struct lttng_event_notifier_rate, flush_work.work);
+	struct lttng_kernel_event_notifier *event_notifier = rate->event_notifier;
+	struct lttng_event_notifier_notification notif = { 0 };
+	unsigned int pending, i;
+
+	clear_bit(0, &rate->flush_armed);
+	/* Firings left pending after this point schedule another flush. */
+	smp_mb__after_atomic();
+	if (!atomic_read(&rate->pending) || !READ_ONCE(event_notifier->parent.enabled))
+		return;
+	if (!notification_rate_accept(rate, ktime_get_mono_fast_ns())) {
+		if (!test_and_set_bit(0, &rate->flush_armed))
+			schedule_delayed_work(&rate->flush_work, rate->policy.flush_delay);
+		return;
+	}
+	pending = (unsigned int) atomic_xchg(&rate->pending, 0);
+	if (!pending)
+		return;
+	if (notification_init(&notif, event_notifier)) {
+		WARN_ON_ONCE(1);
+		return;
+	}
+	for (i = 0; notif.has_captures && i < event_notifier->priv->num_captures; i++) {
+		if (notification_append_empty_capture(&notif))
+			printk(KERN_WARNING "Error appending capture to notification");
+	}
+	/* The ring buffer is written to with preemption disabled, as from probes. */
+	rcu_read_lock_sched_notrace();
+	notification_send(&notif, event_notifier, pending - 1);
+	rcu_read_unlock_sched_notrace();
+}
+
+void lttng_event_notifier_rate_init(struct lttng_event_notifier_rate *rate,
+		struct lttng_kernel_event_notifier *event_notifier)
+{
+	rate->event_notifier = event_notifier;
+	atomic_set(&rate->batch, 0);
+	atomic_set(&rate->pending, 0);
+	atomic64_set(&rate->last, 0);
+	atomic64_set(&rate->bucket_time, 0);
+	rate->flush_armed = 0;
+	init_irq_work(&rate->flush_irq_work, notification_rate_flush_irq_work);
+	INIT_DELAYED_WORK(&rate->flush_work, notification_rate_flush_work);
+}
+
+/*
+ * Called once the probes cannot fire the event notifier anymore. Pending
+ * firings which were not flushed yet are dropped.
+ */
+void lttng_event_notifier_rate_destroy(struct lttng_event_notifier_rate *rate)
+{
+	if (!rate)
+		return;
+	irq_work_sync(&rate->flush_irq_work);
+	cancel_delayed_work_sync(&rate->flush_work);
+	kfree(rate);
 }
 
 void lttng_event_notifier_notification_send(struct lttng_kernel_event_notifier *event_notifier,
@@ -429,11 +588,18 @@ void lttng_event_notifier_notification_send(struct lttng_kernel_event_notifier *
 		struct lttng_kernel_notification_ctx *notif_ctx)
 {
 	struct lttng_event_notifier_notification notif = { 0 };
+	struct lttng_event_notifier_rate *rate;
+	uint32_t coalesced = 0;
 	int ret;
 
 	if (unlikely(!READ_ONCE(event_notifier->parent.enabled)))
 		return;
 
+	/* Before captures are evaluated, to bound the cost of bursts. */
+	rate = lttng_rcu_dereference(event_notifier->priv->rate);
+	if (unlikely(rate) && !notification_rate_fire(rate, &coalesced))
+		return;
+
 	ret = notification_init(&notif, event_notifier);
 	if (ret) {
 		WARN_ON_ONCE(1);
@@ -468,7 +634,375 @@ void lttng_event_notifier_notification_send(struct lttng_kernel_event_notifier *
 	 * Send the notification (including the capture buffer) to the
 	 * sessiond.
 	 */
-	notification_send(&notif, event_notifier);
+	notification_send(&notif, event_notifier, coalesced);
 end:
 	return;
 }
+
+static
+bool capture_integer(const struct lttng_interpreter_output *output, uint64_t *value)
+{
+	switch (output->type) {
+	case LTTNG_INTERPRETER_TYPE_S64:
+	case LTTNG_INTERPRETER_TYPE_SIGNED_ENUM:
+		*value = (uint64_t) output->u.s;
+		return true;
+	case LTTNG_INTERPRETER_TYPE_U64:
+	case LTTNG_INTERPRETER_TYPE_UNSIGNED_ENUM:
+		*value = output->u.u;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static
+bool capture_is_signed(const struct lttng_interpreter_output *output)
+{
+	return output->type == LTTNG_INTERPRETER_TYPE_S64
+		|| output->type == LTTNG_INTERPRETER_TYPE_SIGNED_ENUM;
+}
+
+/*
+ * Log-linear (HDR) bucket: values below the sub-bucket count are their
+ * own bucket, each following power of two range is split in
+ * LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS buckets.
+ */
+static
+uint64_t counter_log_linear_bucket(uint64_t value)
+{
+	const unsigned int order = LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS_ORDER;
+	unsigned int exponent;
+
+	if (value < LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS)
+		return value;
+	exponent = fls64(value) - 1;
+	return ((uint64_t) (exponent - order + 1) << order)
+		+ ((value >> (exponent - order)) & (LTTNG_KERNEL_ABI_COUNTER_LOG_LINEAR_SUB_BUCKETS - 1));
+}
+
+/*
+ * Histogram bucket of an integer key for histogram key modes. @is_signed
+ * tells whether negative keys are below all buckets.
+ */
+static
+uint64_t counter_integer_key_bucket(uint64_t key, bool is_signed,
+		enum lttng_kernel_abi_counter_key_mode mode)
+{
+	if (is_signed && (int64_t) key < 0)
+		key = 0;
+	if (mode == LTTNG_KERNEL_ABI_COUNTER_KEY_LOG2)
+		return fls64(key);
+	return counter_log_linear_bucket(key);
+}
+
+/*
+ * Map an integer key to an index within a counter dimension of @size
+ * elements. Returns false if the key cannot be mapped.
+ */
+static
+bool counter_integer_key_index(uint64_t key, bool is_signed,
+		enum lttng_kernel_abi_counter_key_mode mode, size_t size,
+		size_t *index)
+{
+	switch (mode) {
+	case LTTNG_KERNEL_ABI_COUNTER_KEY_DIRECT:
+		if (key >= size)
+			return false;
+		*index = (size_t) key;
+		return true;
+	case LTTNG_KERNEL_ABI_COUNTER_KEY_HASH:
+		*index = jhash_2words((u32) key, (u32) (key >> 32), 0) % size;
+		return true;
+	case LTTNG_KERNEL_ABI_COUNTER_KEY_LOG2:
+	case LTTNG_KERNEL_ABI_COUNTER_KEY_LOG_LINEAR:
+		*index = (size_t) min_t(uint64_t,
+				counter_integer_key_bucket(key, is_signed, mode), size - 1);
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Map an integer key to a sparse map key component: histogram key modes
+ * use the bucket, other modes the key itself.
+ */
+static
+uint64_t counter_integer_sparse_key(uint64_t key, bool is_signed,
+		enum lttng_kernel_abi_counter_key_mode mode)
+{
+	switch (mode) {
+	case LTTNG_KERNEL_ABI_COUNTER_KEY_LOG2:
+	case LTTNG_KERNEL_ABI_COUNTER_KEY_LOG_LINEAR:
+		return counter_integer_key_bucket(key, is_signed, mode);
+	default:
+		return key;
+	}
+}
+
+/*
+ * Map a key capture to an index within a counter dimension of @size
+ * elements. Returns false if the key cannot be mapped.
+ */
+static
+bool counter_key_index(const struct lttng_interpreter_output *output,
+		enum lttng_kernel_abi_counter_key_mode mode, size_t size,
+		size_t *index)
+{
+	uint64_t key;
+
+	if (output->type == LTTNG_INTERPRETER_TYPE_STRING) {
+		if (mode != LTTNG_KERNEL_ABI_COUNTER_KEY_HASH)
+			return false;
+		*index = jhash(output->u.str.str,
+				strnlen(output->u.str.str, output->u.str.len), 0) % size;
+		return true;
+	}
+	if (!capture_integer(output, &key))
+		return false;
+	return counter_integer_key_index(key, capture_is_signed(output), mode,
+			size, index);
+}
+
+/*
+ * Map a key capture to a sparse map key component. Returns false if the
+ * key cannot be mapped.
+ */
+static
+bool counter_sparse_key(const struct lttng_interpreter_output *output,
+		enum lttng_kernel_abi_counter_key_mode mode, uint64_t *sparse_key)
+{
+	uint64_t key;
+
+	if (output->type == LTTNG_INTERPRETER_TYPE_STRING) {
+		if (mode != LTTNG_KERNEL_ABI_COUNTER_KEY_HASH)
+			return false;
+		*sparse_key = jhash(output->u.str.str,
+				strnlen(output->u.str.str, output->u.str.len), 0);
+		return true;
+	}
+	if (!capture_integer(output, &key))
+		return false;
+	*sparse_key = counter_integer_sparse_key(key, capture_is_signed(output), mode);
+	return true;
+}
+
+/*
+ * Evaluate at most @max captures of the event notifier in @outputs.
+ * Returns the number of captures evaluated, or -1 on error.
+ */
+static
+int eval_captures(struct lttng_kernel_event_notifier *event_notifier,
+		const char *stack_data,
+		struct lttng_kernel_probe_ctx *probe_ctx,
+		struct lttng_interpreter_output *outputs, int max)
+{
+	struct lttng_kernel_bytecode_runtime *capture_bc_runtime;
+	int nr_outputs = 0;
+
+	list_for_each_entry_rcu(capture_bc_runtime,
+			&event_notifier->priv->capture_bytecode_runtime_head, node) {
+		if (nr_outputs == max)
+			break;
+		if (capture_bc_runtime->interpreter_func(capture_bc_runtime,
+				stack_data, probe_ctx, &outputs[nr_outputs]) != LTTNG_KERNEL_BYTECODE_INTERPRETER_OK)
+			return -1;
+		nr_outputs++;
+	}
+	return nr_outputs;
+}
+
+/*
+ * Counter increment action: evaluate the key captures, one per dimension
+ * of the aggregation map, and add the value capture (or 1) to the
+ * resulting map element. Keys which cannot be mapped are accounted in the
+ * error counter of the group.
+ */
+void lttng_event_notifier_counter_increment(struct lttng_kernel_event_notifier *event_notifier,
+		const char *stack_data,
+		struct lttng_kernel_probe_ctx *probe_ctx,
+		struct lttng_kernel_notification_ctx *notif_ctx)
+{
+	struct lttng_interpreter_output outputs[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX + 1];
+	struct lttng_counter *counter = event_notifier->priv->counter;
+	size_t dimension_indexes[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+	uint64_t value = 1;
+	int nr_outputs;
+	size_t i;
+
+	if (unlikely(!READ_ONCE(event_notifier->parent.enabled)))
+		return;
+	if (unlikely(!notif_ctx->eval_capture))
+		goto error;
+	nr_outputs = eval_captures(event_notifier, stack_data, probe_ctx,
+			outputs, ARRAY_SIZE(outputs));
+	if (nr_outputs < (int) counter->nr_dimensions)
+		goto error;
+	/* Value capture. */
+	if ((size_t) nr_outputs > counter->nr_dimensions
+			&& !capture_integer(&outputs[counter->nr_dimensions], &value))
+		goto error;
+	if (counter->sparse) {
+		uint64_t keys[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+
+		for (i = 0; i < counter->nr_dimensions; i++) {
+			if (!counter_sparse_key(&outputs[i], event_notifier->priv->key_mode[i],
+					&keys[i]))
+				goto error;
+		}
+		lttng_sparse_counter_add(counter->sparse, keys, (int64_t) value);
+		return;
+	}
+	for (i = 0; i < counter->nr_dimensions; i++) {
+		if (!counter_key_index(&outputs[i], event_notifier->priv->key_mode[i],
+				counter->dimension_sizes[i], &dimension_indexes[i]))
+			goto error;
+	}
+	if (counter->ops->counter_add(counter->counter, dimension_indexes, (int64_t) value))
+		goto error;
+	return;
+
+error:
+	record_error(event_notifier);
+}
+
+static
+struct lttng_counter_timestamp *counter_timestamp_entry(struct lttng_counter *counter,
+		unsigned long key)
+{
+	/* Matches store-release in lttng_kernel_counter_alloc_start_timestamps. */
+	struct lttng_counter_timestamp *start_timestamps =
+		lttng_smp_load_acquire(&counter->start_timestamps);
+
+	return &start_timestamps[hash_long(key, LTTNG_COUNTER_TIMESTAMP_TABLE_ORDER)];
+}
+
+/*
+ * Evaluate the pairing key capture of a timestamp action, encoded as
+ * stored in the start timestamp table.
+ */
+static
+bool eval_timestamp_key(const struct lttng_interpreter_output *output,
+		unsigned long *key)
+{
+	uint64_t value;
+
+	if (!capture_integer(output, &value))
+		return false;
+	if (value > ULONG_MAX - LTTNG_COUNTER_TIMESTAMP_KEY_BIAS)
+		return false;
+	*key = (unsigned long) value + LTTNG_COUNTER_TIMESTAMP_KEY_BIAS;
+	return true;
+}
+
+/*
+ * Timestamp start action: save the current time for the pairing key.
+ * The entry is marked busy while updated so a concurrent stop action
+ * cannot consume a partially written timestamp. A start colliding with
+ * another key in the table replaces its start time. Latencies are
+ * histogrammed in nanoseconds, so the time comes from the monotonic
+ * clock rather than the trace clock, which may count cycles when a
+ * clock plugin is loaded.
+ */
+void lttng_event_notifier_timestamp_start(struct lttng_kernel_event_notifier *event_notifier,
+		const char *stack_data,
+		struct lttng_kernel_probe_ctx *probe_ctx,
+		struct lttng_kernel_notification_ctx *notif_ctx)
+{
+	struct lttng_interpreter_output output;
+	struct lttng_counter_timestamp *entry;
+	unsigned long key;
+
+	if (unlikely(!READ_ONCE(event_notifier->parent.enabled)))
+		return;
+	if (unlikely(!notif_ctx->eval_capture))
+		goto error;
+	if (eval_captures(event_notifier, stack_data, probe_ctx, &output, 1) != 1)
+		goto error;
+	if (!eval_timestamp_key(&output, &key))
+		goto error;
+	entry = counter_timestamp_entry(event_notifier->priv->counter, key);
+	xchg(&entry->key, LTTNG_COUNTER_TIMESTAMP_BUSY);
+	WRITE_ONCE(entry->timestamp, ktime_get_mono_fast_ns());
+	/* Publish the timestamp before the key. */
+	smp_store_release(&entry->key, key);
+	return;
+
+error:
+	record_error(event_notifier);
+}
+
+/*
+ * Timestamp stop action: consume the start time saved for the pairing
+ * key and histogram the latency in the last dimension of the aggregation
+ * map, keyed by the following captures on the other dimensions.
+ *
+ * The start time is read before the entry is claimed with cmpxchg() on
+ * its key. A start action for the same key completing in between leaves
+ * the key unchanged, so the stop may be paired with either start time
+ * and the newer start is consumed.
+ */
+void lttng_event_notifier_timestamp_stop(struct lttng_kernel_event_notifier *event_notifier,
+		const char *stack_data,
+		struct lttng_kernel_probe_ctx *probe_ctx,
+		struct lttng_kernel_notification_ctx *notif_ctx)
+{
+	struct lttng_interpreter_output outputs[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+	struct lttng_counter *counter = event_notifier->priv->counter;
+	size_t dimension_indexes[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+	size_t latency_dimension = counter->nr_dimensions - 1;
+	struct lttng_counter_timestamp *entry;
+	u64 start, now;
+	unsigned long key;
+	size_t i;
+
+	if (unlikely(!READ_ONCE(event_notifier->parent.enabled)))
+		return;
+	if (unlikely(!notif_ctx->eval_capture))
+		goto error;
+	if (eval_captures(event_notifier, stack_data, probe_ctx,
+			outputs, counter->nr_dimensions) != (int) counter->nr_dimensions)
+		goto error;
+	if (!eval_timestamp_key(&outputs[0], &key))
+		goto error;
+	now = ktime_get_mono_fast_ns();
+	entry = counter_timestamp_entry(counter, key);
+	/* Matches store-release in lttng_event_notifier_timestamp_start. */
+	if (smp_load_acquire(&entry->key) != key)
+		return;
+	start = READ_ONCE(entry->timestamp);
+	/* Fails if a start action updated the entry concurrently. */
+	if (cmpxchg(&entry->key, key, LTTNG_COUNTER_TIMESTAMP_EMPTY) != key)
+		return;
+
+	if (counter->sparse) {
+		uint64_t keys[LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX];
+
+		for (i = 0; i < latency_dimension; i++) {
+			if (!counter_sparse_key(&outputs[i + 1], event_notifier->priv->key_mode[i],
+					&keys[i]))
+				goto error;
+		}
+		keys[latency_dimension] = counter_integer_sparse_key(now > start ? now - start : 0,
+				false, event_notifier->priv->key_mode[latency_dimension]);
+		lttng_sparse_counter_add(counter->sparse, keys, 1);
+		return;
+	}
+	for (i = 0; i < latency_dimension; i++) {
+		if (!counter_key_index(&outputs[i + 1], event_notifier->priv->key_mode[i],
+				counter->dimension_sizes[i], &dimension_indexes[i]))
+			goto error;
+	}
+	if (!counter_integer_key_index(now > start ? now - start : 0, false,
+			event_notifier->priv->key_mode[latency_dimension],
+			counter->dimension_sizes[latency_dimension],
+			&dimension_indexes[latency_dimension]))
+		goto error;
+	if (counter->ops->counter_add(counter->counter, dimension_indexes, 1))
+		goto error;
+	return;
+
+error:
+	record_error(event_notifier);
+}
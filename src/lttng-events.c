@@ -27,6 +27,8 @@
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
 #include <linux/dmi.h>
+#include <linux/hash.h>
+#include <linux/math64.h>
 
 #include <wrapper/compiler_attributes.h>
 #include <wrapper/uuid.h>
@@ -35,6 +37,7 @@
 #include <wrapper/tracepoint.h>
 #include <wrapper/list.h>
 #include <wrapper/types.h>
+#include <wrapper/barrier.h>
 #include <lttng/kernel-version.h>
 #include <lttng/events.h>
 #include <lttng/events-internal.h>
@@ -45,6 +48,8 @@
 #include <lttng/endian.h>
 #include <lttng/string-utils.h>
 #include <lttng/utils.h>
+#include <lttng/compress.h>
+#include <counter/sparse-counter.h>
 #include <ringbuffer/backend.h>
 #include <ringbuffer/frontend.h>
 #include <wrapper/time.h>
@@ -55,7 +60,6 @@
 #include <stdarg.h>
 #endif
 
-#define METADATA_CACHE_DEFAULT_SIZE 4096
 
 static LIST_HEAD(sessions);
 static LIST_HEAD(event_notifier_groups);
@@ -77,7 +81,9 @@ static void lttng_event_enabler_sync(struct lttng_event_enabler_common *event_en
 
 static void _lttng_event_destroy(struct lttng_kernel_event_common *event);
 static void _lttng_channel_destroy(struct lttng_kernel_channel_buffer *chan);
+static void lttng_channel_rank_events(struct lttng_kernel_channel_buffer *chan);
 static void _lttng_event_unregister(struct lttng_kernel_event_common *event);
+static void lttng_counter_snapshot_timer_destroy(struct lttng_counter_snapshot_timer *timer);
 static
 int _lttng_event_recorder_metadata_statedump(struct lttng_kernel_event_common *event);
 static
@@ -149,11 +155,63 @@ int lttng_session_active(void)
 	return 0;
 }
 
+static
+struct lttng_metadata_cache_chunk *lttng_metadata_cache_chunk_alloc(void)
+{
+	struct lttng_metadata_cache_chunk *chunk;
+
+	chunk = kmalloc(LTTNG_METADATA_CACHE_CHUNK_SIZE, GFP_KERNEL);
+	if (!chunk)
+		return NULL;
+	chunk->len = 0;
+	return chunk;
+}
+
+static
+struct lttng_metadata_log *lttng_metadata_log_create(uint64_t version)
+{
+	struct lttng_metadata_log *log;
+	struct lttng_metadata_cache_chunk *chunk;
+
+	log = kzalloc(sizeof(*log), GFP_KERNEL);
+	if (!log)
+		return NULL;
+	INIT_LIST_HEAD(&log->chunks);
+	chunk = lttng_metadata_cache_chunk_alloc();
+	if (!chunk) {
+		kfree(log);
+		return NULL;
+	}
+	list_add_tail(&chunk->node, &log->chunks);
+	log->version = version;
+	return log;
+}
+
+static
+void lttng_metadata_log_destroy(struct lttng_metadata_log *log)
+{
+	struct lttng_metadata_cache_chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &log->chunks, node)
+		kfree(chunk);
+	kfree(log);
+}
+
+/*
+ * Get the metadata log of a producer, which holds the cache lock.
+ */
+static
+struct lttng_metadata_log *lttng_metadata_cache_log(struct lttng_metadata_cache *cache)
+{
+	return rcu_dereference_protected(cache->log, lockdep_is_held(&cache->lock));
+}
+
 struct lttng_kernel_session *lttng_session_create(void)
 {
 	struct lttng_kernel_session *session;
 	struct lttng_kernel_session_private *session_priv;
 	struct lttng_metadata_cache *metadata_cache;
+	struct lttng_metadata_log *log;
 	int i;
 
 	mutex_lock(&sessions_mutex);
@@ -174,10 +232,10 @@ struct lttng_kernel_session *lttng_session_create(void)
 			GFP_KERNEL);
 	if (!metadata_cache)
 		goto err_free_session_private;
-	metadata_cache->data = vzalloc(METADATA_CACHE_DEFAULT_SIZE);
-	if (!metadata_cache->data)
+	log = lttng_metadata_log_create(0);
+	if (!log)
 		goto err_free_cache;
-	metadata_cache->cache_alloc = METADATA_CACHE_DEFAULT_SIZE;
+	RCU_INIT_POINTER(metadata_cache->log, log);
 	kref_init(&metadata_cache->refcount);
 	mutex_init(&metadata_cache->lock);
 	session_priv->metadata_cache = metadata_cache;
@@ -185,6 +243,7 @@ struct lttng_kernel_session *lttng_session_create(void)
 	memcpy(&metadata_cache->uuid, &session_priv->uuid,
 		sizeof(metadata_cache->uuid));
 	INIT_LIST_HEAD(&session_priv->enablers_head);
+	INIT_LIST_HEAD(&session_priv->counter_snapshots);
 	for (i = 0; i < LTTNG_EVENT_HT_SIZE; i++)
 		INIT_HLIST_HEAD(&session_priv->events_ht.table[i]);
 	list_add(&session_priv->list, &sessions);
@@ -213,6 +272,7 @@ tracker_alloc_error:
 	lttng_id_tracker_fini(&session->vuid_tracker);
 	lttng_id_tracker_fini(&session->gid_tracker);
 	lttng_id_tracker_fini(&session->vgid_tracker);
+	lttng_metadata_log_destroy(log);
 err_free_cache:
 	kfree(metadata_cache);
 err_free_session_private:
@@ -238,11 +298,15 @@ struct lttng_counter_transport *lttng_counter_transport_find(const char *name)
 
 struct lttng_counter *lttng_kernel_counter_create(
 		const char *counter_transport_name,
-		size_t number_dimensions, const size_t *dimensions_sizes)
+		size_t number_dimensions, const size_t *dimensions_sizes,
+		int64_t global_sum_step)
 {
 	struct lttng_counter *counter = NULL;
 	struct lttng_counter_transport *counter_transport = NULL;
+	size_t i;
 
+	if (number_dimensions > LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX)
+		return NULL;
 	counter_transport = lttng_counter_transport_find(counter_transport_name);
 	if (!counter_transport) {
 		printk(KERN_WARNING "LTTng: counter transport %s not found.\n",
@@ -263,10 +327,14 @@ struct lttng_counter *lttng_kernel_counter_create(
 	counter->transport = counter_transport;
 
 	counter->counter = counter->ops->counter_create(
-			number_dimensions, dimensions_sizes, 0);
+			number_dimensions, dimensions_sizes, global_sum_step);
 	if (!counter->counter) {
 		goto create_error;
 	}
+	counter->nr_dimensions = number_dimensions;
+	for (i = 0; i < number_dimensions; i++)
+		counter->dimension_sizes[i] = dimensions_sizes[i];
+	INIT_LIST_HEAD(&counter->node);
 
 	return counter;
 
@@ -279,17 +347,78 @@ notransport:
 	return NULL;
 }
 
-struct lttng_event_notifier_group *lttng_event_notifier_group_create(void)
+/*
+ * Sparse aggregation maps are backed by the sparse counter library
+ * rather than by a counter transport.
+ */
+struct lttng_counter *lttng_kernel_sparse_counter_create(
+		size_t number_dimensions, size_t nr_entries)
+{
+	struct lttng_counter *counter;
+
+	if (number_dimensions > LTTNG_KERNEL_ABI_COUNTER_DIMENSION_MAX)
+		return NULL;
+	counter = lttng_kvzalloc(sizeof(struct lttng_counter), GFP_KERNEL);
+	if (!counter)
+		return NULL;
+	counter->sparse = lttng_sparse_counter_create(number_dimensions, nr_entries);
+	if (!counter->sparse) {
+		lttng_kvfree(counter);
+		return NULL;
+	}
+	counter->nr_dimensions = number_dimensions;
+	INIT_LIST_HEAD(&counter->node);
+	return counter;
+}
+
+void lttng_kernel_counter_destroy(struct lttng_counter *counter)
+{
+	if (counter->sparse) {
+		lttng_sparse_counter_destroy(counter->sparse);
+	} else {
+		counter->ops->counter_destroy(counter->counter);
+		module_put(counter->transport->owner);
+	}
+	lttng_kvfree(counter->start_timestamps);
+	lttng_kvfree(counter);
+}
+
+/*
+ * Allocate the start timestamp table used by timestamp start/stop
+ * actions on first use. Called with sessions lock held.
+ */
+int lttng_kernel_counter_alloc_start_timestamps(struct lttng_counter *counter)
+{
+	struct lttng_counter_timestamp *start_timestamps;
+
+	if (counter->start_timestamps)
+		return 0;
+	start_timestamps = lttng_kvzalloc(LTTNG_COUNTER_TIMESTAMP_TABLE_SIZE *
+			sizeof(*start_timestamps), GFP_KERNEL);
+	if (!start_timestamps)
+		return -ENOMEM;
+	/* Matches load-acquire in the timestamp actions. */
+	lttng_smp_store_release(&counter->start_timestamps, start_timestamps);
+	return 0;
+}
+
+struct lttng_event_notifier_group *lttng_event_notifier_group_create(
+		const struct lttng_kernel_abi_event_notifier_group_conf *conf)
 {
 	struct lttng_transport *transport = NULL;
 	struct lttng_event_notifier_group *event_notifier_group;
-	const char *transport_name = "relay-event-notifier";
+	const char *transport_name;
 	size_t subbuf_size = 4096;	//TODO
 	size_t num_subbuf = 16;		//TODO
 	unsigned int switch_timer_interval = 0;
 	unsigned int read_timer_interval = 0;
 	int i;
 
+	if (conf && (conf->flags & LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_PER_CPU))
+		transport_name = "relay-event-notifier-percpu";
+	else
+		transport_name = "relay-event-notifier";
+
 	mutex_lock(&sessions_mutex);
 
 	transport = lttng_transport_find(transport_name);
@@ -309,6 +438,11 @@ struct lttng_event_notifier_group *lttng_event_notifier_group_create(void)
 	if (!event_notifier_group)
 		goto nomem;
 
+	if (conf) {
+		event_notifier_group->flags = conf->flags;
+		event_notifier_group->staging_flush_interval = conf->staging_flush_interval;
+	}
+
 	/*
 	 * Initialize the ring buffer used to store event notifier
 	 * notifications.
@@ -325,6 +459,7 @@ struct lttng_event_notifier_group *lttng_event_notifier_group_create(void)
 
 	INIT_LIST_HEAD(&event_notifier_group->enablers_head);
 	INIT_LIST_HEAD(&event_notifier_group->event_notifiers_head);
+	INIT_LIST_HEAD(&event_notifier_group->maps_head);
 	for (i = 0; i < LTTNG_EVENT_HT_SIZE; i++)
 		INIT_HLIST_HEAD(&event_notifier_group->events_ht.table[i]);
 
@@ -348,7 +483,9 @@ void metadata_cache_destroy(struct kref *kref)
 {
 	struct lttng_metadata_cache *cache =
 		container_of(kref, struct lttng_metadata_cache, refcount);
-	vfree(cache->data);
+
+	/* Last reference: no reader nor producer remains. */
+	lttng_metadata_log_destroy(rcu_dereference_protected(cache->log, 1));
 	kfree(cache);
 }
 
@@ -358,10 +495,14 @@ void lttng_session_destroy(struct lttng_kernel_session *session)
 	struct lttng_kernel_event_recorder_private *event_recorder_priv, *tmpevent_recorder_priv;
 	struct lttng_metadata_stream *metadata_stream;
 	struct lttng_event_enabler_common *event_enabler, *tmp_event_enabler;
+	struct lttng_counter_snapshot_timer *counter_snapshot, *tmp_counter_snapshot;
 	int ret;
 
 	mutex_lock(&sessions_mutex);
 	WRITE_ONCE(session->active, 0);
+	list_for_each_entry_safe(counter_snapshot, tmp_counter_snapshot,
+			&session->priv->counter_snapshots, node)
+		lttng_counter_snapshot_timer_destroy(counter_snapshot);
 	list_for_each_entry(chan_priv, &session->priv->chan, node) {
 		ret = lttng_syscalls_unregister_syscall_table(&chan_priv->parent.syscall_table);
 		WARN_ON(ret);
@@ -403,6 +544,7 @@ void lttng_event_notifier_group_destroy(
 {
 	struct lttng_event_enabler_common *event_enabler, *tmp_event_enabler;
 	struct lttng_kernel_event_notifier_private *event_notifier_priv, *tmpevent_notifier_priv;
+	struct lttng_counter *map, *tmp_map;
 	int ret;
 
 	if (!event_notifier_group)
@@ -434,14 +576,15 @@ void lttng_event_notifier_group_destroy(
 		_lttng_event_destroy(&event_notifier_priv->pub->parent);
 
 	if (event_notifier_group->error_counter) {
-		struct lttng_counter *error_counter = event_notifier_group->error_counter;
-
-		error_counter->ops->counter_destroy(error_counter->counter);
-		module_put(error_counter->transport->owner);
-		lttng_kvfree(error_counter);
+		lttng_kernel_counter_destroy(event_notifier_group->error_counter);
 		event_notifier_group->error_counter = NULL;
 	}
 
+	list_for_each_entry_safe(map, tmp_map, &event_notifier_group->maps_head, node) {
+		list_del(&map->node);
+		lttng_kernel_counter_destroy(map);
+	}
+
 	event_notifier_group->ops->priv->channel_destroy(event_notifier_group->chan);
 	module_put(event_notifier_group->transport->owner);
 	list_del(&event_notifier_group->node);
@@ -460,10 +603,130 @@ int lttng_session_statedump(struct lttng_kernel_session *session)
 	return ret;
 }
 
+/*
+ * Aggregate the counter of @timer, and record the change of each element
+ * since the previous snapshot if @emit is set.
+ */
+static
+void lttng_counter_snapshot_timer_sample(struct lttng_counter_snapshot_timer *timer,
+		bool emit)
+{
+	size_t i, j;
+
+	for (i = 0; i < timer->nr_elem; i += LTTNG_COUNTER_SNAPSHOT_TIMER_CHUNK) {
+		size_t len = min_t(size_t, timer->nr_elem - i, LTTNG_COUNTER_SNAPSHOT_TIMER_CHUNK);
+
+		if (lttng_kernel_counter_aggregate_range(timer->counter, i, len,
+				timer->values, timer->overflow, timer->underflow)) {
+			WARN_ON_ONCE(1);
+			return;
+		}
+		for (j = 0; j < len; j++) {
+			/* Overflow is defined on unsigned types. */
+			int64_t delta = (int64_t) ((uint64_t) timer->values[j]
+					- (uint64_t) timer->last_values[i + j]);
+
+			if (!delta)
+				continue;
+			if (emit)
+				lttng_counter_snapshot_emit(timer->session, timer->id,
+						i + j, delta);
+			timer->last_values[i + j] = timer->values[j];
+		}
+		cond_resched();
+	}
+}
+
+static
+void lttng_counter_snapshot_timer_work(struct work_struct *work)
+{
+	struct lttng_counter_snapshot_timer *timer = container_of(work,
+			struct lttng_counter_snapshot_timer, work.work);
+
+	lttng_counter_snapshot_timer_sample(timer, true);
+	schedule_delayed_work(&timer->work, timer->period);
+}
+
+/*
+ * Changes which happen while the session is inactive are not recorded.
+ * Called with sessions mutex held.
+ */
+static
+void lttng_counter_snapshot_timer_start(struct lttng_counter_snapshot_timer *timer)
+{
+	lttng_counter_snapshot_timer_sample(timer, false);
+	schedule_delayed_work(&timer->work, timer->period);
+}
+
+/*
+ * Record the changes since the last periodic snapshot. Called with
+ * sessions mutex held, before the session is deactivated.
+ */
+static
+void lttng_counter_snapshot_timer_stop(struct lttng_counter_snapshot_timer *timer)
+{
+	cancel_delayed_work_sync(&timer->work);
+	lttng_counter_snapshot_timer_sample(timer, true);
+}
+
+static
+void lttng_counter_snapshot_timer_destroy(struct lttng_counter_snapshot_timer *timer)
+{
+	cancel_delayed_work_sync(&timer->work);
+	list_del(&timer->node);
+	fput(timer->counter_file);
+	lttng_kvfree(timer->last_values);
+	kfree(timer);
+}
+
+/*
+ * Snapshot the counter of @counter_file every @period microseconds while
+ * the session is active. Takes ownership of the @counter_file reference
+ * on success.
+ */
+int lttng_session_counter_snapshot_add(struct lttng_kernel_session *session,
+		struct file *counter_file, uint64_t id, unsigned int period)
+{
+	struct lttng_counter *counter = counter_file->private_data;
+	struct lttng_counter_snapshot_timer *timer;
+	size_t index, nr_elem;
+	int ret;
+
+	if (!period)
+		return -EINVAL;
+	/* Sparse counters have no dense range to aggregate. */
+	ret = lttng_kernel_counter_get_slice(counter, 0, NULL, &index, &nr_elem);
+	if (ret)
+		return ret;
+	timer = kzalloc(sizeof(*timer), GFP_KERNEL);
+	if (!timer)
+		return -ENOMEM;
+	timer->last_values = lttng_kvzalloc(nr_elem * sizeof(int64_t), GFP_KERNEL);
+	if (!timer->last_values) {
+		kfree(timer);
+		return -ENOMEM;
+	}
+	timer->session = session;
+	timer->counter_file = counter_file;
+	timer->counter = counter;
+	timer->id = id;
+	timer->period = max_t(unsigned long, usecs_to_jiffies(period), 1);
+	timer->nr_elem = nr_elem;
+	INIT_DELAYED_WORK(&timer->work, lttng_counter_snapshot_timer_work);
+
+	mutex_lock(&sessions_mutex);
+	list_add(&timer->node, &session->priv->counter_snapshots);
+	if (session->active)
+		lttng_counter_snapshot_timer_start(timer);
+	mutex_unlock(&sessions_mutex);
+	return 0;
+}
+
 int lttng_session_enable(struct lttng_kernel_session *session)
 {
 	int ret = 0;
 	struct lttng_kernel_channel_buffer_private *chan_priv;
+	struct lttng_counter_snapshot_timer *counter_snapshot;
 
 	mutex_lock(&sessions_mutex);
 	if (session->active) {
@@ -479,15 +742,25 @@ int lttng_session_enable(struct lttng_kernel_session *session)
 
 	/*
 	 * Snapshot the number of events per channel to know the type of header
-	 * we need to use.
+	 * we need to use. Channels with hot event hints use the compact (or
+	 * packed) header for their hot events and the extended ID escape for
+	 * the others.
 	 */
 	list_for_each_entry(chan_priv, &session->priv->chan, node) {
 		if (chan_priv->header_type)
 			continue;			/* don't change it if session stop/restart */
-		if (chan_priv->free_event_id < 31)
+		if (chan_priv->nr_hot_events)
+			lttng_channel_rank_events(chan_priv->pub);
+		if (chan_priv->packed_header) {
+			chan_priv->header_type = 3;	/* packed */
+		} else if (chan_priv->nr_hot_events) {
 			chan_priv->header_type = 1;	/* compact */
-		else
+		} else if (chan_priv->free_event_id < LTTNG_COMPACT_EVENT_NR_IDS) {
+			chan_priv->header_type = 1;	/* compact */
+		} else {
 			chan_priv->header_type = 2;	/* large */
+		}
+		lttng_channel_buffer_specialize(chan_priv->pub);
 	}
 
 	/* Clear each stream's quiescent state. */
@@ -504,8 +777,12 @@ int lttng_session_enable(struct lttng_kernel_session *session)
 		goto end;
 	}
 	ret = lttng_statedump_start(session);
-	if (ret)
+	if (ret) {
 		WRITE_ONCE(session->active, 0);
+		goto end;
+	}
+	list_for_each_entry(counter_snapshot, &session->priv->counter_snapshots, node)
+		lttng_counter_snapshot_timer_start(counter_snapshot);
 end:
 	mutex_unlock(&sessions_mutex);
 	return ret;
@@ -515,12 +792,16 @@ int lttng_session_disable(struct lttng_kernel_session *session)
 {
 	int ret = 0;
 	struct lttng_kernel_channel_buffer_private *chan_priv;
+	struct lttng_counter_snapshot_timer *counter_snapshot;
 
 	mutex_lock(&sessions_mutex);
 	if (!session->active) {
 		ret = -EBUSY;
 		goto end;
 	}
+	/* Record the last counter snapshots while the session is active. */
+	list_for_each_entry(counter_snapshot, &session->priv->counter_snapshots, node)
+		lttng_counter_snapshot_timer_stop(counter_snapshot);
 	WRITE_ONCE(session->active, 0);
 
 	/* Set transient enabler state to "disabled" */
@@ -543,7 +824,7 @@ int lttng_session_metadata_regenerate(struct lttng_kernel_session *session)
 	struct lttng_kernel_channel_buffer_private *chan_priv;
 	struct lttng_kernel_event_recorder_private *event_recorder_priv;
 	struct lttng_metadata_cache *cache = session->priv->metadata_cache;
-	struct lttng_metadata_stream *stream;
+	struct lttng_metadata_log *log, *old_log;
 
 	mutex_lock(&sessions_mutex);
 	if (!session->active) {
@@ -551,15 +832,24 @@ int lttng_session_metadata_regenerate(struct lttng_kernel_session *session)
 		goto end;
 	}
 
+	/*
+	 * Publish an empty log for the new metadata version. Readers notice
+	 * the version change and restart from the beginning of the new log.
+	 * The previous log is freed once no reader can be traversing it.
+	 */
+	log = lttng_metadata_log_create(0);
+	if (!log) {
+		ret = -ENOMEM;
+		goto end;
+	}
 	mutex_lock(&cache->lock);
-	memset(cache->data, 0, cache->cache_alloc);
+	old_log = lttng_metadata_cache_log(cache);
+	log->version = old_log->version + 1;
 	cache->metadata_written = 0;
-	cache->version++;
-	list_for_each_entry(stream, &session->priv->metadata_cache->metadata_stream, list) {
-		stream->metadata_out = 0;
-		stream->metadata_in = 0;
-	}
+	rcu_assign_pointer(cache->log, log);
 	mutex_unlock(&cache->lock);
+	synchronize_rcu();
+	lttng_metadata_log_destroy(old_log);
 
 	session->priv->metadata_dumped = 0;
 	list_for_each_entry(chan_priv, &session->priv->chan, node) {
@@ -577,6 +867,36 @@ end:
 	return ret;
 }
 
+/*
+ * The metadata format can only be changed before the session is first
+ * started, since both formats cannot coexist in a metadata stream.
+ */
+int lttng_session_set_metadata_format(struct lttng_kernel_session *session,
+		enum lttng_kernel_abi_metadata_format format)
+{
+	int ret = 0;
+
+	switch (format) {
+	case LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_1_8:
+	case LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2:
+		break;
+	default:
+		return -EINVAL;
+	}
+	mutex_lock(&sessions_mutex);
+	if (session->priv->been_active) {
+		ret = -EBUSY;
+		goto end;
+	}
+	session->priv->metadata_format = format;
+	mutex_lock(&session->priv->metadata_cache->lock);
+	session->priv->metadata_cache->format = format;
+	mutex_unlock(&session->priv->metadata_cache->lock);
+end:
+	mutex_unlock(&sessions_mutex);
+	return ret;
+}
+
 static
 bool is_channel_buffer_metadata(struct lttng_kernel_channel_common *channel)
 {
@@ -636,6 +956,102 @@ end:
 	return ret;
 }
 
+/*
+ * Hot events get the event ID matching their rank, so they fit in the
+ * compact event header. Other events, and hot events whose ID is already
+ * in use, are numbered after the compact IDs.
+ */
+static
+unsigned int lttng_channel_alloc_event_id(struct lttng_kernel_channel_buffer *chan,
+		const char *event_name)
+{
+	struct lttng_kernel_channel_buffer_private *chan_priv = chan->priv;
+	unsigned int i;
+
+	if (!chan_priv->nr_hot_events || !event_name)
+		return chan_priv->free_event_id++;
+	for (i = 0; i < chan_priv->nr_hot_events; i++) {
+		if (strcmp(chan_priv->hot_events[i], event_name))
+			continue;
+		if (test_and_set_bit(i, &chan_priv->hot_events_used))
+			break;
+		return i;
+	}
+	return chan_priv->free_event_id++;
+}
+
+/*
+ * Renumber the events of @chan according to the hot event ranking. Only
+ * done when the session is first started, before any event ID is used in
+ * the trace or its metadata. Event descriptions are complete at this
+ * point, so hints match the event names found in the metadata.
+ */
+static
+void lttng_channel_rank_events(struct lttng_kernel_channel_buffer *chan)
+{
+	struct lttng_kernel_event_recorder_private *event_recorder_priv;
+
+	chan->priv->free_event_id = LTTNG_COMPACT_EVENT_NR_IDS;
+	chan->priv->hot_events_used = 0;
+	/* In creation order. */
+	list_for_each_entry_reverse(event_recorder_priv,
+			&chan->parent.session->priv->events, parent.node) {
+		if (event_recorder_priv->pub->chan != chan)
+			continue;
+		event_recorder_priv->id = lttng_channel_alloc_event_id(chan,
+				event_recorder_priv->parent.desc->event_name);
+	}
+}
+
+/*
+ * Hint that @event_name is among the most frequent events of @chan. Hints
+ * are ranked in call order, and must be given before the session is first
+ * started.
+ */
+int lttng_channel_add_hot_event(struct lttng_kernel_channel_buffer *chan,
+		const char *event_name)
+{
+	struct lttng_kernel_channel_buffer_private *chan_priv = chan->priv;
+	struct lttng_kernel_session *session = chan->parent.session;
+	unsigned int i;
+	int ret = 0;
+
+	mutex_lock(&sessions_mutex);
+	if (chan_priv->channel_type == METADATA_CHANNEL) {
+		ret = -EPERM;
+		goto end;
+	}
+	if (session->priv->been_active) {
+		ret = -EBUSY;
+		goto end;
+	}
+	if (chan_priv->nr_hot_events == LTTNG_COMPACT_EVENT_NR_IDS) {
+		ret = -ENOSPC;
+		goto end;
+	}
+	for (i = 0; i < chan_priv->nr_hot_events; i++) {
+		if (!strcmp(chan_priv->hot_events[i], event_name)) {
+			ret = -EEXIST;
+			goto end;
+		}
+	}
+	if (!chan_priv->hot_events) {
+		chan_priv->hot_events = kcalloc(LTTNG_COMPACT_EVENT_NR_IDS,
+				sizeof(*chan_priv->hot_events), GFP_KERNEL);
+		if (!chan_priv->hot_events) {
+			ret = -ENOMEM;
+			goto end;
+		}
+	}
+	strncpy(chan_priv->hot_events[chan_priv->nr_hot_events], event_name,
+		LTTNG_KERNEL_ABI_SYM_NAME_LEN - 1);
+	chan_priv->hot_events[chan_priv->nr_hot_events][LTTNG_KERNEL_ABI_SYM_NAME_LEN - 1] = '\0';
+	chan_priv->nr_hot_events++;
+end:
+	mutex_unlock(&sessions_mutex);
+	return ret;
+}
+
 int lttng_event_enable(struct lttng_kernel_event_common *event)
 {
 	int ret = 0;
@@ -770,37 +1186,51 @@ struct lttng_kernel_channel_buffer *lttng_channel_buffer_create(struct lttng_ker
 				       size_t subbuf_size, size_t num_subbuf,
 				       unsigned int switch_timer_interval,
 				       unsigned int read_timer_interval,
+				       uint32_t flags,
 				       enum channel_type channel_type)
 {
 	struct lttng_kernel_channel_buffer *chan;
 	struct lttng_kernel_channel_buffer_private *chan_priv;
 	struct lttng_transport *transport = NULL;
+	int ret;
 
 	mutex_lock(&sessions_mutex);
-	if (session->priv->been_active && channel_type != METADATA_CHANNEL)
+	if (session->priv->been_active && channel_type != METADATA_CHANNEL) {
+		ret = -EINVAL;
 		goto active;	/* Refuse to add channel to active session */
+	}
 	transport = lttng_transport_find(transport_name);
 	if (!transport) {
 		printk(KERN_WARNING "LTTng: transport %s not found\n",
 		       transport_name);
+		ret = -EINVAL;
 		goto notransport;
 	}
 	if (!try_module_get(transport->owner)) {
 		printk(KERN_WARNING "LTTng: Can't lock transport module.\n");
+		ret = -EINVAL;
 		goto notransport;
 	}
 	chan = kzalloc(sizeof(struct lttng_kernel_channel_buffer), GFP_KERNEL);
-	if (!chan)
+	if (!chan) {
+		ret = -ENOMEM;
 		goto nomem;
+	}
 	chan_priv = kzalloc(sizeof(struct lttng_kernel_channel_buffer_private), GFP_KERNEL);
-	if (!chan_priv)
+	if (!chan_priv) {
+		ret = -ENOMEM;
 		goto nomem_priv;
+	}
 	chan->priv = chan_priv;
 	chan_priv->pub = chan;
 	chan->parent.type = LTTNG_KERNEL_CHANNEL_TYPE_BUFFER;
 	chan->parent.session = session;
 	chan->priv->id = session->priv->free_chan_id++;
 	chan->ops = &transport->ops;
+	chan->priv->snapshot_standby =
+		!!(flags & LTTNG_KERNEL_ABI_CHANNEL_FLAG_SNAPSHOT_STANDBY);
+	chan->priv->packed_header =
+		!!(flags & LTTNG_KERNEL_ABI_CHANNEL_FLAG_PACKED_HEADER);
 	/*
 	 * Note: the channel creation op already writes into the packet
 	 * headers. Therefore the "chan" information used as input
@@ -809,8 +1239,22 @@ struct lttng_kernel_channel_buffer *lttng_channel_buffer_create(struct lttng_ker
 	chan->priv->rb_chan = transport->ops.priv->channel_create(transport_name,
 			chan, buf_addr, subbuf_size, num_subbuf,
 			switch_timer_interval, read_timer_interval);
-	if (!chan->priv->rb_chan)
+	if (!chan->priv->rb_chan) {
+		ret = -EINVAL;
 		goto create_error;
+	}
+	if (flags & (LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_LZ4
+			| LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_ZSTD)) {
+		enum lttng_kernel_abi_compression format;
+
+		if (flags & LTTNG_KERNEL_ABI_CHANNEL_FLAG_COMPRESS_LZ4)
+			format = LTTNG_KERNEL_ABI_COMPRESSION_LZ4;
+		else
+			format = LTTNG_KERNEL_ABI_COMPRESSION_ZSTD;
+		ret = lttng_channel_compress_create(chan, format);
+		if (ret)
+			goto compress_error;
+	}
 	chan->priv->parent.tstate = 1;
 	chan->parent.enabled = 1;
 	chan->priv->transport = transport;
@@ -819,6 +1263,8 @@ struct lttng_kernel_channel_buffer *lttng_channel_buffer_create(struct lttng_ker
 	mutex_unlock(&sessions_mutex);
 	return chan;
 
+compress_error:
+	transport->ops.priv->channel_destroy(chan->priv->rb_chan);
 create_error:
 	kfree(chan_priv);
 nomem_priv:
@@ -829,7 +1275,7 @@ nomem:
 notransport:
 active:
 	mutex_unlock(&sessions_mutex);
-	return NULL;
+	return ERR_PTR(ret);
 }
 
 /*
@@ -841,9 +1287,11 @@ static
 void _lttng_channel_destroy(struct lttng_kernel_channel_buffer *chan)
 {
 	chan->ops->priv->channel_destroy(chan->priv->rb_chan);
+	lttng_channel_compress_destroy(chan->priv->compress);
 	module_put(chan->priv->transport->owner);
 	list_del(&chan->priv->node);
 	lttng_kernel_destroy_context(chan->priv->ctx);
+	kfree(chan->priv->hot_events);
 	kfree(chan->priv);
 	kfree(chan);
 }
@@ -859,6 +1307,23 @@ void lttng_metadata_channel_destroy(struct lttng_kernel_channel_buffer *chan)
 }
 EXPORT_SYMBOL_GPL(lttng_metadata_channel_destroy);
 
+/*
+ * Switch the channel to the fast path its transport specialized for the
+ * channel event header type and context, if any. Must be called once the
+ * header type is chosen and before the session is activated, since the
+ * context cannot change afterwards.
+ */
+void lttng_channel_buffer_specialize(struct lttng_kernel_channel_buffer *chan)
+{
+	struct lttng_kernel_channel_buffer_ops *ops;
+
+	if (!chan->ops->priv->select_ops)
+		return;
+	ops = chan->ops->priv->select_ops(chan);
+	if (ops)
+		WRITE_ONCE(chan->ops, ops);
+}
+
 static
 void _lttng_metadata_channel_hangup(struct lttng_metadata_stream *stream)
 {
@@ -909,7 +1374,8 @@ bool lttng_kernel_event_id_available(struct lttng_event_enabler_common *event_en
 }
 
 static
-struct lttng_kernel_event_common *lttng_kernel_event_alloc(struct lttng_event_enabler_common *event_enabler)
+struct lttng_kernel_event_common *lttng_kernel_event_alloc(struct lttng_event_enabler_common *event_enabler,
+		const char *event_name)
 {
 	struct lttng_kernel_abi_event *event_param = &event_enabler->event_param;
         enum lttng_kernel_abi_instrumentation itype = event_param->instrumentation;
@@ -943,7 +1409,7 @@ struct lttng_kernel_event_common *lttng_kernel_event_alloc(struct lttng_event_en
 		INIT_LIST_HEAD(&event_recorder->priv->parent.enablers_ref_head);
 
 		event_recorder->chan = chan;
-		event_recorder->priv->id = chan->priv->free_event_id++;
+		event_recorder->priv->id = lttng_channel_alloc_event_id(chan, event_name);
 		return &event_recorder->parent;
 	}
 	case LTTNG_EVENT_ENABLER_TYPE_NOTIFIER:
@@ -976,7 +1442,25 @@ struct lttng_kernel_event_common *lttng_kernel_event_alloc(struct lttng_event_en
 		event_notifier->priv->group = event_notifier_enabler->group;
 		event_notifier->priv->error_counter_index = event_notifier_enabler->error_counter_index;
 		event_notifier->priv->num_captures = 0;
-		event_notifier->notification_send = lttng_event_notifier_notification_send;
+		event_notifier->priv->action = event_notifier_enabler->action;
+		event_notifier->priv->counter = event_notifier_enabler->counter;
+		memcpy(event_notifier->priv->key_mode, event_notifier_enabler->key_mode,
+			sizeof(event_notifier->priv->key_mode));
+		switch (event_notifier_enabler->action) {
+		case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_COUNTER_INCREMENT:
+			event_notifier->notification_send = lttng_event_notifier_counter_increment;
+			break;
+		case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_START:
+			event_notifier->notification_send = lttng_event_notifier_timestamp_start;
+			break;
+		case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_STOP:
+			event_notifier->notification_send = lttng_event_notifier_timestamp_stop;
+			break;
+		case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_NOTIFY:
+		default:
+			event_notifier->notification_send = lttng_event_notifier_notification_send;
+			break;
+		}
 		INIT_LIST_HEAD(&event_notifier->priv->capture_bytecode_runtime_head);
 		return &event_notifier->parent;
 	}
@@ -1114,7 +1598,7 @@ struct lttng_kernel_event_common *_lttng_kernel_event_create(struct lttng_event_
 		}
 	}
 
-	event = lttng_kernel_event_alloc(event_enabler);
+	event = lttng_kernel_event_alloc(event_enabler, event_name);
 	if (!event) {
 		ret = -ENOMEM;
 		goto alloc_error;
@@ -1171,7 +1655,7 @@ struct lttng_kernel_event_common *_lttng_kernel_event_create(struct lttng_event_
 		event->enabled = 0;
 		event->priv->registered = 1;
 
-		event_return = lttng_kernel_event_alloc(event_enabler);
+		event_return = lttng_kernel_event_alloc(event_enabler, NULL);
 		if (!event) {
 			ret = -ENOMEM;
 			goto alloc_error;
@@ -1317,6 +1801,8 @@ int lttng_kernel_counter_read(struct lttng_counter *counter,
 		const size_t *dim_indexes, int32_t cpu,
 		int64_t *val, bool *overflow, bool *underflow)
 {
+	if (counter->sparse)
+		return -EINVAL;
 	return counter->ops->counter_read(counter->counter, dim_indexes,
 			cpu, val, overflow, underflow);
 }
@@ -1325,16 +1811,71 @@ int lttng_kernel_counter_aggregate(struct lttng_counter *counter,
 		const size_t *dim_indexes, int64_t *val,
 		bool *overflow, bool *underflow)
 {
+	if (counter->sparse)
+		return -EINVAL;
 	return counter->ops->counter_aggregate(counter->counter, dim_indexes,
 			val, overflow, underflow);
 }
 
+/* Sparse counters are cleared as a whole. */
 int lttng_kernel_counter_clear(struct lttng_counter *counter,
 		const size_t *dim_indexes)
 {
+	if (counter->sparse) {
+		lttng_sparse_counter_clear(counter->sparse);
+		return 0;
+	}
 	return counter->ops->counter_clear(counter->counter, dim_indexes);
 }
 
+int lttng_kernel_counter_get_slice(struct lttng_counter *counter,
+		size_t nr_indexes, const size_t *dim_indexes,
+		size_t *index, size_t *nr_elem)
+{
+	if (counter->sparse)
+		return -EINVAL;
+	return counter->ops->counter_get_slice(counter->counter, nr_indexes,
+			dim_indexes, index, nr_elem);
+}
+
+int lttng_kernel_counter_aggregate_range(struct lttng_counter *counter,
+		size_t index, size_t nr_elem, int64_t *values,
+		uint64_t *overflow_bitmap, uint64_t *underflow_bitmap)
+{
+	if (counter->sparse)
+		return -EINVAL;
+	return counter->ops->counter_aggregate_range(counter->counter, index,
+			nr_elem, values, overflow_bitmap, underflow_bitmap);
+}
+
+size_t lttng_kernel_counter_mmap_len(struct lttng_counter *counter)
+{
+	if (counter->sparse)
+		return 0;
+	return counter->ops->counter_mmap_len(counter->counter);
+}
+
+struct page *lttng_kernel_counter_get_page(struct lttng_counter *counter,
+		int cpu, unsigned long offset)
+{
+	if (counter->sparse)
+		return NULL;
+	return counter->ops->counter_get_page(counter->counter, cpu, offset);
+}
+
+int lttng_kernel_counter_sparse_read_next(struct lttng_counter *counter,
+		uint64_t *pos, uint64_t *key, int *cpu, int64_t *value)
+{
+	if (!counter->sparse)
+		return -EINVAL;
+	return lttng_sparse_counter_read_next(counter->sparse, pos, key, cpu, value);
+}
+
+int64_t lttng_kernel_counter_sparse_read_overflow(struct lttng_counter *counter)
+{
+	return lttng_sparse_counter_read_overflow(counter->sparse);
+}
+
 /* Only used for tracepoints and system calls for now. */
 static
 void register_event(struct lttng_kernel_event_common *event)
@@ -1507,6 +2048,10 @@ void _lttng_event_destroy(struct lttng_kernel_event_common *event)
 		default:
 			WARN_ON_ONCE(1);
 		}
+		if (event_recorder->rate) {
+			free_percpu(event_recorder->rate->state);
+			kfree(event_recorder->rate);
+		}
 		list_del(&event_recorder->priv->parent.node);
 		kmem_cache_free(event_recorder_private_cache, event_recorder->priv);
 		kmem_cache_free(event_recorder_cache, event_recorder);
@@ -1544,6 +2089,7 @@ void _lttng_event_destroy(struct lttng_kernel_event_common *event)
 		default:
 			WARN_ON_ONCE(1);
 		}
+		lttng_event_notifier_rate_destroy(event_notifier->priv->rate);
 		list_del(&event_notifier->priv->parent.node);
 		kmem_cache_free(event_notifier_private_cache, event_notifier->priv);
 		kmem_cache_free(event_notifier_cache, event_notifier);
@@ -2178,6 +2724,69 @@ void lttng_event_enabler_init_event_capture(struct lttng_event_enabler_common *e
 	}
 }
 
+/*
+ * The policy of the first enabler with a rate policy matching an event
+ * applies to it.
+ */
+static
+int lttng_event_enabler_init_event_rate(struct lttng_event_enabler_common *event_enabler,
+		struct lttng_kernel_event_common *event)
+{
+	switch (event_enabler->enabler_type) {
+	case LTTNG_EVENT_ENABLER_TYPE_RECORDER:
+	{
+		struct lttng_event_recorder_enabler *event_recorder_enabler =
+			container_of(event_enabler, struct lttng_event_recorder_enabler, parent);
+		struct lttng_kernel_event_recorder *event_recorder =
+			container_of(event, struct lttng_kernel_event_recorder, parent);
+		struct lttng_event_rate_policy *rate_policy = event_recorder_enabler->rate_policy;
+		struct lttng_kernel_event_rate *rate;
+
+		if (!rate_policy || event_recorder->rate)
+			return 0;
+		rate = kzalloc(sizeof(*rate), GFP_KERNEL);
+		if (!rate)
+			return -ENOMEM;
+		rate->state = alloc_percpu(struct lttng_kernel_event_rate_state);
+		if (!rate->state) {
+			kfree(rate);
+			return -ENOMEM;
+		}
+		rate->sample_period = rate_policy->sample_period;
+		rate->max_rate = rate_policy->max_rate;
+		if (rate_policy->suppressed_counter_file)
+			rate->suppressed_counter = rate_policy->suppressed_counter_file->private_data;
+		rate->suppressed_counter_index = rate_policy->suppressed_counter_index;
+		/* Publish the initialized rate to the probes. */
+		rcu_assign_pointer(event_recorder->rate, rate);
+		break;
+	}
+	case LTTNG_EVENT_ENABLER_TYPE_NOTIFIER:
+	{
+		struct lttng_event_notifier_enabler *event_notifier_enabler =
+			container_of(event_enabler, struct lttng_event_notifier_enabler, parent);
+		struct lttng_kernel_event_notifier *event_notifier =
+			container_of(event, struct lttng_kernel_event_notifier, parent);
+		struct lttng_event_notifier_rate_policy *rate_policy = event_notifier_enabler->rate_policy;
+		struct lttng_event_notifier_rate *rate;
+
+		if (!rate_policy || event_notifier->priv->rate)
+			return 0;
+		rate = kzalloc(sizeof(*rate), GFP_KERNEL);
+		if (!rate)
+			return -ENOMEM;
+		rate->policy = *rate_policy;
+		lttng_event_notifier_rate_init(rate, event_notifier);
+		/* Publish the initialized rate to the probes. */
+		rcu_assign_pointer(event_notifier->priv->rate, rate);
+		break;
+	}
+	default:
+		WARN_ON_ONCE(1);
+	}
+	return 0;
+}
+
 /*
  * Create events associated with an event_enabler (if not already present),
  * and add backward reference from the event to the enabler.
@@ -2188,6 +2797,7 @@ int lttng_event_enabler_ref_events(struct lttng_event_enabler_common *event_enab
 {
 	struct list_head *event_list_head = lttng_get_event_list_head_from_enabler(event_enabler);
 	struct lttng_kernel_event_common_private *event_priv;
+	int ret;
 
 	lttng_syscall_table_set_wildcard_all(event_enabler);
 
@@ -2218,6 +2828,9 @@ int lttng_event_enabler_ref_events(struct lttng_event_enabler_common *event_enab
 
 		lttng_event_enabler_init_event_filter(event_enabler, event);
 		lttng_event_enabler_init_event_capture(event_enabler, event);
+		ret = lttng_event_enabler_init_event_rate(event_enabler, event);
+		if (ret)
+			return ret;
 	}
 	return 0;
 }
@@ -2364,6 +2977,125 @@ error:
 	return ret;
 }
 
+/*
+ * Set the sampling and rate limit policy of the events of an enabler. Takes
+ * ownership of the @suppressed_counter_file reference on success. The
+ * policy of an enabler cannot be changed once set.
+ */
+int lttng_event_recorder_enabler_set_rate_policy(struct lttng_event_recorder_enabler *event_enabler,
+		const struct lttng_kernel_abi_event_rate_policy *rate_param,
+		struct file *suppressed_counter_file)
+{
+	struct lttng_event_rate_policy *rate_policy;
+	int ret = 0;
+
+	if (suppressed_counter_file) {
+		struct lttng_counter *counter = suppressed_counter_file->private_data;
+
+		if (counter->sparse || counter->nr_dimensions != 1
+				|| rate_param->suppressed_counter_index >= counter->dimension_sizes[0])
+			return -EINVAL;
+	}
+	rate_policy = kzalloc(sizeof(*rate_policy), GFP_KERNEL);
+	if (!rate_policy)
+		return -ENOMEM;
+	rate_policy->sample_period = rate_param->sample_period;
+	rate_policy->max_rate = rate_param->max_rate;
+	rate_policy->suppressed_counter_file = suppressed_counter_file;
+	rate_policy->suppressed_counter_index = rate_param->suppressed_counter_index;
+
+	mutex_lock(&sessions_mutex);
+	if (event_enabler->rate_policy) {
+		ret = -EBUSY;
+		goto end;
+	}
+	event_enabler->rate_policy = rate_policy;
+	lttng_event_enabler_sync(&event_enabler->parent);
+end:
+	mutex_unlock(&sessions_mutex);
+	if (ret)
+		kfree(rate_policy);
+	return ret;
+}
+
+/*
+ * Set the notification rate policy of the event notifiers of an enabler
+ * with the notify action. The policy of an enabler cannot be changed once
+ * set.
+ */
+int lttng_event_notifier_enabler_set_rate_policy(struct lttng_event_notifier_enabler *event_enabler,
+		const struct lttng_kernel_abi_event_notifier_rate_policy *rate_param)
+{
+	struct lttng_event_notifier_rate_policy *rate_policy;
+	int ret = 0;
+
+	if (event_enabler->action != LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_NOTIFY)
+		return -EINVAL;
+	rate_policy = kzalloc(sizeof(*rate_policy), GFP_KERNEL);
+	if (!rate_policy)
+		return -ENOMEM;
+	rate_policy->min_interval = rate_param->min_interval;
+	if (rate_param->bucket_rate) {
+		rate_policy->token_interval = max_t(uint64_t,
+				div_u64(NSEC_PER_SEC, rate_param->bucket_rate), 1);
+		rate_policy->bucket_depth = rate_policy->token_interval
+				* max_t(uint32_t, rate_param->bucket_burst, 1);
+	}
+	rate_policy->coalesce = rate_param->coalesce;
+	rate_policy->flush_delay = nsecs_to_jiffies(max3(rate_policy->min_interval,
+			rate_policy->token_interval,
+			(uint64_t) LTTNG_EVENT_NOTIFIER_RATE_FLUSH_DELAY));
+
+	mutex_lock(&sessions_mutex);
+	if (event_enabler->rate_policy) {
+		ret = -EBUSY;
+		goto end;
+	}
+	event_enabler->rate_policy = rate_policy;
+	lttng_event_enabler_sync(&event_enabler->parent);
+end:
+	mutex_unlock(&sessions_mutex);
+	if (ret)
+		kfree(rate_policy);
+	return ret;
+}
+
+/*
+ * Apply the sampling and rate limit of an event to its occurrence on the
+ * current cpu. Called from the probes with preemption disabled. Nested
+ * contexts interrupting a window reset may let a few more occurrences
+ * through.
+ */
+bool lttng_event_rate_accept(struct lttng_kernel_event_rate *rate)
+{
+	struct lttng_kernel_event_rate_state *state = this_cpu_ptr(rate->state);
+
+	if (rate->sample_period
+			&& (unsigned long) local_inc_return(&state->seen) % rate->sample_period)
+		goto suppressed;
+	if (rate->max_rate) {
+		unsigned long now = jiffies;
+
+		if (now - READ_ONCE(state->window_start) >= HZ) {
+			WRITE_ONCE(state->window_start, now);
+			local_set(&state->window_count, 0);
+		}
+		if ((unsigned long) local_inc_return(&state->window_count) > rate->max_rate)
+			goto suppressed;
+	}
+	return true;
+
+suppressed:
+	if (rate->suppressed_counter) {
+		struct lttng_counter *counter = rate->suppressed_counter;
+		size_t dimension_index[1] = { rate->suppressed_counter_index };
+
+		(void) counter->ops->counter_add(counter->counter, dimension_index, 1);
+	}
+	return false;
+}
+EXPORT_SYMBOL_GPL(lttng_event_rate_accept);
+
 int lttng_event_add_callsite(struct lttng_kernel_event_common *event,
 		struct lttng_kernel_abi_event_callsite __user *callsite)
 {
@@ -2400,6 +3132,11 @@ void lttng_event_enabler_destroy(struct lttng_event_enabler_common *event_enable
 		struct lttng_event_recorder_enabler *event_recorder_enabler =
 			container_of(event_enabler, struct lttng_event_recorder_enabler, parent);
 
+		if (event_recorder_enabler->rate_policy) {
+			if (event_recorder_enabler->rate_policy->suppressed_counter_file)
+				fput(event_recorder_enabler->rate_policy->suppressed_counter_file);
+			kfree(event_recorder_enabler->rate_policy);
+		}
 		kfree(event_recorder_enabler);
 		break;
 	}
@@ -2408,6 +3145,7 @@ void lttng_event_enabler_destroy(struct lttng_event_enabler_common *event_enable
 		struct lttng_event_notifier_enabler *event_notifier_enabler =
 			container_of(event_enabler, struct lttng_event_notifier_enabler, parent);
 
+		kfree(event_notifier_enabler->rate_policy);
 		kfree(event_notifier_enabler);
 		break;
 	}
@@ -2419,7 +3157,8 @@ void lttng_event_enabler_destroy(struct lttng_event_enabler_common *event_enable
 struct lttng_event_notifier_enabler *lttng_event_notifier_enabler_create(
 		enum lttng_enabler_format_type format_type,
 		struct lttng_kernel_abi_event_notifier *event_notifier_param,
-		struct lttng_event_notifier_group *event_notifier_group)
+		struct lttng_event_notifier_group *event_notifier_group,
+		struct lttng_counter *counter)
 {
 	struct lttng_event_notifier_enabler *event_notifier_enabler;
 
@@ -2434,6 +3173,10 @@ struct lttng_event_notifier_enabler *lttng_event_notifier_enabler_create(
 
 	event_notifier_enabler->error_counter_index = event_notifier_param->error_counter_index;
 	event_notifier_enabler->num_captures = 0;
+	event_notifier_enabler->action = event_notifier_param->action;
+	event_notifier_enabler->counter = counter;
+	memcpy(event_notifier_enabler->key_mode, event_notifier_param->key_mode,
+		sizeof(event_notifier_enabler->key_mode));
 
 	memcpy(&event_notifier_enabler->parent.event_param, &event_notifier_param->event,
 		sizeof(event_notifier_enabler->parent.event_param));
@@ -2488,6 +3231,30 @@ int lttng_event_notifier_enabler_attach_capture_bytecode(
 	if (ret)
 		return ret;
 
+	/*
+	 * Counter increment actions capture one key per dimension and a
+	 * value. Timestamp actions capture their pairing key, followed by
+	 * the keys of all dimensions but the latency for stop actions.
+	 */
+	switch (event_notifier_enabler->action) {
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_COUNTER_INCREMENT:
+		if (event_notifier_enabler->num_captures >
+				event_notifier_enabler->counter->nr_dimensions)
+			return -E2BIG;
+		break;
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_START:
+		if (event_notifier_enabler->num_captures >= 1)
+			return -E2BIG;
+		break;
+	case LTTNG_KERNEL_ABI_EVENT_NOTIFIER_ACTION_TIMESTAMP_STOP:
+		if (event_notifier_enabler->num_captures >=
+				event_notifier_enabler->counter->nr_dimensions)
+			return -E2BIG;
+		break;
+	default:
+		break;
+	}
+
 	bytecode_node = lttng_kvzalloc(sizeof(*bytecode_node) + bytecode_len,
 			GFP_KERNEL);
 	if (!bytecode_node)
@@ -2727,12 +3494,14 @@ void lttng_event_enabler_sync(struct lttng_event_enabler_common *event_enabler)
 /*
  * Serialize at most one packet worth of metadata into a metadata
  * channel.
- * We grab the metadata cache mutex to get exclusive access to our metadata
- * buffer and to the metadata cache. Exclusive access to the metadata buffer
+ * We grab the stream reader lock to get exclusive access to our metadata
+ * buffer and stream cursor. Exclusive access to the metadata buffer
  * allows us to do racy operations such as looking for remaining space left in
  * packet and write, since mutual exclusion protects us from concurrent writes.
- * Mutual exclusion on the metadata cache allow us to read the cache content
- * without racing against reallocation of the cache by updates.
+ * The metadata log is read without the metadata cache lock: only the
+ * bytes below its coherent watermark are read, and those are never
+ * modified. The RCU read-side critical section keeps the log alive
+ * against a concurrent regeneration.
  * Returns the number of bytes written in the channel, 0 if no data
  * was written and a negative value on error.
  */
@@ -2740,29 +3509,34 @@ int lttng_metadata_output_channel(struct lttng_metadata_stream *stream,
 		struct lttng_kernel_ring_buffer_channel *chan, bool *coherent)
 {
 	struct lttng_kernel_ring_buffer_ctx ctx;
+	struct lttng_metadata_log *log;
 	int ret = 0;
-	size_t len, reserve_len;
+	size_t len, reserve_len, remaining;
 
 	/*
 	 * Ensure we support mutiple get_next / put sequences followed by
-	 * put_next. The metadata cache lock protects reading the metadata
-	 * cache. It can indeed be read concurrently by "get_next_subbuf" and
-	 * "flush" operations on the buffer invoked by different processes.
-	 * Moreover, since the metadata cache memory can be reallocated, we
-	 * need to have exclusive access against updates even though we only
-	 * read it.
+	 * put_next. The stream lock protects the stream cursor, which can
+	 * indeed be used concurrently by "get_next_subbuf" and "flush"
+	 * operations on the buffer invoked by different processes.
 	 */
-	mutex_lock(&stream->metadata_cache->lock);
+	mutex_lock(&stream->lock);
+	rcu_read_lock();
+	log = rcu_dereference(stream->metadata_cache->log);
+
+	/* Metadata regenerated, change the version and restart from its start. */
+	if (log->version != stream->version) {
+		stream->version = log->version;
+		stream->metadata_in = 0;
+		stream->metadata_out = 0;
+		stream->chunk_in = NULL;
+	}
+
 	WARN_ON(stream->metadata_in < stream->metadata_out);
 	if (stream->metadata_in != stream->metadata_out)
 		goto end;
 
-	/* Metadata regenerated, change the version. */
-	if (stream->metadata_cache->version != stream->version)
-		stream->version = stream->metadata_cache->version;
-
-	len = stream->metadata_cache->metadata_written -
-		stream->metadata_in;
+	/* Pairs with the release in lttng_metadata_end(). */
+	len = smp_load_acquire(&log->coherent) - stream->metadata_in;
 	if (!len)
 		goto end;
 	reserve_len = min_t(size_t,
@@ -2779,9 +3553,32 @@ int lttng_metadata_output_channel(struct lttng_metadata_stream *stream,
 		stream->coherent = false;
 		goto end;
 	}
-	stream->transport->ops.event_write(&ctx,
-			stream->metadata_cache->data + stream->metadata_in,
-			reserve_len, 1);
+	if (!stream->chunk_in) {
+		stream->chunk_in = list_first_entry(&log->chunks,
+				struct lttng_metadata_cache_chunk, node);
+		stream->chunk_in_offset = 0;
+	}
+	for (remaining = reserve_len; remaining; ) {
+		struct lttng_metadata_cache_chunk *chunk = stream->chunk_in;
+		size_t copy_len;
+
+		/*
+		 * The tail chunk may be growing concurrently, but never
+		 * past the published bytes we are about to read.
+		 */
+		copy_len = min_t(size_t, remaining,
+				READ_ONCE(chunk->len) - stream->chunk_in_offset);
+		if (!copy_len) {
+			stream->chunk_in = list_next_entry(chunk, node);
+			stream->chunk_in_offset = 0;
+			continue;
+		}
+		stream->transport->ops.event_write(&ctx,
+				chunk->data + stream->chunk_in_offset,
+				copy_len, 1);
+		stream->chunk_in_offset += copy_len;
+		remaining -= copy_len;
+	}
 	stream->transport->ops.event_commit(&ctx);
 	stream->metadata_in += reserve_len;
 	if (reserve_len < len)
@@ -2793,7 +3590,8 @@ int lttng_metadata_output_channel(struct lttng_metadata_stream *stream,
 end:
 	if (coherent)
 		*coherent = stream->coherent;
-	mutex_unlock(&stream->metadata_cache->lock);
+	rcu_read_unlock();
+	mutex_unlock(&stream->lock);
 	return ret;
 }
 
@@ -2809,71 +3607,235 @@ void lttng_metadata_end(struct lttng_kernel_session *session)
 {
 	WARN_ON_ONCE(!atomic_read(&session->priv->metadata_cache->producing));
 	if (atomic_dec_return(&session->priv->metadata_cache->producing) == 0) {
+		struct lttng_metadata_cache *cache = session->priv->metadata_cache;
 		struct lttng_metadata_stream *stream;
 
+		/* Publish the complete transaction to readers. */
+		smp_store_release(&lttng_metadata_cache_log(cache)->coherent,
+				cache->metadata_written);
 		list_for_each_entry(stream, &session->priv->metadata_cache->metadata_stream, list)
 			wake_up_interruptible(&stream->read_wait);
 		mutex_unlock(&session->priv->metadata_cache->lock);
 	}
 }
 
+/*
+ * Append @len bytes of @str to the metadata cache, spreading them over the
+ * end of the tail chunk and as many new chunks as needed. All chunks are
+ * allocated before anything is appended, so a failure leaves the cache
+ * unchanged.
+ */
+static
+int lttng_metadata_cache_append(struct lttng_metadata_cache *cache,
+		const char *str, size_t len)
+{
+	struct lttng_metadata_log *log = lttng_metadata_cache_log(cache);
+	struct lttng_metadata_cache_chunk *tail, *chunk, *tmp;
+	size_t copy_len;
+	LIST_HEAD(new_chunks);
+
+	tail = list_last_entry(&log->chunks, struct lttng_metadata_cache_chunk, node);
+	copy_len = min_t(size_t, len, LTTNG_METADATA_CACHE_CHUNK_DATA_SIZE - tail->len);
+	for (; copy_len < len; copy_len += LTTNG_METADATA_CACHE_CHUNK_DATA_SIZE) {
+		chunk = lttng_metadata_cache_chunk_alloc();
+		if (!chunk)
+			goto err;
+		list_add_tail(&chunk->node, &new_chunks);
+	}
+	list_splice_tail(&new_chunks, &log->chunks);
+	for (chunk = tail; len; chunk = list_next_entry(chunk, node)) {
+		copy_len = min_t(size_t, len,
+				LTTNG_METADATA_CACHE_CHUNK_DATA_SIZE - chunk->len);
+		memcpy(chunk->data + chunk->len, str, copy_len);
+		WRITE_ONCE(chunk->len, chunk->len + copy_len);
+		cache->metadata_written += copy_len;
+		str += copy_len;
+		len -= copy_len;
+	}
+	return 0;
+
+err:
+	list_for_each_entry_safe(chunk, tmp, &new_chunks, node)
+		kfree(chunk);
+	return -ENOMEM;
+}
+
 /*
  * Write the metadata to the metadata cache.
  * Must be called with sessions_mutex held.
- * The metadata cache lock protects us from concurrent read access from
- * thread outputting metadata content to ring buffer.
- * The content of the printf is printed as a single atomic metadata
- * transaction.
+ * The metadata cache lock serializes producers. Readers outputting
+ * metadata content to ring buffer only see the content once the metadata
+ * transaction is published by lttng_metadata_end().
+ *
+ * The fragment is formatted in place at the end of the tail chunk. If it
+ * does not fit, it is formatted again at the start of a new chunk, and
+ * only fragments larger than a chunk go through a temporary string.
  */
 int lttng_metadata_printf(struct lttng_kernel_session *session,
 			  const char *fmt, ...)
 {
+	struct lttng_metadata_cache *cache = session->priv->metadata_cache;
+	struct lttng_metadata_log *log;
+	struct lttng_metadata_cache_chunk *tail;
+	size_t avail, len;
 	char *str;
-	size_t len;
 	va_list ap;
+	int ret;
 
 	WARN_ON_ONCE(!LTTNG_READ_ONCE(session->active));
+	WARN_ON_ONCE(!atomic_read(&cache->producing));
+
+	log = lttng_metadata_cache_log(cache);
+	tail = list_last_entry(&log->chunks, struct lttng_metadata_cache_chunk, node);
+	avail = LTTNG_METADATA_CACHE_CHUNK_DATA_SIZE - tail->len;
+	va_start(ap, fmt);
+	len = vsnprintf(tail->data + tail->len, avail, fmt, ap);
+	va_end(ap);
+	if (len < avail) {
+		WRITE_ONCE(tail->len, tail->len + len);
+		cache->metadata_written += len;
+		return 0;
+	}
+	if (len < LTTNG_METADATA_CACHE_CHUNK_DATA_SIZE) {
+		tail = lttng_metadata_cache_chunk_alloc();
+		if (!tail)
+			return -ENOMEM;
+		va_start(ap, fmt);
+		tail->len = vsnprintf(tail->data, LTTNG_METADATA_CACHE_CHUNK_DATA_SIZE,
+				fmt, ap);
+		va_end(ap);
+		list_add_tail(&tail->node, &log->chunks);
+		cache->metadata_written += tail->len;
+		return 0;
+	}
 
 	va_start(ap, fmt);
 	str = kvasprintf(GFP_KERNEL, fmt, ap);
 	va_end(ap);
 	if (!str)
 		return -ENOMEM;
+	ret = lttng_metadata_cache_append(cache, str, len);
+	kfree(str);
+	return ret;
+}
 
-	len = strlen(str);
-	WARN_ON_ONCE(!atomic_read(&session->priv->metadata_cache->producing));
-	if (session->priv->metadata_cache->metadata_written + len >
-			session->priv->metadata_cache->cache_alloc) {
-		char *tmp_cache_realloc;
-		unsigned int tmp_cache_alloc_size;
-
-		tmp_cache_alloc_size = max_t(unsigned int,
-				session->priv->metadata_cache->cache_alloc + len,
-				session->priv->metadata_cache->cache_alloc << 1);
-		tmp_cache_realloc = vzalloc(tmp_cache_alloc_size);
-		if (!tmp_cache_realloc)
-			goto err;
-		if (session->priv->metadata_cache->data) {
-			memcpy(tmp_cache_realloc,
-				session->priv->metadata_cache->data,
-				session->priv->metadata_cache->cache_alloc);
-			vfree(session->priv->metadata_cache->data);
-		}
+/*
+ * Rendered metadata fragments are shared across sessions. The text of
+ * the fields of an event, and of an enumeration type, only depends on
+ * their descriptors and nesting level, so it is rendered once and copied
+ * into the metadata cache of every later session. Fragments are keyed by
+ * descriptor pointer, so they are only kept for descriptors owned by a
+ * probe, and dropped when that probe is unregistered.
+ *
+ * Protected by sessions_mutex.
+ */
+#define LTTNG_METADATA_FRAGMENT_HT_BITS		10
+#define LTTNG_METADATA_FRAGMENT_HT_SIZE		(1U << LTTNG_METADATA_FRAGMENT_HT_BITS)
+
+struct lttng_metadata_fragment {
+	struct hlist_node hlist;
+	enum lttng_kernel_abi_metadata_format format;
+	const void *desc;		/* Event or enumeration descriptor */
+	const void *type;		/* Enumeration container type, or NULL */
+	size_t nesting;
+	const struct lttng_kernel_probe_desc *probe_desc;	/* Owner */
+	size_t len;
+	char data[];
+};
+
+static struct hlist_head metadata_fragments[LTTNG_METADATA_FRAGMENT_HT_SIZE];
+
+static
+struct hlist_head *lttng_metadata_fragment_head(const void *desc, size_t nesting)
+{
+	return &metadata_fragments[hash_ptr((const char *) desc + nesting,
+			LTTNG_METADATA_FRAGMENT_HT_BITS)];
+}
+
+struct lttng_metadata_fragment *lttng_metadata_fragment_lookup(
+		enum lttng_kernel_abi_metadata_format format,
+		const void *desc, const void *type, size_t nesting)
+{
+	struct lttng_metadata_fragment *frag;
 
-		session->priv->metadata_cache->cache_alloc = tmp_cache_alloc_size;
-		session->priv->metadata_cache->data = tmp_cache_realloc;
+	hlist_for_each_entry(frag, lttng_metadata_fragment_head(desc, nesting), hlist) {
+		if (frag->format == format && frag->desc == desc
+				&& frag->type == type && frag->nesting == nesting)
+			return frag;
 	}
-	memcpy(session->priv->metadata_cache->data +
-			session->priv->metadata_cache->metadata_written,
-			str, len);
-	session->priv->metadata_cache->metadata_written += len;
-	kfree(str);
+	return NULL;
+}
 
-	return 0;
+int lttng_metadata_fragment_print(struct lttng_kernel_session *session,
+		const struct lttng_metadata_fragment *frag)
+{
+	return lttng_metadata_cache_append(session->priv->metadata_cache,
+			frag->data, frag->len);
+}
 
-err:
-	kfree(str);
-	return -ENOMEM;
+/*
+ * Keep the last @len bytes written to the session metadata cache as the
+ * fragment of @desc. Failure to allocate the fragment is not an error:
+ * the next session renders the metadata again.
+ */
+void lttng_metadata_fragment_add(struct lttng_kernel_session *session,
+		enum lttng_kernel_abi_metadata_format format,
+		const void *desc, const void *type, size_t nesting,
+		const struct lttng_kernel_probe_desc *probe_desc, size_t len)
+{
+	struct lttng_metadata_cache *cache = session->priv->metadata_cache;
+	struct lttng_metadata_cache_chunk *chunk;
+	struct lttng_metadata_fragment *frag;
+	size_t offset, copy_len, pos = 0;
+
+	if (!probe_desc)
+		return;
+	frag = lttng_kvmalloc(sizeof(*frag) + len, GFP_KERNEL);
+	if (!frag)
+		return;
+	frag->format = format;
+	frag->desc = desc;
+	frag->type = type;
+	frag->nesting = nesting;
+	frag->probe_desc = probe_desc;
+	frag->len = len;
+	/* Find the chunk where the fragment starts, walking back from the tail. */
+	chunk = list_last_entry(&lttng_metadata_cache_log(cache)->chunks,
+			struct lttng_metadata_cache_chunk, node);
+	offset = len;
+	while (chunk->len < offset) {
+		offset -= chunk->len;
+		chunk = list_prev_entry(chunk, node);
+	}
+	offset = chunk->len - offset;
+	while (pos < len) {
+		copy_len = min_t(size_t, len - pos, chunk->len - offset);
+		memcpy(frag->data + pos, chunk->data + offset, copy_len);
+		pos += copy_len;
+		offset = 0;
+		chunk = list_next_entry(chunk, node);
+	}
+	hlist_add_head(&frag->hlist, lttng_metadata_fragment_head(desc, nesting));
+}
+
+/*
+ * Drop the fragments owned by @probe_desc, or all fragments if NULL.
+ * Called with sessions_mutex held.
+ */
+void lttng_metadata_fragments_invalidate(const struct lttng_kernel_probe_desc *probe_desc)
+{
+	struct lttng_metadata_fragment *frag;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	for (i = 0; i < LTTNG_METADATA_FRAGMENT_HT_SIZE; i++) {
+		hlist_for_each_entry_safe(frag, tmp, &metadata_fragments[i], hlist) {
+			if (probe_desc && frag->probe_desc != probe_desc)
+				continue;
+			hlist_del(&frag->hlist);
+			lttng_kvfree(frag);
+		}
+	}
 }
 
 static
@@ -3178,10 +4140,12 @@ int _lttng_enum_type_statedump(struct lttng_kernel_session *session,
 		const struct lttng_kernel_type_enum *type,
 		size_t nesting)
 {
+	struct lttng_metadata_cache *cache = session->priv->metadata_cache;
 	const struct lttng_kernel_enum_desc *enum_desc;
 	const struct lttng_kernel_type_common *container_type;
+	struct lttng_metadata_fragment *frag;
+	unsigned int i, nr_entries, start;
 	int ret;
-	unsigned int i, nr_entries;
 
 	container_type = type->container_type;
 	if (container_type->type != lttng_kernel_type_integer) {
@@ -3191,6 +4155,12 @@ int _lttng_enum_type_statedump(struct lttng_kernel_session *session,
 	enum_desc = type->desc;
 	nr_entries = enum_desc->nr_entries;
 
+	frag = lttng_metadata_fragment_lookup(LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_1_8,
+			enum_desc, container_type, nesting);
+	if (frag)
+		return lttng_metadata_fragment_print(session, frag);
+	start = cache->metadata_written;
+
 	ret = print_tabs(session, nesting);
 	if (ret)
 		goto end;
@@ -3283,6 +4253,11 @@ int _lttng_enum_type_statedump(struct lttng_kernel_session *session,
 	if (ret)
 		goto end;
 	ret = lttng_metadata_printf(session, "}");
+	if (ret)
+		goto end;
+	lttng_metadata_fragment_add(session, LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_1_8,
+			enum_desc, container_type, nesting,
+			enum_desc->probe_desc, cache->metadata_written - start);
 end:
 	return ret;
 }
@@ -3472,11 +4447,19 @@ static
 int _lttng_fields_metadata_statedump(struct lttng_kernel_session *session,
 				   struct lttng_kernel_event_recorder *event_recorder)
 {
+	struct lttng_metadata_cache *cache = session->priv->metadata_cache;
 	const char *prev_field_name = NULL;
 	const struct lttng_kernel_event_desc *desc = event_recorder->priv->parent.desc;
+	struct lttng_metadata_fragment *frag;
+	unsigned int start;
 	int ret = 0;
 	int i;
 
+	frag = lttng_metadata_fragment_lookup(LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_1_8,
+			desc, NULL, 2);
+	if (frag)
+		return lttng_metadata_fragment_print(session, frag);
+	start = cache->metadata_written;
 	for (i = 0; i < desc->tp_class->nr_fields; i++) {
 		const struct lttng_kernel_event_field *field = desc->tp_class->fields[i];
 
@@ -3484,6 +4467,9 @@ int _lttng_fields_metadata_statedump(struct lttng_kernel_session *session,
 		if (ret)
 			return ret;
 	}
+	lttng_metadata_fragment_add(session, LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_1_8,
+			desc, NULL, 2, desc->probe_desc,
+			cache->metadata_written - start);
 	return ret;
 }
 
@@ -3513,6 +4499,13 @@ int _lttng_event_recorder_metadata_statedump(struct lttng_kernel_event_common *e
 
 	lttng_metadata_begin(session);
 
+	if (session->priv->metadata_format == LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2) {
+		ret = lttng_metadata_ctf2_event_recorder_statedump(session, event_recorder);
+		if (ret)
+			goto end;
+		goto dumped;
+	}
+
 	ret = lttng_metadata_printf(session,
 		"event {\n"
 		"	name = \"%s\";\n"
@@ -3544,6 +4537,7 @@ int _lttng_event_recorder_metadata_statedump(struct lttng_kernel_event_common *e
 	if (ret)
 		goto end;
 
+dumped:
 	event_recorder->priv->metadata_dumped = 1;
 end:
 	lttng_metadata_end(session);
@@ -3571,6 +4565,13 @@ int _lttng_channel_metadata_statedump(struct lttng_kernel_session *session,
 	lttng_metadata_begin(session);
 
 	WARN_ON_ONCE(!chan->priv->header_type);
+	if (session->priv->metadata_format == LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2) {
+		ret = lttng_metadata_ctf2_channel_statedump(session, chan);
+		if (ret)
+			goto end;
+		goto dumped;
+	}
+
 	ret = lttng_metadata_printf(session,
 		"stream {\n"
 		"	id = %u;\n"
@@ -3578,6 +4579,7 @@ int _lttng_channel_metadata_statedump(struct lttng_kernel_session *session,
 		"	packet.context := struct packet_context;\n",
 		chan->priv->id,
 		chan->priv->header_type == 1 ? "struct event_header_compact" :
+			chan->priv->header_type == 3 ? "struct event_header_packed" :
 			"struct event_header_large");
 	if (ret)
 		goto end;
@@ -3600,7 +4602,10 @@ int _lttng_channel_metadata_statedump(struct lttng_kernel_session *session,
 
 	ret = lttng_metadata_printf(session,
 		"};\n\n");
+	if (ret)
+		goto end;
 
+dumped:
 	chan->priv->metadata_dumped = 1;
 end:
 	lttng_metadata_end(session);
@@ -3635,6 +4640,13 @@ int _lttng_stream_packet_context_declare(struct lttng_kernel_session *session)
  * id: range: 0 - 65534.
  * id 65535 is reserved to indicate an extended header.
  *
+ * Packed header:
+ * id: range: 0 - 30.
+ * id 31 is reserved to indicate an extended header.
+ * The header is byte-aligned. Its timestamp only holds as many low-order
+ * bytes of the clock value as needed to express the delta from the
+ * previous event, as given by timestamp_len.
+ *
  * Must be called with sessions_mutex held.
  */
 static
@@ -3665,7 +4677,31 @@ int _lttng_event_header_declare(struct lttng_kernel_session *session)
 	"			uint64_clock_monotonic_t timestamp;\n"
 	"		} extended;\n"
 	"	} v;\n"
-	"} align(%u);\n\n",
+	"} align(%u);\n"
+	"\n"
+	"struct event_header_packed {\n"
+	"	enum : uint5_t { compact = 0 ... 30, extended = 31 } id;\n"
+	"	enum : integer { size = 3; align = 1; signed = false; } {\n"
+	"		ts8 = 0, ts16 = 1, ts24 = 2, ts32 = 3,\n"
+	"		ts40 = 4, ts48 = 5, ts56 = 6, ts64 = 7\n"
+	"	} timestamp_len;\n"
+	"	variant <id> {\n"
+	"		struct { } compact;\n"
+	"		struct {\n"
+	"			integer { size = 32; align = 8; signed = false; } id;\n"
+	"		} extended;\n"
+	"	} v;\n"
+	"	variant <timestamp_len> {\n"
+	"		uint8_clock_monotonic_packed_t ts8;\n"
+	"		uint16_clock_monotonic_packed_t ts16;\n"
+	"		uint24_clock_monotonic_packed_t ts24;\n"
+	"		uint32_clock_monotonic_packed_t ts32;\n"
+	"		uint40_clock_monotonic_packed_t ts40;\n"
+	"		uint48_clock_monotonic_packed_t ts48;\n"
+	"		uint56_clock_monotonic_packed_t ts56;\n"
+	"		uint64_clock_monotonic_packed_t ts64;\n"
+	"	} timestamp;\n"
+	"} align(8);\n\n",
 	lttng_alignof(uint32_t) * CHAR_BIT,
 	lttng_alignof(uint16_t) * CHAR_BIT
 	);
@@ -3787,6 +4823,7 @@ int _lttng_session_metadata_statedump(struct lttng_kernel_session *session)
 	const char *product_uuid;
 	struct lttng_kernel_channel_buffer_private *chan_priv;
 	struct lttng_kernel_event_recorder_private *event_recorder_priv;
+	unsigned int i;
 	int ret = 0;
 
 	if (!LTTNG_READ_ONCE(session->active))
@@ -3797,6 +4834,14 @@ int _lttng_session_metadata_statedump(struct lttng_kernel_session *session)
 	if (session->priv->metadata_dumped)
 		goto skip_session;
 
+	if (session->priv->metadata_format == LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2) {
+		ret = lttng_metadata_ctf2_session_statedump(session,
+				measure_clock_offset());
+		if (ret)
+			goto end;
+		goto skip_session;
+	}
+
 	snprintf(uuid_s, sizeof(uuid_s),
 		"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
 		uuid_c[0], uuid_c[1], uuid_c[2], uuid_c[3],
@@ -3944,6 +4989,21 @@ int _lttng_session_metadata_statedump(struct lttng_kernel_session *session)
 	if (ret)
 		goto end;
 
+	/* Byte-aligned clock values of the packed event header. */
+	for (i = 1; i <= sizeof(uint64_t); i++) {
+		ret = lttng_metadata_printf(session,
+			"typealias integer {\n"
+			"	size = %u; align = 8; signed = false;\n"
+			"	map = clock.%s.value;\n"
+			"} := uint%u_clock_monotonic_packed_t;\n\n",
+			i * CHAR_BIT,
+			trace_clock_name(),
+			i * CHAR_BIT
+			);
+		if (ret)
+			goto end;
+	}
+
 	ret = _lttng_stream_packet_context_declare(session);
 	if (ret)
 		goto end;
@@ -4051,6 +5111,8 @@ static int lttng_hotplug_prepare(unsigned int cpu, struct hlist_node *node)
 		return 0;
 	case LTTNG_CONTEXT_PERF_COUNTERS:
 		return 0;
+	case LTTNG_COUNTER:
+		return lttng_cpuhp_counter_prepare(cpu, lttng_node);
 	default:
 		return -EINVAL;
 	}
@@ -4070,6 +5132,8 @@ static int lttng_hotplug_dead(unsigned int cpu, struct hlist_node *node)
 		return 0;
 	case LTTNG_CONTEXT_PERF_COUNTERS:
 		return lttng_cpuhp_perf_counter_dead(cpu, lttng_node);
+	case LTTNG_COUNTER:
+		return lttng_cpuhp_counter_dead(cpu, lttng_node);
 	default:
 		return -EINVAL;
 	}
@@ -4089,6 +5153,8 @@ static int lttng_hotplug_online(unsigned int cpu, struct hlist_node *node)
 		return lttng_cpuhp_rb_iter_online(cpu, lttng_node);
 	case LTTNG_CONTEXT_PERF_COUNTERS:
 		return lttng_cpuhp_perf_counter_online(cpu, lttng_node);
+	case LTTNG_COUNTER:
+		return 0;
 	default:
 		return -EINVAL;
 	}
@@ -4108,6 +5174,8 @@ static int lttng_hotplug_offline(unsigned int cpu, struct hlist_node *node)
 		return 0;
 	case LTTNG_CONTEXT_PERF_COUNTERS:
 		return 0;
+	case LTTNG_COUNTER:
+		return 0;
 	default:
 		return -EINVAL;
 	}
@@ -4125,11 +5193,13 @@ static int __init lttng_init_cpu_hotplug(void)
 	}
 	lttng_hp_prepare = ret;
 	lttng_rb_set_hp_prepare(ret);
+	lttng_counter_set_hp_prepare(ret);
 
 	ret = cpuhp_setup_state_multi(CPUHP_AP_ONLINE_DYN, "lttng:online",
 			lttng_hotplug_online,
 			lttng_hotplug_offline);
 	if (ret < 0) {
+		lttng_counter_set_hp_prepare(0);
 		cpuhp_remove_multi_state(lttng_hp_prepare);
 		lttng_hp_prepare = 0;
 		return ret;
@@ -4144,6 +5214,7 @@ static void __exit lttng_exit_cpu_hotplug(void)
 {
 	lttng_rb_set_hp_online(0);
 	cpuhp_remove_multi_state(lttng_hp_online);
+	lttng_counter_set_hp_prepare(0);
 	lttng_rb_set_hp_prepare(0);
 	cpuhp_remove_multi_state(lttng_hp_prepare);
 }
@@ -4280,6 +5351,7 @@ static void __exit lttng_events_exit(void)
 	kmem_cache_destroy(event_recorder_private_cache);
 	kmem_cache_destroy(event_notifier_cache);
 	kmem_cache_destroy(event_notifier_private_cache);
+	lttng_metadata_fragments_invalidate(NULL);
 	lttng_tracepoint_exit();
 	lttng_context_exit();
 	printk(KERN_NOTICE "LTTng: Unloaded modules v%s.%s.%s%s (%s)%s%s\n",
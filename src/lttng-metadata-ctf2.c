@@ -0,0 +1,1013 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-metadata-ctf2.c
+ *
+ * LTTng CTF 2 metadata generator. Emits the session metadata as a JSON
+ * text sequence of CTF 2 fragments, through the same metadata cache and
+ * metadata channel as the CTF 1.8 TSDL metadata.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/utsname.h>
+#include <linux/dmi.h>
+#include <linux/sched.h>
+#include <linux/nsproxy.h>
+
+#include <wrapper/random.h>
+#include <wrapper/trace-clock.h>
+#include <lttng/events.h>
+#include <lttng/events-internal.h>
+#include <lttng/endian.h>
+#include <lttng/tracer.h>
+
+/* Each fragment of a JSON text sequence starts with a record separator. */
+#define CTF2_RS			"\x1e"
+
+/* Largest structure nesting depth of a field location path. */
+#define CTF2_MAX_PATH_DEPTH	16
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+#define CTF2_NATIVE_BYTE_ORDER		"big-endian"
+#define CTF2_REVERSE_BYTE_ORDER		"little-endian"
+#else
+#define CTF2_NATIVE_BYTE_ORDER		"little-endian"
+#define CTF2_REVERSE_BYTE_ORDER		"big-endian"
+#endif
+
+/*
+ * Scope of the field classes being printed, used to express the
+ * locations of sequence length and variant selector fields. Those fields
+ * are siblings of the field which refers to them.
+ */
+struct ctf2_scope {
+	const char *origin;			/* Root scope of field locations */
+	const char *path[CTF2_MAX_PATH_DEPTH];	/* Names of enclosing members */
+	unsigned int depth;
+	const struct lttng_kernel_event_field * const *fields;	/* Siblings, or NULL */
+	unsigned int nr_fields;
+};
+
+static
+int ctf2_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_common *type,
+		enum lttng_kernel_string_encoding parent_encoding,
+		struct ctf2_scope *scope, const char *prev_field_name);
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_string_statedump(struct lttng_kernel_session *session, const char *string)
+{
+	const char *p;
+	int ret;
+
+	ret = lttng_metadata_printf(session, "\"");
+	if (ret)
+		return ret;
+	for (p = string; *p != '\0'; p++) {
+		unsigned char c = *p;
+
+		switch (c) {
+		case '"':
+			ret = lttng_metadata_printf(session, "\\\"");
+			break;
+		case '\\':
+			ret = lttng_metadata_printf(session, "\\\\");
+			break;
+		case '\n':
+			ret = lttng_metadata_printf(session, "\\n");
+			break;
+		case '\t':
+			ret = lttng_metadata_printf(session, "\\t");
+			break;
+		default:
+			if (c < 0x20)
+				ret = lttng_metadata_printf(session, "\\u%04x", c);
+			else
+				ret = lttng_metadata_printf(session, "%c", c);
+			break;
+		}
+		if (ret)
+			return ret;
+	}
+	return lttng_metadata_printf(session, "\"");
+}
+
+static
+int ctf2_enum_value_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_enum_value *value)
+{
+	if (value->signedness)
+		return lttng_metadata_printf(session, "%lld", (long long) value->value);
+	else
+		return lttng_metadata_printf(session, "%llu", value->value);
+}
+
+/*
+ * Get the range of @entry. Automatic entries follow the end of the
+ * previous entry, tracked in @next, like in CTF 1.8 enumerations.
+ */
+static
+void ctf2_enum_entry_range(const struct lttng_kernel_enum_entry *entry,
+		struct lttng_kernel_enum_value *next,
+		struct lttng_kernel_enum_value *start,
+		struct lttng_kernel_enum_value *end)
+{
+	if (entry->options.is_auto) {
+		*start = *next;
+		*end = *next;
+	} else {
+		*start = entry->start;
+		*end = entry->end;
+	}
+	next->value = end->value + 1;
+	next->signedness = end->signedness;
+}
+
+/*
+ * Print the ranges of all the entries of @enum_desc labeled @label, as a
+ * JSON integer range set.
+ */
+static
+int ctf2_enum_label_ranges_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_enum_desc *enum_desc, const char *label)
+{
+	struct lttng_kernel_enum_value next = { 0 }, start, end;
+	bool first = true;
+	unsigned int i;
+	int ret;
+
+	ret = lttng_metadata_printf(session, "[");
+	if (ret)
+		return ret;
+	for (i = 0; i < enum_desc->nr_entries; i++) {
+		const struct lttng_kernel_enum_entry *entry = enum_desc->entries[i];
+
+		ctf2_enum_entry_range(entry, &next, &start, &end);
+		if (strcmp(entry->string, label))
+			continue;
+		ret = lttng_metadata_printf(session, "%s[", first ? "" : ",");
+		if (ret)
+			return ret;
+		ret = ctf2_enum_value_statedump(session, &start);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_printf(session, ",");
+		if (ret)
+			return ret;
+		ret = ctf2_enum_value_statedump(session, &end);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_printf(session, "]");
+		if (ret)
+			return ret;
+		first = false;
+	}
+	return lttng_metadata_printf(session, "]");
+}
+
+static
+int ctf2_integer_properties_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_integer *type)
+{
+	return lttng_metadata_printf(session,
+		"\"length\":%u,\"byte-order\":\"%s\",\"alignment\":%u,"
+		"\"preferred-display-base\":%u",
+		type->size,
+		type->reverse_byte_order ?
+			CTF2_REVERSE_BYTE_ORDER : CTF2_NATIVE_BYTE_ORDER,
+		type->alignment ? type->alignment : 1,
+		type->base);
+}
+
+static
+int ctf2_integer_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_integer *type)
+{
+	int ret;
+
+	ret = lttng_metadata_printf(session,
+		"{\"type\":\"fixed-length-%s-integer\",",
+		type->signedness ? "signed" : "unsigned");
+	if (ret)
+		return ret;
+	ret = ctf2_integer_properties_statedump(session, type);
+	if (ret)
+		return ret;
+	return lttng_metadata_printf(session, "}");
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_enum_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_enum *type)
+{
+	struct lttng_metadata_cache *cache = session->priv->metadata_cache;
+	const struct lttng_kernel_enum_desc *enum_desc = type->desc;
+	const struct lttng_kernel_type_integer *container_type;
+	struct lttng_metadata_fragment *frag;
+	unsigned int i, j, start;
+	bool first = true;
+	int ret;
+
+	if (type->container_type->type != lttng_kernel_type_integer)
+		return -EINVAL;
+	container_type = lttng_kernel_get_type_integer(type->container_type);
+
+	frag = lttng_metadata_fragment_lookup(LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2,
+			enum_desc, container_type, 0);
+	if (frag)
+		return lttng_metadata_fragment_print(session, frag);
+	start = cache->metadata_written;
+
+	ret = lttng_metadata_printf(session,
+		"{\"type\":\"fixed-length-%s-enumeration\",",
+		container_type->signedness ? "signed" : "unsigned");
+	if (ret)
+		return ret;
+	ret = ctf2_integer_properties_statedump(session, container_type);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_printf(session, ",\"mappings\":{");
+	if (ret)
+		return ret;
+	/* Mapping labels are unique: merge the ranges of duplicate entries. */
+	for (i = 0; i < enum_desc->nr_entries; i++) {
+		const char *label = enum_desc->entries[i]->string;
+
+		for (j = 0; j < i; j++) {
+			if (!strcmp(enum_desc->entries[j]->string, label))
+				break;
+		}
+		if (j < i)
+			continue;
+		if (!first) {
+			ret = lttng_metadata_printf(session, ",");
+			if (ret)
+				return ret;
+		}
+		ret = ctf2_string_statedump(session, label);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_printf(session, ":");
+		if (ret)
+			return ret;
+		ret = ctf2_enum_label_ranges_statedump(session, enum_desc, label);
+		if (ret)
+			return ret;
+		first = false;
+	}
+	ret = lttng_metadata_printf(session, "}}");
+	if (ret)
+		return ret;
+	lttng_metadata_fragment_add(session, LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2,
+			enum_desc, container_type, 0, enum_desc->probe_desc,
+			cache->metadata_written - start);
+	return 0;
+}
+
+/*
+ * Print the location of the sibling field @name of the fields of @scope.
+ */
+static
+int ctf2_field_location_statedump(struct lttng_kernel_session *session,
+		const struct ctf2_scope *scope, const char *name)
+{
+	unsigned int i;
+	int ret;
+
+	ret = lttng_metadata_printf(session,
+		"{\"origin\":\"%s\",\"path\":[", scope->origin);
+	if (ret)
+		return ret;
+	for (i = 0; i < scope->depth; i++) {
+		ret = ctf2_string_statedump(session, scope->path[i]);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_printf(session, ",");
+		if (ret)
+			return ret;
+	}
+	ret = ctf2_string_statedump(session, name);
+	if (ret)
+		return ret;
+	return lttng_metadata_printf(session, "]}");
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_struct_members_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_event_field * const *fields,
+		unsigned int nr_fields, struct ctf2_scope *scope)
+{
+	const struct lttng_kernel_event_field * const *saved_fields = scope->fields;
+	unsigned int saved_nr_fields = scope->nr_fields;
+	const char *prev_field_name = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	scope->fields = fields;
+	scope->nr_fields = nr_fields;
+	ret = lttng_metadata_printf(session, "\"member-classes\":[");
+	if (ret)
+		goto end;
+	for (i = 0; i < nr_fields; i++) {
+		const struct lttng_kernel_event_field *field = fields[i];
+
+		ret = lttng_metadata_printf(session, "%s{\"name\":", i ? "," : "");
+		if (ret)
+			goto end;
+		ret = ctf2_string_statedump(session, field->name);
+		if (ret)
+			goto end;
+		ret = lttng_metadata_printf(session, ",\"field-class\":");
+		if (ret)
+			goto end;
+		if (scope->depth == CTF2_MAX_PATH_DEPTH) {
+			ret = -EINVAL;
+			goto end;
+		}
+		scope->path[scope->depth++] = field->name;
+		ret = ctf2_type_statedump(session, field->type,
+				lttng_kernel_string_encoding_none, scope, prev_field_name);
+		scope->depth--;
+		if (ret)
+			goto end;
+		ret = lttng_metadata_printf(session, "}");
+		if (ret)
+			goto end;
+		prev_field_name = field->name;
+	}
+	ret = lttng_metadata_printf(session, "]");
+end:
+	scope->fields = saved_fields;
+	scope->nr_fields = saved_nr_fields;
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_struct_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_struct *type,
+		struct ctf2_scope *scope)
+{
+	int ret;
+
+	ret = lttng_metadata_printf(session, "{\"type\":\"structure\",");
+	if (ret)
+		return ret;
+	if (type->alignment) {
+		ret = lttng_metadata_printf(session,
+			"\"minimum-alignment\":%u,", type->alignment);
+		if (ret)
+			return ret;
+	}
+	ret = ctf2_struct_members_statedump(session, type->fields,
+			type->nr_fields, scope);
+	if (ret)
+		return ret;
+	return lttng_metadata_printf(session, "}");
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_variant_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_variant *type,
+		struct ctf2_scope *scope, const char *prev_field_name)
+{
+	const struct lttng_kernel_type_enum *tag_type = NULL;
+	const char *tag_name;
+	unsigned int i;
+	int ret;
+
+	tag_name = type->tag_name;
+	if (!tag_name)
+		tag_name = prev_field_name;
+	if (!tag_name || !scope->fields)
+		return -EINVAL;
+	/* Like in CTF 1.8, variants have no alignment of their own. */
+	if (type->alignment != 0)
+		return -EINVAL;
+	/* Option ranges are the ranges of the selector enumeration labels. */
+	for (i = 0; i < scope->nr_fields; i++) {
+		const struct lttng_kernel_event_field *field = scope->fields[i];
+
+		if (!strcmp(field->name, tag_name)
+				&& field->type->type == lttng_kernel_type_enum) {
+			tag_type = lttng_kernel_get_type_enum(field->type);
+			break;
+		}
+	}
+	if (!tag_type)
+		return -EINVAL;
+	/* The selector is a sibling of the variant, not one of its members. */
+	scope->depth--;
+	ret = lttng_metadata_printf(session,
+		"{\"type\":\"variant\",\"selector-field-location\":");
+	if (!ret)
+		ret = ctf2_field_location_statedump(session, scope, tag_name);
+	scope->depth++;
+	if (ret)
+		return ret;
+	ret = lttng_metadata_printf(session, ",\"options\":[");
+	if (ret)
+		return ret;
+	for (i = 0; i < type->nr_choices; i++) {
+		const struct lttng_kernel_event_field *choice = type->choices[i];
+
+		ret = lttng_metadata_printf(session, "%s{\"name\":", i ? "," : "");
+		if (ret)
+			return ret;
+		ret = ctf2_string_statedump(session, choice->name);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_printf(session, ",\"selector-field-ranges\":");
+		if (ret)
+			return ret;
+		ret = ctf2_enum_label_ranges_statedump(session, tag_type->desc,
+				choice->name);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_printf(session, ",\"field-class\":");
+		if (ret)
+			return ret;
+		ret = ctf2_type_statedump(session, choice->type,
+				lttng_kernel_string_encoding_none, scope, NULL);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_printf(session, "}");
+		if (ret)
+			return ret;
+	}
+	return lttng_metadata_printf(session, "]}");
+}
+
+/*
+ * Print the element field class of an array or sequence. Arrays and
+ * sequences of 8-bit integers with an encoding are strings.
+ *
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_element_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_common *elem_type,
+		enum lttng_kernel_string_encoding encoding,
+		struct ctf2_scope *scope)
+{
+	/*
+	 * Nested compound types: Only array of structures and variants are
+	 * currently supported.
+	 */
+	switch (elem_type->type) {
+	case lttng_kernel_type_integer:
+	case lttng_kernel_type_struct:
+	case lttng_kernel_type_variant:
+		break;
+	default:
+		return -EINVAL;
+	}
+	return ctf2_type_statedump(session, elem_type, encoding, scope, NULL);
+}
+
+static
+bool ctf2_is_text(const struct lttng_kernel_type_common *elem_type,
+		enum lttng_kernel_string_encoding encoding)
+{
+	return encoding != lttng_kernel_string_encoding_none
+		&& elem_type->type == lttng_kernel_type_integer
+		&& lttng_kernel_get_type_integer(elem_type)->size == CHAR_BIT;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_array_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_array *type,
+		struct ctf2_scope *scope)
+{
+	int ret;
+
+	if (ctf2_is_text(type->elem_type, type->encoding))
+		return lttng_metadata_printf(session,
+			"{\"type\":\"static-length-string\",\"length\":%u,"
+			"\"encoding\":\"utf-8\"}",
+			type->length);
+	ret = lttng_metadata_printf(session,
+		"{\"type\":\"static-length-array\",\"length\":%u,",
+		type->length);
+	if (ret)
+		return ret;
+	if (type->alignment) {
+		ret = lttng_metadata_printf(session,
+			"\"minimum-alignment\":%u,", type->alignment * CHAR_BIT);
+		if (ret)
+			return ret;
+	}
+	ret = lttng_metadata_printf(session, "\"element-field-class\":");
+	if (ret)
+		return ret;
+	ret = ctf2_element_type_statedump(session, type->elem_type,
+			type->encoding, scope);
+	if (ret)
+		return ret;
+	return lttng_metadata_printf(session, "}");
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_sequence_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_sequence *type,
+		struct ctf2_scope *scope, const char *prev_field_name)
+{
+	const char *length_name;
+	bool text;
+	int ret;
+
+	length_name = type->length_name;
+	if (!length_name)
+		length_name = prev_field_name;
+	if (!length_name)
+		return -EINVAL;
+	text = ctf2_is_text(type->elem_type, type->encoding);
+	ret = lttng_metadata_printf(session, "{\"type\":\"%s\",",
+		text ? "dynamic-length-string" : "dynamic-length-array");
+	if (ret)
+		return ret;
+	if (!text && type->alignment) {
+		ret = lttng_metadata_printf(session,
+			"\"minimum-alignment\":%u,", type->alignment * CHAR_BIT);
+		if (ret)
+			return ret;
+	}
+	/* The length field is a sibling of the sequence, not one of its members. */
+	ret = lttng_metadata_printf(session, "\"length-field-location\":");
+	if (ret)
+		return ret;
+	scope->depth--;
+	ret = ctf2_field_location_statedump(session, scope, length_name);
+	scope->depth++;
+	if (ret)
+		return ret;
+	if (text)
+		return lttng_metadata_printf(session, ",\"encoding\":\"utf-8\"}");
+	ret = lttng_metadata_printf(session, ",\"element-field-class\":");
+	if (ret)
+		return ret;
+	ret = ctf2_element_type_statedump(session, type->elem_type,
+			type->encoding, scope);
+	if (ret)
+		return ret;
+	return lttng_metadata_printf(session, "}");
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_type_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_type_common *type,
+		enum lttng_kernel_string_encoding parent_encoding,
+		struct ctf2_scope *scope, const char *prev_field_name)
+{
+	switch (type->type) {
+	case lttng_kernel_type_integer:
+		return ctf2_integer_type_statedump(session,
+				lttng_kernel_get_type_integer(type));
+	case lttng_kernel_type_enum:
+		return ctf2_enum_type_statedump(session,
+				lttng_kernel_get_type_enum(type));
+	case lttng_kernel_type_string:
+		return lttng_metadata_printf(session,
+				"{\"type\":\"null-terminated-string\"}");
+	case lttng_kernel_type_struct:
+		return ctf2_struct_type_statedump(session,
+				lttng_kernel_get_type_struct(type), scope);
+	case lttng_kernel_type_variant:
+		return ctf2_variant_type_statedump(session,
+				lttng_kernel_get_type_variant(type), scope,
+				prev_field_name);
+	case lttng_kernel_type_array:
+		return ctf2_array_type_statedump(session,
+				lttng_kernel_get_type_array(type), scope);
+	case lttng_kernel_type_sequence:
+		return ctf2_sequence_type_statedump(session,
+				lttng_kernel_get_type_sequence(type), scope,
+				prev_field_name);
+	default:
+		WARN_ON_ONCE(1);
+		return -EINVAL;
+	}
+}
+
+/*
+ * The payload field class of an event only depends on its descriptor, so
+ * it is shared across sessions as a metadata fragment.
+ *
+ * Must be called with sessions_mutex held.
+ */
+static
+int ctf2_payload_statedump(struct lttng_kernel_session *session,
+		const struct lttng_kernel_event_desc *desc)
+{
+	struct lttng_metadata_cache *cache = session->priv->metadata_cache;
+	struct ctf2_scope scope = {
+		.origin = "event-record-payload",
+	};
+	struct lttng_metadata_fragment *frag;
+	unsigned int start;
+	int ret;
+
+	frag = lttng_metadata_fragment_lookup(LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2,
+			desc, NULL, 0);
+	if (frag)
+		return lttng_metadata_fragment_print(session, frag);
+	start = cache->metadata_written;
+	ret = lttng_metadata_printf(session, "{\"type\":\"structure\",");
+	if (ret)
+		return ret;
+	ret = ctf2_struct_members_statedump(session, desc->tp_class->fields,
+			desc->tp_class->nr_fields, &scope);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_printf(session, "}");
+	if (ret)
+		return ret;
+	lttng_metadata_fragment_add(session, LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2,
+			desc, NULL, 0, desc->probe_desc,
+			cache->metadata_written - start);
+	return 0;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+int lttng_metadata_ctf2_event_recorder_statedump(struct lttng_kernel_session *session,
+		struct lttng_kernel_event_recorder *event_recorder)
+{
+	const struct lttng_kernel_event_desc *desc = event_recorder->priv->parent.desc;
+	int ret;
+
+	ret = lttng_metadata_printf(session,
+		CTF2_RS "{\"type\":\"event-record-class\",\"id\":%u,"
+		"\"data-stream-class-id\":%u,\"name\":",
+		event_recorder->priv->id,
+		event_recorder->chan->priv->id);
+	if (ret)
+		return ret;
+	ret = ctf2_string_statedump(session, desc->event_name);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_printf(session, ",\"payload-field-class\":");
+	if (ret)
+		return ret;
+	ret = ctf2_payload_statedump(session, desc);
+	if (ret)
+		return ret;
+	return lttng_metadata_printf(session, "}\n");
+}
+
+/*
+ * Event record header field classes, matching the compact, large and
+ * packed event headers of the ring buffer client. See
+ * _lttng_event_header_declare() for the CTF 1.8 equivalent.
+ */
+static
+int ctf2_event_header_statedump(struct lttng_kernel_session *session,
+		struct lttng_kernel_channel_buffer *chan)
+{
+	unsigned int i;
+	int ret;
+
+	switch (chan->priv->header_type) {
+	case 1:	/* compact */
+	case 2:	/* large */
+	{
+		bool compact = chan->priv->header_type == 1;
+		unsigned int id_len = compact ? 5 : 16;
+		unsigned int max_id = (1U << id_len) - 1;
+
+		return lttng_metadata_printf(session,
+			"{\"type\":\"structure\",\"minimum-alignment\":%u,\"member-classes\":["
+			"{\"name\":\"id\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+				"\"length\":%u,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+				"\"roles\":[\"event-record-class-id\"]}},"
+			"{\"name\":\"v\",\"field-class\":{\"type\":\"variant\","
+				"\"selector-field-location\":{\"origin\":\"event-record-header\",\"path\":[\"id\"]},"
+				"\"options\":["
+				"{\"name\":\"compact\",\"selector-field-ranges\":[[0,%u]],"
+					"\"field-class\":{\"type\":\"structure\",\"member-classes\":["
+					"{\"name\":\"timestamp\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+						"\"length\":%u,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+						"\"roles\":[\"default-clock-timestamp\"]}}]}},"
+				"{\"name\":\"extended\",\"selector-field-ranges\":[[%u,%u]],"
+					"\"field-class\":{\"type\":\"structure\",\"member-classes\":["
+					"{\"name\":\"id\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+						"\"length\":32,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+						"\"roles\":[\"event-record-class-id\"]}},"
+					"{\"name\":\"timestamp\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+						"\"length\":64,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+						"\"roles\":[\"default-clock-timestamp\"]}}]}}]}}]}",
+			compact ? lttng_alignof(uint32_t) * CHAR_BIT : lttng_alignof(uint16_t) * CHAR_BIT,
+			id_len,
+			compact ? 1 : lttng_alignof(uint16_t) * CHAR_BIT,
+			max_id - 1,
+			compact ? 27 : 32,
+			compact ? 1 : lttng_alignof(uint32_t) * CHAR_BIT,
+			max_id, max_id,
+			lttng_alignof(uint32_t) * CHAR_BIT,
+			lttng_alignof(uint64_t) * CHAR_BIT);
+	}
+	case 3:	/* packed */
+		ret = lttng_metadata_printf(session,
+			"{\"type\":\"structure\",\"minimum-alignment\":8,\"member-classes\":["
+			"{\"name\":\"id\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+				"\"length\":5,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":1,"
+				"\"roles\":[\"event-record-class-id\"]}},"
+			"{\"name\":\"timestamp_len\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+				"\"length\":3,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":1}},"
+			"{\"name\":\"v\",\"field-class\":{\"type\":\"variant\","
+				"\"selector-field-location\":{\"origin\":\"event-record-header\",\"path\":[\"id\"]},"
+				"\"options\":["
+				"{\"name\":\"compact\",\"selector-field-ranges\":[[0,30]],"
+					"\"field-class\":{\"type\":\"structure\",\"member-classes\":[]}},"
+				"{\"name\":\"extended\",\"selector-field-ranges\":[[31,31]],"
+					"\"field-class\":{\"type\":\"structure\",\"member-classes\":["
+					"{\"name\":\"id\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+						"\"length\":32,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":8,"
+						"\"roles\":[\"event-record-class-id\"]}}]}}]}},"
+			"{\"name\":\"timestamp\",\"field-class\":{\"type\":\"variant\","
+				"\"selector-field-location\":{\"origin\":\"event-record-header\",\"path\":[\"timestamp_len\"]},"
+				"\"options\":[");
+		if (ret)
+			return ret;
+		/* Byte-aligned clock values holding 1 to 8 low-order bytes. */
+		for (i = 0; i < sizeof(uint64_t); i++) {
+			ret = lttng_metadata_printf(session,
+				"%s{\"name\":\"ts%u\",\"selector-field-ranges\":[[%u,%u]],"
+					"\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+					"\"length\":%u,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":8,"
+					"\"roles\":[\"default-clock-timestamp\"]}}",
+				i ? "," : "",
+				(i + 1) * CHAR_BIT, i, i,
+				(i + 1) * CHAR_BIT);
+			if (ret)
+				return ret;
+		}
+		return lttng_metadata_printf(session, "]}}]}");
+	default:
+		WARN_ON_ONCE(1);
+		return -EINVAL;
+	}
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+int lttng_metadata_ctf2_channel_statedump(struct lttng_kernel_session *session,
+		struct lttng_kernel_channel_buffer *chan)
+{
+	int ret;
+
+	ret = lttng_metadata_printf(session,
+		CTF2_RS "{\"type\":\"data-stream-class\",\"id\":%u,"
+		"\"default-clock-class-id\":",
+		chan->priv->id);
+	if (ret)
+		return ret;
+	ret = ctf2_string_statedump(session, trace_clock_name());
+	if (ret)
+		return ret;
+	ret = lttng_metadata_printf(session,
+		",\"packet-context-field-class\":{\"type\":\"structure\",\"member-classes\":["
+		"{\"name\":\"timestamp_begin\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":64,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"default-clock-timestamp\"]}},"
+		"{\"name\":\"timestamp_end\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":64,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"packet-end-default-clock-timestamp\"]}},"
+		"{\"name\":\"content_size\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":64,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"packet-content-length\"]}},"
+		"{\"name\":\"packet_size\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":64,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"packet-total-length\"]}},"
+		"{\"name\":\"packet_seq_num\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":64,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"packet-sequence-number\"]}},"
+		"{\"name\":\"events_discarded\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":%u,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"discarded-event-record-counter-snapshot\"]}},"
+		"{\"name\":\"cpu_id\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":32,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u}}]},"
+		"\"event-record-header-field-class\":",
+		lttng_alignof(uint64_t) * CHAR_BIT,
+		lttng_alignof(uint64_t) * CHAR_BIT,
+		lttng_alignof(uint64_t) * CHAR_BIT,
+		lttng_alignof(uint64_t) * CHAR_BIT,
+		lttng_alignof(uint64_t) * CHAR_BIT,
+		(unsigned int) sizeof(unsigned long) * CHAR_BIT,
+		lttng_alignof(unsigned long) * CHAR_BIT,
+		lttng_alignof(uint32_t) * CHAR_BIT);
+	if (ret)
+		return ret;
+	ret = ctf2_event_header_statedump(session, chan);
+	if (ret)
+		return ret;
+	if (chan->priv->ctx && chan->priv->ctx->nr_fields) {
+		struct lttng_kernel_ctx *ctx = chan->priv->ctx;
+		struct ctf2_scope scope = {
+			.origin = "event-record-common-context",
+		};
+		const char *prev_field_name = NULL;
+		unsigned int i;
+
+		ret = lttng_metadata_printf(session,
+			",\"event-record-common-context-field-class\":"
+			"{\"type\":\"structure\",\"member-classes\":[");
+		if (ret)
+			return ret;
+		for (i = 0; i < ctx->nr_fields; i++) {
+			const struct lttng_kernel_event_field *field = ctx->fields[i].event_field;
+
+			ret = lttng_metadata_printf(session, "%s{\"name\":", i ? "," : "");
+			if (ret)
+				return ret;
+			ret = ctf2_string_statedump(session, field->name);
+			if (ret)
+				return ret;
+			ret = lttng_metadata_printf(session, ",\"field-class\":");
+			if (ret)
+				return ret;
+			scope.path[0] = field->name;
+			scope.depth = 1;
+			ret = ctf2_type_statedump(session, field->type,
+					lttng_kernel_string_encoding_none, &scope,
+					prev_field_name);
+			if (ret)
+				return ret;
+			ret = lttng_metadata_printf(session, "}");
+			if (ret)
+				return ret;
+			prev_field_name = field->name;
+		}
+		ret = lttng_metadata_printf(session, "]}");
+		if (ret)
+			return ret;
+	}
+	return lttng_metadata_printf(session, "}\n");
+}
+
+static
+int ctf2_env_string_statedump(struct lttng_kernel_session *session,
+		const char *name, const char *value)
+{
+	int ret;
+
+	ret = lttng_metadata_printf(session, ",\"%s\":", name);
+	if (ret)
+		return ret;
+	return ctf2_string_statedump(session, value);
+}
+
+/*
+ * Output the preamble, trace class and clock class fragments.
+ * @clock_offset is the offset of the trace clock from the Epoch, in
+ * clock cycles.
+ *
+ * Must be called with sessions_mutex held.
+ */
+int lttng_metadata_ctf2_session_statedump(struct lttng_kernel_session *session,
+		int64_t clock_offset)
+{
+	unsigned char *uuid_c = session->priv->uuid.b;
+	char clock_uuid_s[BOOT_ID_LEN];
+	uint64_t freq = trace_clock_freq();
+	const char *product_uuid;
+	int64_t offset_s, offset_cycles;
+	unsigned int i;
+	int ret;
+
+	ret = lttng_metadata_printf(session,
+		CTF2_RS "{\"type\":\"preamble\",\"version\":2,\"uuid\":[");
+	if (ret)
+		return ret;
+	for (i = 0; i < sizeof(session->priv->uuid.b); i++) {
+		ret = lttng_metadata_printf(session, "%s%u", i ? "," : "",
+				uuid_c[i]);
+		if (ret)
+			return ret;
+	}
+	ret = lttng_metadata_printf(session, "]}\n");
+	if (ret)
+		return ret;
+
+	ret = lttng_metadata_printf(session,
+		CTF2_RS "{\"type\":\"trace-class\",\"environment\":{"
+		"\"domain\":\"kernel\","
+		"\"tracer_name\":\"lttng-modules\","
+		"\"tracer_major\":%d,"
+		"\"tracer_minor\":%d,"
+		"\"tracer_patchlevel\":%d,"
+		"\"trace_buffering_scheme\":\"global\"",
+		LTTNG_MODULES_MAJOR_VERSION,
+		LTTNG_MODULES_MINOR_VERSION,
+		LTTNG_MODULES_PATCHLEVEL_VERSION);
+	if (ret)
+		return ret;
+	ret = ctf2_env_string_statedump(session, "hostname",
+			current->nsproxy->uts_ns->name.nodename);
+	if (ret)
+		return ret;
+	ret = ctf2_env_string_statedump(session, "sysname", utsname()->sysname);
+	if (ret)
+		return ret;
+	ret = ctf2_env_string_statedump(session, "kernel_release", utsname()->release);
+	if (ret)
+		return ret;
+	ret = ctf2_env_string_statedump(session, "kernel_version", utsname()->version);
+	if (ret)
+		return ret;
+	ret = ctf2_env_string_statedump(session, "trace_name", session->priv->name);
+	if (ret)
+		return ret;
+	ret = ctf2_env_string_statedump(session, "trace_creation_datetime",
+			session->priv->creation_time);
+	if (ret)
+		return ret;
+	product_uuid = dmi_get_system_info(DMI_PRODUCT_UUID);
+	if (product_uuid) {
+		ret = ctf2_env_string_statedump(session, "product_uuid", product_uuid);
+		if (ret)
+			return ret;
+	}
+	ret = lttng_metadata_printf(session,
+		"},\"packet-header-field-class\":{\"type\":\"structure\",\"member-classes\":["
+		"{\"name\":\"magic\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":32,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"packet-magic-number\"]}},"
+		"{\"name\":\"uuid\",\"field-class\":{\"type\":\"static-length-blob\","
+			"\"length\":16,\"roles\":[\"metadata-stream-uuid\"]}},"
+		"{\"name\":\"stream_id\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":32,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"data-stream-class-id\"]}},"
+		"{\"name\":\"stream_instance_id\",\"field-class\":{\"type\":\"fixed-length-unsigned-integer\","
+			"\"length\":64,\"byte-order\":\"" CTF2_NATIVE_BYTE_ORDER "\",\"alignment\":%u,"
+			"\"roles\":[\"data-stream-id\"]}}]}}\n",
+		lttng_alignof(uint32_t) * CHAR_BIT,
+		lttng_alignof(uint32_t) * CHAR_BIT,
+		lttng_alignof(uint64_t) * CHAR_BIT);
+	if (ret)
+		return ret;
+
+	/* The offset from origin is split in seconds and remaining cycles. */
+	offset_s = div64_s64(clock_offset, freq);
+	offset_cycles = clock_offset - offset_s * (int64_t) freq;
+	if (offset_cycles < 0) {
+		offset_s--;
+		offset_cycles += freq;
+	}
+	ret = lttng_metadata_printf(session,
+		CTF2_RS "{\"type\":\"clock-class\",\"id\":");
+	if (ret)
+		return ret;
+	ret = ctf2_string_statedump(session, trace_clock_name());
+	if (ret)
+		return ret;
+	ret = lttng_metadata_printf(session, ",\"name\":");
+	if (ret)
+		return ret;
+	ret = ctf2_string_statedump(session, trace_clock_name());
+	if (ret)
+		return ret;
+	if (!trace_clock_uuid(clock_uuid_s)) {
+		ret = ctf2_env_string_statedump(session, "uid", clock_uuid_s);
+		if (ret)
+			return ret;
+	}
+	ret = ctf2_env_string_statedump(session, "description",
+			trace_clock_description());
+	if (ret)
+		return ret;
+	return lttng_metadata_printf(session,
+		",\"frequency\":%llu,"
+		"\"offset-from-origin\":{\"seconds\":%lld,\"cycles\":%llu},"
+		"\"origin\":\"unix-epoch\"}\n",
+		(unsigned long long) freq,
+		(long long) offset_s,
+		(unsigned long long) offset_cycles);
+}
@@ -198,6 +198,7 @@ void lttng_kernel_probe_unregister(struct lttng_kernel_probe_desc *desc)
 		list_del(&desc->head);
 	else
 		list_del(&desc->lazy_init_head);
+	lttng_metadata_fragments_invalidate(desc);
 	pr_debug("LTTng: just unregistered probe %s\n", desc->provider_name);
 	lttng_unlock_sessions();
 }
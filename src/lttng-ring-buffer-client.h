@@ -16,9 +16,11 @@
 #include <lttng/events-internal.h>
 #include <lttng/tracer.h>
 #include <ringbuffer/frontend_types.h>
+#include <ringbuffer/frontend_internal.h>
 
 #define LTTNG_COMPACT_EVENT_BITS	5
 #define LTTNG_COMPACT_TSC_BITS		27
+#define LTTNG_PACKED_TSC_LEN_BITS	3
 
 static struct lttng_transport lttng_relay_transport;
 
@@ -67,6 +69,15 @@ struct packet_header {
 struct lttng_client_ctx {
 	size_t packet_context_len;
 	size_t event_context_len;
+	unsigned int timestamp_len;	/* Packed header timestamp length, in bytes */
+	/*
+	 * Event header type and channel context. These are compile-time
+	 * constants in the specialized reserve fast paths, which lets the
+	 * compiler fold away the code of the other header layouts and the
+	 * context handling of context-less channels.
+	 */
+	int header_type;
+	struct lttng_kernel_ctx *chan_ctx;
 };
 
 static inline notrace u64 lib_ring_buffer_clock_read(struct lttng_kernel_ring_buffer_channel *chan)
@@ -141,11 +152,10 @@ size_t record_header_size(const struct lttng_kernel_ring_buffer_config *config,
 				 struct lttng_kernel_ring_buffer_ctx *ctx,
 				 struct lttng_client_ctx *client_ctx)
 {
-	struct lttng_kernel_channel_buffer *lttng_chan = channel_get_private(chan);
 	size_t orig_offset = offset;
 	size_t padding;
 
-	switch (lttng_chan->priv->header_type) {
+	switch (client_ctx->header_type) {
 	case 1:	/* compact */
 		padding = lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
 		offset += padding;
@@ -176,11 +186,31 @@ size_t record_header_size(const struct lttng_kernel_ring_buffer_config *config,
 			offset += sizeof(uint64_t);	/* timestamp */
 		}
 		break;
+	case 3:	/* packed */
+		padding = 0;
+		offset += sizeof(uint8_t);		/* id and timestamp length */
+		if (ctx->priv.rflags & LTTNG_RFLAG_EXTENDED)
+			offset += sizeof(uint32_t);	/* id */
+		/*
+		 * Only the low-order bytes covering the delta from the last
+		 * timestamp are written. The first event of a packet has the
+		 * packet begin timestamp, so a single byte is enough.
+		 */
+		if (ctx->priv.rflags & RING_BUFFER_RFLAG_FULL_TSC)
+			client_ctx->timestamp_len = sizeof(uint64_t);
+		else if (ctx->priv.rflags & RING_BUFFER_RFLAG_PACKET_START)
+			client_ctx->timestamp_len = 1;
+		else
+			client_ctx->timestamp_len = max_t(unsigned int, 1,
+				DIV_ROUND_UP(last_tsc_delta_bits(config, ctx->priv.buf,
+						ctx->priv.tsc), CHAR_BIT));
+		offset += client_ctx->timestamp_len;
+		break;
 	default:
 		padding = 0;
 		WARN_ON_ONCE(1);
 	}
-	offset += ctx_get_aligned_size(offset, lttng_chan->priv->ctx,
+	offset += ctx_get_aligned_size(offset, client_ctx->chan_ctx,
 			client_ctx->packet_context_len);
 	*pre_header_padding = padding;
 	return offset - orig_offset;
@@ -191,8 +221,41 @@ size_t record_header_size(const struct lttng_kernel_ring_buffer_config *config,
 static
 void lttng_write_event_header_slow(const struct lttng_kernel_ring_buffer_config *config,
 				 struct lttng_kernel_ring_buffer_ctx *ctx,
+				 struct lttng_client_ctx *client_ctx,
 				 uint32_t event_id);
 
+/*
+ * Packed header: 5-bit id and 3-bit timestamp length (in bytes, minus one),
+ * followed by the extended id if needed and by the low-order bytes of the
+ * timestamp, without alignment.
+ */
+static __inline__
+void lttng_write_packed_event_header(const struct lttng_kernel_ring_buffer_config *config,
+			    struct lttng_kernel_ring_buffer_ctx *ctx,
+			    struct lttng_client_ctx *client_ctx,
+			    uint32_t event_id)
+{
+	uint8_t timestamp[sizeof(uint64_t)];
+	uint8_t id_len = 0;
+
+	bt_bitfield_write(&id_len, uint8_t,
+			0,
+			LTTNG_COMPACT_EVENT_BITS,
+			(ctx->priv.rflags & LTTNG_RFLAG_EXTENDED) ? 31 : event_id);
+	bt_bitfield_write(&id_len, uint8_t,
+			LTTNG_COMPACT_EVENT_BITS,
+			LTTNG_PACKED_TSC_LEN_BITS,
+			client_ctx->timestamp_len - 1);
+	lib_ring_buffer_write(config, ctx, &id_len, sizeof(id_len));
+	if (ctx->priv.rflags & LTTNG_RFLAG_EXTENDED)
+		lib_ring_buffer_write(config, ctx, &event_id, sizeof(event_id));
+	bt_bitfield_write(timestamp, uint8_t,
+			0,
+			client_ctx->timestamp_len * CHAR_BIT,
+			ctx->priv.tsc);
+	lib_ring_buffer_write(config, ctx, timestamp, client_ctx->timestamp_len);
+}
+
 /*
  * lttng_write_event_header
  *
@@ -200,11 +263,13 @@ void lttng_write_event_header_slow(const struct lttng_kernel_ring_buffer_config
  *
  * @config: ring buffer instance configuration
  * @ctx: reservation context
+ * @client_ctx: client reservation context
  * @event_id: event ID
  */
 static __inline__
 void lttng_write_event_header(const struct lttng_kernel_ring_buffer_config *config,
 			    struct lttng_kernel_ring_buffer_ctx *ctx,
+			    struct lttng_client_ctx *client_ctx,
 			    uint32_t event_id)
 {
 	struct lttng_kernel_channel_buffer *lttng_chan = channel_get_private(ctx->priv.chan);
@@ -212,7 +277,7 @@ void lttng_write_event_header(const struct lttng_kernel_ring_buffer_config *conf
 	if (unlikely(ctx->priv.rflags))
 		goto slow_path;
 
-	switch (lttng_chan->priv->header_type) {
+	switch (client_ctx->header_type) {
 	case 1:	/* compact */
 	{
 		uint32_t id_time = 0;
@@ -238,27 +303,31 @@ void lttng_write_event_header(const struct lttng_kernel_ring_buffer_config *conf
 		lib_ring_buffer_write(config, ctx, &timestamp, sizeof(timestamp));
 		break;
 	}
+	case 3:	/* packed */
+		lttng_write_packed_event_header(config, ctx, client_ctx, event_id);
+		break;
 	default:
 		WARN_ON_ONCE(1);
 	}
 
-	ctx_record(ctx, lttng_chan, lttng_chan->priv->ctx);
+	ctx_record(ctx, lttng_chan, client_ctx->chan_ctx);
 	lib_ring_buffer_align_ctx(ctx, ctx->largest_align);
 
 	return;
 
 slow_path:
-	lttng_write_event_header_slow(config, ctx, event_id);
+	lttng_write_event_header_slow(config, ctx, client_ctx, event_id);
 }
 
 static
 void lttng_write_event_header_slow(const struct lttng_kernel_ring_buffer_config *config,
 				 struct lttng_kernel_ring_buffer_ctx *ctx,
+				 struct lttng_client_ctx *client_ctx,
 				 uint32_t event_id)
 {
 	struct lttng_kernel_channel_buffer *lttng_chan = channel_get_private(ctx->priv.chan);
 
-	switch (lttng_chan->priv->header_type) {
+	switch (client_ctx->header_type) {
 	case 1:	/* compact */
 		if (!(ctx->priv.rflags & (RING_BUFFER_RFLAG_FULL_TSC | LTTNG_RFLAG_EXTENDED))) {
 			uint32_t id_time = 0;
@@ -309,10 +378,13 @@ void lttng_write_event_header_slow(const struct lttng_kernel_ring_buffer_config
 		}
 		break;
 	}
+	case 3:	/* packed */
+		lttng_write_packed_event_header(config, ctx, client_ctx, event_id);
+		break;
 	default:
 		WARN_ON_ONCE(1);
 	}
-	ctx_record(ctx, lttng_chan, lttng_chan->priv->ctx);
+	ctx_record(ctx, lttng_chan, client_ctx->chan_ctx);
 	lib_ring_buffer_align_ctx(ctx, ctx->largest_align);
 }
 
@@ -547,10 +619,15 @@ struct lttng_kernel_ring_buffer_channel *_channel_create(const char *name,
 {
 	struct lttng_kernel_channel_buffer *lttng_chan = priv;
 	struct lttng_kernel_ring_buffer_channel *chan;
+	size_t num_standby_subbuf = 0;
 
+	/* A frozen snapshot may take every sub-buffer of a buffer. */
+	if (client_config.mode == RING_BUFFER_OVERWRITE
+	    && lttng_chan->priv->snapshot_standby)
+		num_standby_subbuf = num_subbuf;
 	chan = channel_create(&client_config, name, lttng_chan, buf_addr,
 			      subbuf_size, num_subbuf, switch_timer_interval,
-			      read_timer_interval);
+			      read_timer_interval, num_standby_subbuf);
 	if (chan) {
 		/*
 		 * Ensure this module is not unloaded before we finish
@@ -604,8 +681,14 @@ void lttng_buffer_read_close(struct lttng_kernel_ring_buffer *buf)
 	lib_ring_buffer_release_read(buf);
 }
 
-static
-int lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx)
+/*
+ * Reserve fast path, expanded for each specialized client. @header_type and
+ * @chan_ctx are expected to be compile-time constants, except for the generic
+ * lttng_event_reserve().
+ */
+static __always_inline
+int _lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx,
+		int header_type, struct lttng_kernel_ctx *chan_ctx)
 {
 	struct lttng_kernel_event_recorder *event_recorder = ctx->client_priv;
 	struct lttng_kernel_channel_buffer *lttng_chan = event_recorder->chan;
@@ -620,12 +703,16 @@ int lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx)
 	memset(&ctx->priv, 0, sizeof(ctx->priv));
 	ctx->priv.chan = lttng_chan->priv->rb_chan;
 	ctx->priv.reserve_cpu = cpu;
+	client_ctx.header_type = header_type;
+	client_ctx.chan_ctx = chan_ctx;
 
 	/* Compute internal size of context structures. */
-	ctx_get_struct_size(lttng_chan->priv->ctx, &client_ctx.packet_context_len, lttng_chan, ctx);
+	ctx_get_struct_size(chan_ctx, &client_ctx.packet_context_len, lttng_chan, ctx);
 
-	switch (lttng_chan->priv->header_type) {
+	switch (header_type) {
 	case 1:	/* compact */
+		lttng_fallthrough;
+	case 3:	/* packed */
 		if (event_id > 30)
 			ctx->priv.rflags |= LTTNG_RFLAG_EXTENDED;
 		break;
@@ -642,13 +729,49 @@ int lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx)
 		goto put;
 	lib_ring_buffer_backend_get_pages(&client_config, ctx,
 			&ctx->priv.backend_pages);
-	lttng_write_event_header(&client_config, ctx, event_id);
+	lttng_write_event_header(&client_config, ctx, &client_ctx, event_id);
 	return 0;
 put:
 	lib_ring_buffer_put_cpu(&client_config);
 	return ret;
 }
 
+static
+int lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx)
+{
+	struct lttng_kernel_event_recorder *event_recorder = ctx->client_priv;
+	struct lttng_kernel_channel_buffer *lttng_chan = event_recorder->chan;
+
+	return _lttng_event_reserve(ctx, lttng_chan->priv->header_type,
+			lttng_chan->priv->ctx);
+}
+
+/*
+ * Specialized reserve fast paths, one per event header type, for channels
+ * with and without context.
+ */
+#define LTTNG_CLIENT_EVENT_RESERVE(_name, _header_type)				\
+static										\
+int lttng_event_reserve_##_name(struct lttng_kernel_ring_buffer_ctx *ctx)	\
+{										\
+	struct lttng_kernel_event_recorder *event_recorder = ctx->client_priv;	\
+										\
+	return _lttng_event_reserve(ctx, _header_type,				\
+			event_recorder->chan->priv->ctx);			\
+}										\
+										\
+static										\
+int lttng_event_reserve_##_name##_noctx(struct lttng_kernel_ring_buffer_ctx *ctx) \
+{										\
+	return _lttng_event_reserve(ctx, _header_type, NULL);			\
+}
+
+LTTNG_CLIENT_EVENT_RESERVE(compact, 1)
+LTTNG_CLIENT_EVENT_RESERVE(large, 2)
+LTTNG_CLIENT_EVENT_RESERVE(packed, 3)
+
+#undef LTTNG_CLIENT_EVENT_RESERVE
+
 static
 void lttng_event_commit(struct lttng_kernel_ring_buffer_ctx *ctx)
 {
@@ -740,46 +863,80 @@ int lttng_is_disabled(struct lttng_kernel_ring_buffer_channel *chan)
 	return lib_ring_buffer_channel_is_disabled(chan);
 }
 
+static
+struct lttng_kernel_channel_buffer_ops *lttng_select_ops(struct lttng_kernel_channel_buffer *lttng_chan);
+
+static struct lttng_kernel_channel_buffer_ops_private lttng_relay_ops_private = {
+	.pub = &lttng_relay_transport.ops,
+	.channel_create = _channel_create,
+	.channel_destroy = lttng_channel_destroy,
+	.buffer_read_open = lttng_buffer_read_open,
+	.buffer_has_read_closed_stream =
+		lttng_buffer_has_read_closed_stream,
+	.buffer_read_close = lttng_buffer_read_close,
+	.packet_avail_size = NULL,	/* Would be racy anyway */
+	.get_writer_buf_wait_queue = lttng_get_writer_buf_wait_queue,
+	.get_hp_wait_queue = lttng_get_hp_wait_queue,
+	.is_finalized = lttng_is_finalized,
+	.is_disabled = lttng_is_disabled,
+	.timestamp_begin = client_timestamp_begin,
+	.timestamp_end = client_timestamp_end,
+	.events_discarded = client_events_discarded,
+	.content_size = client_content_size,
+	.packet_size = client_packet_size,
+	.stream_id = client_stream_id,
+	.current_timestamp = client_current_timestamp,
+	.sequence_number = client_sequence_number,
+	.instance_id = client_instance_id,
+	.select_ops = lttng_select_ops,
+};
+
+#define LTTNG_CLIENT_OPS(_event_reserve)					\
+	{									\
+		.priv = &lttng_relay_ops_private,				\
+		.event_reserve = _event_reserve,				\
+		.event_commit = lttng_event_commit,				\
+		.event_write = lttng_event_write,				\
+		.event_write_from_user = lttng_event_write_from_user,		\
+		.event_memset = lttng_event_memset,				\
+		.event_strcpy = lttng_event_strcpy,				\
+		.event_strcpy_from_user = lttng_event_strcpy_from_user,		\
+		.event_pstrcpy_pad = lttng_event_pstrcpy_pad,			\
+		.event_pstrcpy_pad_from_user = lttng_event_pstrcpy_pad_from_user, \
+		.lost_event_too_big = lttng_channel_buffer_lost_event_too_big,	\
+	}
+
 static struct lttng_transport lttng_relay_transport = {
 	.name = "relay-" RING_BUFFER_MODE_TEMPLATE_STRING,
 	.owner = THIS_MODULE,
-	.ops = {
-		.priv = __LTTNG_COMPOUND_LITERAL(struct lttng_kernel_channel_buffer_ops_private, {
-			.pub = &lttng_relay_transport.ops,
-			.channel_create = _channel_create,
-			.channel_destroy = lttng_channel_destroy,
-			.buffer_read_open = lttng_buffer_read_open,
-			.buffer_has_read_closed_stream =
-				lttng_buffer_has_read_closed_stream,
-			.buffer_read_close = lttng_buffer_read_close,
-			.packet_avail_size = NULL,	/* Would be racy anyway */
-			.get_writer_buf_wait_queue = lttng_get_writer_buf_wait_queue,
-			.get_hp_wait_queue = lttng_get_hp_wait_queue,
-			.is_finalized = lttng_is_finalized,
-			.is_disabled = lttng_is_disabled,
-			.timestamp_begin = client_timestamp_begin,
-			.timestamp_end = client_timestamp_end,
-			.events_discarded = client_events_discarded,
-			.content_size = client_content_size,
-			.packet_size = client_packet_size,
-			.stream_id = client_stream_id,
-			.current_timestamp = client_current_timestamp,
-			.sequence_number = client_sequence_number,
-			.instance_id = client_instance_id,
-		}),
-		.event_reserve = lttng_event_reserve,
-		.event_commit = lttng_event_commit,
-		.event_write = lttng_event_write,
-		.event_write_from_user = lttng_event_write_from_user,
-		.event_memset = lttng_event_memset,
-		.event_strcpy = lttng_event_strcpy,
-		.event_strcpy_from_user = lttng_event_strcpy_from_user,
-		.event_pstrcpy_pad = lttng_event_pstrcpy_pad,
-		.event_pstrcpy_pad_from_user = lttng_event_pstrcpy_pad_from_user,
-		.lost_event_too_big = lttng_channel_buffer_lost_event_too_big,
-	},
+	.ops = LTTNG_CLIENT_OPS(lttng_event_reserve),
+};
+
+/*
+ * Specialized ops, indexed by event header type (minus one) and by whether
+ * the channel has context. They share the private ops of the transport.
+ */
+static struct lttng_kernel_channel_buffer_ops lttng_relay_specialized_ops[3][2] = {
+	{ LTTNG_CLIENT_OPS(lttng_event_reserve_compact_noctx),
+	  LTTNG_CLIENT_OPS(lttng_event_reserve_compact) },
+	{ LTTNG_CLIENT_OPS(lttng_event_reserve_large_noctx),
+	  LTTNG_CLIENT_OPS(lttng_event_reserve_large) },
+	{ LTTNG_CLIENT_OPS(lttng_event_reserve_packed_noctx),
+	  LTTNG_CLIENT_OPS(lttng_event_reserve_packed) },
 };
 
+#undef LTTNG_CLIENT_OPS
+
+static
+struct lttng_kernel_channel_buffer_ops *lttng_select_ops(struct lttng_kernel_channel_buffer *lttng_chan)
+{
+	int header_type = lttng_chan->priv->header_type;
+
+	if (header_type < 1 || header_type > 3)
+		return NULL;
+	return &lttng_relay_specialized_ops[header_type - 1][!!lttng_chan->priv->ctx];
+}
+
 static int __init lttng_ring_buffer_client_init(void)
 {
 	/*
@@ -13,4 +13,6 @@
 #define RING_BUFFER_MODE_TEMPLATE		RING_BUFFER_DISCARD
 #define RING_BUFFER_MODE_TEMPLATE_STRING	"event-notifier"
 #define RING_BUFFER_OUTPUT_TEMPLATE		RING_BUFFER_NONE
+#define RING_BUFFER_ALLOC_TEMPLATE		RING_BUFFER_ALLOC_GLOBAL
+#define RING_BUFFER_SYNC_TEMPLATE		RING_BUFFER_SYNC_GLOBAL
 #include "lttng-ring-buffer-event-notifier-client.h"
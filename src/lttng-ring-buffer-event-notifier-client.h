@@ -10,12 +10,19 @@
 #include <linux/limits.h>
 #include <linux/module.h>
 #include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/irq_work.h>
+#include <linux/smp.h>
+#include <linux/workqueue.h>
+#include <asm/local.h>
+#include <wrapper/cpu.h>
 #include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_mappings() */
 #include <lttng/abi.h>
 #include <lttng/events.h>
 #include <lttng/events-internal.h>
 #include <lttng/tracer.h>
 #include <wrapper/limits.h>
+#include <wrapper/trace-clock.h>
 
 static struct lttng_transport lttng_relay_transport;
 
@@ -24,16 +31,17 @@ struct event_notifier_packet_header {
 };
 
 struct event_notifier_record_header {
+	uint64_t timestamp;		/* Trace clock, at reservation */
 	uint32_t payload_len;		/* in bytes */
 	uint8_t header_end[0];		/* End of header */
 };
 
 static const struct lttng_kernel_ring_buffer_config client_config;
 
-static inline
+static inline notrace
 u64 lib_ring_buffer_clock_read(struct lttng_kernel_ring_buffer_channel *chan)
 {
-	return 0;
+	return trace_clock_read64();
 }
 
 static inline
@@ -46,9 +54,10 @@ size_t record_header_size(const struct lttng_kernel_ring_buffer_config *config,
 	size_t orig_offset = offset;
 	size_t padding;
 
-	padding = lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
+	padding = lib_ring_buffer_align(offset, lttng_alignof(uint64_t));
 	offset += padding;
 
+	offset += sizeof(uint64_t);
 	offset += sizeof(uint32_t);
 
 	*pre_header_padding = padding;
@@ -60,7 +69,7 @@ size_t record_header_size(const struct lttng_kernel_ring_buffer_config *config,
 
 static u64 client_ring_buffer_clock_read(struct lttng_kernel_ring_buffer_channel *chan)
 {
-	return 0;
+	return lib_ring_buffer_clock_read(chan);
 }
 
 static
@@ -180,14 +189,16 @@ static void client_record_get(const struct lttng_kernel_ring_buffer_config *conf
 	size_t *payload_len, u64 *timestamp)
 {
 	struct event_notifier_record_header header;
+	size_t padding;
 	int ret;
 
-	ret = lib_ring_buffer_read(&buf->backend, offset, &header,
+	padding = lib_ring_buffer_align(offset, lttng_alignof(uint64_t));
+	ret = lib_ring_buffer_read(&buf->backend, offset + padding, &header,
 			offsetof(struct event_notifier_record_header, header_end));
 	CHAN_WARN_ON(chan, ret != offsetof(struct event_notifier_record_header, header_end));
-	*header_len = offsetof(struct event_notifier_record_header, header_end);
+	*header_len = padding + offsetof(struct event_notifier_record_header, header_end);
 	*payload_len = header.payload_len;
-	*timestamp = 0;
+	*timestamp = header.timestamp;
 }
 
 static const struct lttng_kernel_ring_buffer_config client_config = {
@@ -201,8 +212,8 @@ static const struct lttng_kernel_ring_buffer_config client_config = {
 	.cb.record_get = client_record_get,
 
 	.tsc_bits = 0,
-	.alloc = RING_BUFFER_ALLOC_GLOBAL,
-	.sync = RING_BUFFER_SYNC_GLOBAL,
+	.alloc = RING_BUFFER_ALLOC_TEMPLATE,
+	.sync = RING_BUFFER_SYNC_TEMPLATE,
 	.mode = RING_BUFFER_MODE_TEMPLATE,
 	.backend = RING_BUFFER_PAGE,
 	.output = RING_BUFFER_OUTPUT_TEMPLATE,
@@ -211,6 +222,10 @@ static const struct lttng_kernel_ring_buffer_config client_config = {
 	.wakeup = RING_BUFFER_WAKEUP_BY_WRITER,
 };
 
+static int lttng_staging_create(struct lttng_kernel_ring_buffer_channel *chan,
+		struct lttng_event_notifier_group *event_notifier_group);
+static void lttng_staging_destroy(struct lttng_event_notifier_staging *staging);
+
 static
 void release_priv_ops(void *priv_ops)
 {
@@ -220,6 +235,13 @@ void release_priv_ops(void *priv_ops)
 static
 void lttng_channel_destroy(struct lttng_kernel_ring_buffer_channel *chan)
 {
+	struct lttng_event_notifier_group *event_notifier_group =
+		channel_get_private(chan);
+
+	if (event_notifier_group->staging) {
+		lttng_staging_destroy(event_notifier_group->staging);
+		event_notifier_group->staging = NULL;
+	}
 	channel_destroy(chan);
 }
 
@@ -236,7 +258,7 @@ struct lttng_kernel_ring_buffer_channel *_channel_create(const char *name,
 	chan = channel_create(&client_config, name,
 			      event_notifier_group, buf_addr,
 			      subbuf_size, num_subbuf, switch_timer_interval,
-			      read_timer_interval);
+			      read_timer_interval, 0);
 	if (chan) {
 		/*
 		 * Ensure this module is not unloaded before we finish
@@ -248,6 +270,9 @@ struct lttng_kernel_ring_buffer_channel *_channel_create(const char *name,
 		}
 		chan->backend.priv_ops = &lttng_relay_transport.ops;
 		chan->backend.release_priv_ops = release_priv_ops;
+		if ((event_notifier_group->flags & LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING)
+				&& lttng_staging_create(chan, event_notifier_group))
+			goto error;
 	}
 	return chan;
 
@@ -260,10 +285,14 @@ static
 struct lttng_kernel_ring_buffer *lttng_buffer_read_open(struct lttng_kernel_ring_buffer_channel *chan)
 {
 	struct lttng_kernel_ring_buffer *buf;
+	int cpu;
 
-	buf = channel_get_ring_buffer(&client_config, chan, 0);
-	if (!lib_ring_buffer_open_read(buf))
-		return buf;
+	/* Per-CPU channels open one buffer per call. */
+	for_each_channel_cpu(cpu, chan) {
+		buf = channel_get_ring_buffer(&client_config, chan, cpu);
+		if (!lib_ring_buffer_open_read(buf))
+			return buf;
+	}
 	return NULL;
 }
 
@@ -291,25 +320,32 @@ static
 void lttng_write_event_notifier_header(const struct lttng_kernel_ring_buffer_config *config,
 			    struct lttng_kernel_ring_buffer_ctx *ctx)
 {
+	uint64_t timestamp = ctx->priv.tsc;
 	uint32_t data_size;
 
 	WARN_ON_ONCE(ctx->data_size > U32_MAX);
 
 	data_size = (uint32_t) ctx->data_size;
 
+	lib_ring_buffer_write(config, ctx, &timestamp, sizeof(timestamp));
 	lib_ring_buffer_write(config, ctx, &data_size, sizeof(data_size));
 
 	lib_ring_buffer_align_ctx(ctx, ctx->largest_align);
 }
 
+/*
+ * @cpu selects the buffer of per-CPU channels, and must be held with
+ * lib_ring_buffer_get_cpu() until commit. It is ignored by global channels.
+ */
 static
-int lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx)
+int lttng_event_reserve_direct(struct lttng_kernel_ring_buffer_ctx *ctx, int cpu)
 {
 	struct lttng_kernel_ring_buffer_channel *chan = ctx->client_priv;
 	int ret;
 
 	memset(&ctx->priv, 0, sizeof(ctx->priv));
 	ctx->priv.chan = chan;
+	ctx->priv.reserve_cpu = cpu;
 
 	ret = lib_ring_buffer_reserve(&client_config, ctx, NULL);
 	if (ret)
@@ -321,10 +357,310 @@ int lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx)
 	return 0;
 }
 
+/*
+ * Per-CPU notification staging.
+ *
+ * With LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING, notifications
+ * are reserved and written into a per-CPU staging area using local
+ * operations only, and are published to the global ring buffer in a
+ * single burst once the staging area is half full, or when the flush
+ * timer expires. This keeps the write position of the global buffer from
+ * bouncing between CPUs on every notification.
+ *
+ * A staging area is only modified by its own CPU, and by the nested
+ * contexts (interrupts, NMIs) which complete before the context they
+ * interrupt resumes. Publication is therefore only attempted when every
+ * reserved record has been committed, and is made exclusive by the
+ * "publishing" flag. Records staged on a CPU are published in reservation
+ * order. Staged records are only marked by a NULL ctx->priv.buf.
+ */
+#define LTTNG_EVENT_NOTIFIER_STAGING_SIZE	8192
+#define LTTNG_EVENT_NOTIFIER_STAGING_THRESHOLD	(LTTNG_EVENT_NOTIFIER_STAGING_SIZE / 2)
+#define LTTNG_EVENT_NOTIFIER_STAGING_FLUSH_DEFAULT	1000	/* usecs */
+
+struct lttng_event_notifier_staged_header {
+	uint32_t data_size;
+	uint32_t largest_align;
+};
+
+struct lttng_event_notifier_staging_cpu {
+	local_t offset;			/* Reserve position */
+	local_t commit;			/* Committed bytes */
+	local_t publishing;		/* Publication in progress */
+	char data[LTTNG_EVENT_NOTIFIER_STAGING_SIZE] __attribute__((aligned(8)));
+};
+
+struct lttng_event_notifier_staging {
+	struct lttng_kernel_ring_buffer_channel *chan;
+	struct lttng_event_notifier_group *event_notifier_group;
+	struct lttng_event_notifier_staging_cpu __percpu *cpu;
+	struct delayed_work flush_work;
+	unsigned long flush_interval;	/* jiffies */
+};
+
+/*
+ * Staged payloads are aligned on 8 bytes, which preserves the alignment
+ * of every field relative to the payload start in the ring buffer.
+ */
+static inline
+size_t lttng_staging_slot_size(size_t data_size)
+{
+	return ALIGN(sizeof(struct lttng_event_notifier_staged_header) + data_size, 8);
+}
+
+static
+void lttng_staging_publish_record(struct lttng_kernel_ring_buffer_channel *chan,
+		const struct lttng_event_notifier_staged_header *header)
+{
+	struct lttng_kernel_ring_buffer_ctx ctx;
+
+	lib_ring_buffer_ctx_init(&ctx, chan, header->data_size,
+			header->largest_align, NULL);
+	/* Records which do not fit are accounted as lost by the ring buffer. */
+	if (lttng_event_reserve_direct(&ctx, 0))
+		return;
+	lib_ring_buffer_write(&client_config, &ctx, header + 1, header->data_size);
+	lib_ring_buffer_commit(&client_config, &ctx);
+}
+
+/*
+ * Publish the records staged in @scpu. Must be called from the CPU owning
+ * @scpu with the ring buffer nesting count held, or when no record can be
+ * produced concurrently into @scpu. Returns false if publication is not
+ * possible because a record is in flight or a publication is already in
+ * progress.
+ */
+static
+bool lttng_staging_publish(struct lttng_event_notifier_staging *staging,
+		struct lttng_event_notifier_staging_cpu *scpu, bool wakeup)
+{
+	unsigned long pos = 0, end;
+
+	/* Read offset before commit: a nested record can only cause a mismatch. */
+	if (local_read(&scpu->offset) != local_read(&scpu->commit))
+		return false;
+	if (local_cmpxchg(&scpu->publishing, 0, 1) != 0)
+		return false;
+	for (;;) {
+		end = local_read(&scpu->offset);
+		while (pos < end) {
+			const struct lttng_event_notifier_staged_header *header =
+				(const struct lttng_event_notifier_staged_header *) &scpu->data[pos];
+
+			lttng_staging_publish_record(staging->chan, header);
+			pos += lttng_staging_slot_size(header->data_size);
+		}
+		/* Catch records staged by nested contexts in the meantime. */
+		if (local_cmpxchg(&scpu->offset, end, 0) == end)
+			break;
+	}
+	local_sub(end, &scpu->commit);
+	local_set(&scpu->publishing, 0);
+	if (end && wakeup)
+		irq_work_queue(&staging->event_notifier_group->wakeup_pending);
+	return true;
+}
+
+/*
+ * Returns 0 on success, -E2BIG if the record is too large to be staged,
+ * -ENOBUFS if the staging area is full and cannot be published.
+ */
+static
+int lttng_staging_reserve(struct lttng_kernel_ring_buffer_ctx *ctx,
+		struct lttng_event_notifier_staging *staging, int cpu)
+{
+	struct lttng_event_notifier_staging_cpu *scpu = per_cpu_ptr(staging->cpu, cpu);
+	struct lttng_event_notifier_staged_header *header;
+	unsigned long o_begin, o_end;
+	size_t slot_size;
+	bool published = false;
+
+	slot_size = lttng_staging_slot_size(ctx->data_size);
+	if (unlikely(slot_size > LTTNG_EVENT_NOTIFIER_STAGING_THRESHOLD))
+		return -E2BIG;
+	for (;;) {
+		o_begin = local_read(&scpu->offset);
+		o_end = o_begin + slot_size;
+		if (unlikely(o_end > LTTNG_EVENT_NOTIFIER_STAGING_SIZE)) {
+			if (published || !lttng_staging_publish(staging, scpu, true))
+				return -ENOBUFS;
+			published = true;
+			continue;
+		}
+		if (local_cmpxchg(&scpu->offset, o_begin, o_end) == o_begin)
+			break;
+	}
+	header = (struct lttng_event_notifier_staged_header *) &scpu->data[o_begin];
+	header->data_size = ctx->data_size;
+	header->largest_align = ctx->largest_align;
+
+	memset(&ctx->priv, 0, sizeof(ctx->priv));
+	ctx->priv.chan = staging->chan;
+	ctx->priv.reserve_cpu = cpu;
+	ctx->priv.slot_size = slot_size;
+	ctx->priv.pre_offset = o_begin;
+	ctx->priv.buf_offset = o_begin + sizeof(*header);
+	return 0;
+}
+
+static
+void lttng_staging_commit(struct lttng_kernel_ring_buffer_ctx *ctx,
+		struct lttng_event_notifier_staging *staging)
+{
+	struct lttng_event_notifier_staging_cpu *scpu =
+		per_cpu_ptr(staging->cpu, ctx->priv.reserve_cpu);
+
+	local_add(ctx->priv.slot_size, &scpu->commit);
+	if (local_read(&scpu->offset) >= LTTNG_EVENT_NOTIFIER_STAGING_THRESHOLD)
+		lttng_staging_publish(staging, scpu, true);
+}
+
+static inline
+char *lttng_staging_ptr(struct lttng_kernel_ring_buffer_ctx *ctx)
+{
+	struct lttng_event_notifier_group *event_notifier_group =
+		channel_get_private(ctx->priv.chan);
+
+	return per_cpu_ptr(event_notifier_group->staging->cpu,
+			ctx->priv.reserve_cpu)->data + ctx->priv.buf_offset;
+}
+
+static
+void lttng_staging_flush_ipi(void *info)
+{
+	struct lttng_event_notifier_staging *staging = info;
+
+	if (lib_ring_buffer_get_cpu(&client_config) < 0)
+		return;
+	lttng_staging_publish(staging, this_cpu_ptr(staging->cpu), true);
+	lib_ring_buffer_put_cpu(&client_config);
+}
+
+/*
+ * Publish the records left in the staging areas of idle CPUs. Staging
+ * areas of online CPUs are published from their own CPU; those of offline
+ * CPUs cannot be written to while the CPU hotplug lock is held.
+ */
+static
+void lttng_staging_flush_work(struct work_struct *work)
+{
+	struct lttng_event_notifier_staging *staging =
+		container_of(work, struct lttng_event_notifier_staging, flush_work.work);
+	int cpu;
+
+	lttng_cpus_read_lock();
+	for_each_possible_cpu(cpu) {
+		struct lttng_event_notifier_staging_cpu *scpu = per_cpu_ptr(staging->cpu, cpu);
+
+		if (!local_read(&scpu->offset))
+			continue;
+		if (cpu_online(cpu))
+			smp_call_function_single(cpu, lttng_staging_flush_ipi, staging, 1);
+		else
+			lttng_staging_publish(staging, scpu, true);
+	}
+	lttng_cpus_read_unlock();
+	schedule_delayed_work(&staging->flush_work, staging->flush_interval);
+}
+
+static
+int lttng_staging_create(struct lttng_kernel_ring_buffer_channel *chan,
+		struct lttng_event_notifier_group *event_notifier_group)
+{
+	struct lttng_event_notifier_staging *staging;
+	unsigned int flush_interval;
+
+	staging = kzalloc(sizeof(*staging), GFP_KERNEL);
+	if (!staging)
+		return -ENOMEM;
+	staging->cpu = alloc_percpu(struct lttng_event_notifier_staging_cpu);
+	if (!staging->cpu) {
+		kfree(staging);
+		return -ENOMEM;
+	}
+	staging->chan = chan;
+	staging->event_notifier_group = event_notifier_group;
+	flush_interval = event_notifier_group->staging_flush_interval ? :
+			LTTNG_EVENT_NOTIFIER_STAGING_FLUSH_DEFAULT;
+	staging->flush_interval = max_t(unsigned long, usecs_to_jiffies(flush_interval), 1);
+	INIT_DELAYED_WORK(&staging->flush_work, lttng_staging_flush_work);
+	event_notifier_group->staging = staging;
+	schedule_delayed_work(&staging->flush_work, staging->flush_interval);
+	return 0;
+}
+
+/*
+ * Called after the notifiers have been unregistered and in-flight
+ * notifications have completed: publish what is left from any CPU. Do not
+ * wake up readers, the group wakeup irq work has already been synced.
+ */
+static
+void lttng_staging_destroy(struct lttng_event_notifier_staging *staging)
+{
+	int cpu;
+
+	cancel_delayed_work_sync(&staging->flush_work);
+	for_each_possible_cpu(cpu)
+		WARN_ON_ONCE(!lttng_staging_publish(staging,
+				per_cpu_ptr(staging->cpu, cpu), false));
+	free_percpu(staging->cpu);
+	kfree(staging);
+}
+
+static
+int lttng_event_reserve(struct lttng_kernel_ring_buffer_ctx *ctx)
+{
+	struct lttng_kernel_ring_buffer_channel *chan = ctx->client_priv;
+	struct lttng_event_notifier_group *event_notifier_group = channel_get_private(chan);
+	struct lttng_event_notifier_staging *staging = event_notifier_group->staging;
+	int cpu, ret;
+
+	if (client_config.alloc == RING_BUFFER_ALLOC_GLOBAL && !staging)
+		return lttng_event_reserve_direct(ctx, 0);
+	/* The nesting count is held until commit. */
+	cpu = lib_ring_buffer_get_cpu(&client_config);
+	if (unlikely(cpu < 0))
+		return -EPERM;
+	if (client_config.alloc == RING_BUFFER_ALLOC_PER_CPU)
+		ret = lttng_event_reserve_direct(ctx, cpu);
+	else
+		ret = lttng_staging_reserve(ctx, staging, cpu);
+	if (ret == -E2BIG) {
+		/*
+		 * Publish the records staged before this one to keep them
+		 * ordered, then write it directly to the ring buffer.
+		 */
+		if (lttng_staging_publish(staging, per_cpu_ptr(staging->cpu, cpu), true))
+			ret = lttng_event_reserve_direct(ctx, cpu);
+		else
+			ret = -ENOBUFS;
+	}
+	if (ret)
+		lib_ring_buffer_put_cpu(&client_config);
+	return ret;
+}
+
 static
 void lttng_event_commit(struct lttng_kernel_ring_buffer_ctx *ctx)
 {
-	lib_ring_buffer_commit(&client_config, ctx);
+	struct lttng_event_notifier_group *event_notifier_group =
+		channel_get_private(ctx->priv.chan);
+	struct lttng_event_notifier_staging *staging = event_notifier_group->staging;
+
+	if (!staging) {
+		lib_ring_buffer_commit(&client_config, ctx);
+		/* Per-CPU channels hold the nesting count since reserve. */
+		if (client_config.alloc == RING_BUFFER_ALLOC_PER_CPU)
+			lib_ring_buffer_put_cpu(&client_config);
+		return;
+	}
+	if (ctx->priv.buf) {
+		lib_ring_buffer_commit(&client_config, ctx);
+		irq_work_queue(&event_notifier_group->wakeup_pending);
+	} else {
+		lttng_staging_commit(ctx, staging);
+	}
+	lib_ring_buffer_put_cpu(&client_config);
 }
 
 static
@@ -332,6 +668,11 @@ void lttng_event_write(struct lttng_kernel_ring_buffer_ctx *ctx, const void *src
 		     size_t len, size_t alignment)
 {
 	lib_ring_buffer_align_ctx(ctx, alignment);
+	if (unlikely(!ctx->priv.buf)) {
+		memcpy(lttng_staging_ptr(ctx), src, len);
+		ctx->priv.buf_offset += len;
+		return;
+	}
 	lib_ring_buffer_write(&client_config, ctx, src, len);
 }
 
@@ -340,6 +681,20 @@ void lttng_event_write_from_user(struct lttng_kernel_ring_buffer_ctx *ctx,
 			       const void __user *src, size_t len, size_t alignment)
 {
 	lib_ring_buffer_align_ctx(ctx, alignment);
+	if (unlikely(!ctx->priv.buf)) {
+		char *dest = lttng_staging_ptr(ctx);
+		unsigned long ret = len;
+
+		if (lttng_access_ok(VERIFY_READ, src, len)) {
+			pagefault_disable();
+			ret = lib_ring_buffer_do_copy_from_user_inatomic(dest, src, len);
+			pagefault_enable();
+		}
+		if (unlikely(ret))
+			memset(dest, 0, len);
+		ctx->priv.buf_offset += len;
+		return;
+	}
 	lib_ring_buffer_copy_from_user_inatomic(&client_config, ctx, src, len);
 }
 
@@ -347,6 +702,11 @@ static
 void lttng_event_memset(struct lttng_kernel_ring_buffer_ctx *ctx,
 		int c, size_t len)
 {
+	if (unlikely(!ctx->priv.buf)) {
+		memset(lttng_staging_ptr(ctx), c, len);
+		ctx->priv.buf_offset += len;
+		return;
+	}
 	lib_ring_buffer_memset(&client_config, ctx, c, len);
 }
 
@@ -354,6 +714,19 @@ static
 void lttng_event_strcpy(struct lttng_kernel_ring_buffer_ctx *ctx, const char *src,
 		size_t len)
 {
+	if (unlikely(!ctx->priv.buf)) {
+		char *dest = lttng_staging_ptr(ctx);
+		size_t count;
+
+		if (unlikely(!len))
+			return;
+		count = lib_ring_buffer_do_strcpy(&client_config, dest, src, len - 1);
+		/* Same padding as lib_ring_buffer_strcpy(). */
+		memset(dest + count, '#', len - 1 - count);
+		dest[len - 1] = '\0';
+		ctx->priv.buf_offset += len;
+		return;
+	}
 	lib_ring_buffer_strcpy(&client_config, ctx, src, len, '#');
 }
 
@@ -363,6 +736,8 @@ size_t lttng_packet_avail_size(struct lttng_kernel_ring_buffer_channel *chan)
 	unsigned long o_begin;
 	struct lttng_kernel_ring_buffer *buf;
 
+	if (client_config.alloc != RING_BUFFER_ALLOC_GLOBAL)
+		return 0;
 	buf = chan->backend.buf;	/* Only for global buffer ! */
 	o_begin = v_read(&client_config, &buf->offset);
 	if (subbuf_offset(o_begin, chan) != 0) {
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: (GPL-2.0 or LGPL-2.1)
+ *
+ * lttng-ring-buffer-event-notifier-percpu-client.c
+ *
+ * LTTng lib ring buffer event notifier client (per-CPU buffers).
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/module.h>
+#include <lttng/tracer.h>
+
+#define RING_BUFFER_MODE_TEMPLATE		RING_BUFFER_DISCARD
+#define RING_BUFFER_MODE_TEMPLATE_STRING	"event-notifier-percpu"
+#define RING_BUFFER_OUTPUT_TEMPLATE		RING_BUFFER_NONE
+#define RING_BUFFER_ALLOC_TEMPLATE		RING_BUFFER_ALLOC_PER_CPU
+#define RING_BUFFER_SYNC_TEMPLATE		RING_BUFFER_SYNC_PER_CPU
+#include "lttng-ring-buffer-event-notifier-client.h"
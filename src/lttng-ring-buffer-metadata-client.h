@@ -101,8 +101,13 @@ static void client_buffer_begin(struct lttng_kernel_ring_buffer *buf, u64 tsc,
 	header->compression_scheme = 0;	/* 0 if unused */
 	header->encryption_scheme = 0;	/* 0 if unused */
 	header->checksum_scheme = 0;	/* 0 if unused */
-	header->major = CTF_SPEC_MAJOR;
-	header->minor = CTF_SPEC_MINOR;
+	if (metadata_cache->format == LTTNG_KERNEL_ABI_METADATA_FORMAT_CTF_2) {
+		header->major = CTF2_SPEC_MAJOR;
+		header->minor = CTF2_SPEC_MINOR;
+	} else {
+		header->major = CTF_SPEC_MAJOR;
+		header->minor = CTF_SPEC_MINOR;
+	}
 }
 
 /*
@@ -250,7 +255,7 @@ struct lttng_kernel_ring_buffer_channel *_channel_create(const char *name,
 	chan = channel_create(&client_config, name,
 			      lttng_chan->parent.session->priv->metadata_cache, buf_addr,
 			      subbuf_size, num_subbuf, switch_timer_interval,
-			      read_timer_interval);
+			      read_timer_interval, 0);
 	if (chan) {
 		/*
 		 * Ensure this module is not unloaded before we finish
@@ -0,0 +1,31 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * probes/lttng-probe-counter-snapshot.c
+ *
+ * LTTng counter snapshot probes.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/module.h>
+#include <lttng/events.h>
+#include <lttng/tracer.h>
+
+/*
+ * Create LTTng tracepoint probes.
+ */
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TP_SESSION_CHECK
+#define TRACE_INCLUDE_PATH instrumentation/events
+#define TRACE_INCLUDE_FILE lttng-counter-snapshot
+
+#include <instrumentation/events/lttng-counter-snapshot.h>
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("EfficiOS Inc.");
+MODULE_DESCRIPTION("LTTng counter snapshot probes");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
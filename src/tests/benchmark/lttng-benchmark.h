@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-benchmark.h
+ *
+ * LTTng benchmark trigger. When CONFIG_LTTNG_BENCHMARK is set, benchmarks
+ * are built into the module owning the code they measure, and each one is
+ * run by writing to its module parameter, e.g.:
+ *
+ *   echo 1 > /sys/module/lttng_lib_ring_buffer/parameters/benchmark_merge
+ *
+ * Results are printed to the kernel log.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#ifndef _LTTNG_BENCHMARK_H
+#define _LTTNG_BENCHMARK_H
+
+#include <linux/moduleparam.h>
+
+#define LTTNG_BENCHMARK(_name, _run)					\
+	static int lttng_benchmark_##_name##_set(const char *val,	\
+			const struct kernel_param *kp)			\
+	{								\
+		return _run();						\
+	}								\
+	static const struct kernel_param_ops lttng_benchmark_##_name##_ops = { \
+		.set = lttng_benchmark_##_name##_set,			\
+	};								\
+	module_param_cb(benchmark_##_name, &lttng_benchmark_##_name##_ops, NULL, 0200)
+
+#endif /* _LTTNG_BENCHMARK_H */
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-client-benchmark.c
+ *
+ * LTTng ring buffer client fast path benchmark. Records events into an
+ * overwrite channel for each event header type, with and without channel
+ * context, through the generic client ops and through the ops specialized
+ * for the channel layout, and reports the cost of each event in cycles.
+ * Results are printed to the kernel log when the benchmark is run.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/preempt.h>
+#include <linux/sched.h>
+#include <linux/timex.h>
+#include <linux/math64.h>
+
+#include <lttng/abi.h>
+#include <lttng/events.h>
+#include <lttng/events-internal.h>
+#include <lttng/tracer.h>
+#include "lttng-benchmark.h"
+#include <ringbuffer/frontend_types.h>
+
+#define BENCH_BATCH	1024
+
+#define NR_EVENTS	1000000
+
+static const char * const header_type_name[] = {
+	[1] = "compact",
+	[2] = "large",
+	[3] = "packed",
+};
+
+/*
+ * Records the events by batches with preemption disabled, so the cycle
+ * count is not polluted by scheduling, and returns the total cycle count.
+ */
+static
+u64 bench_record(struct lttng_kernel_channel_buffer_ops *ops,
+		struct lttng_kernel_event_recorder *event_recorder,
+		unsigned long *nr_lost)
+{
+	struct lttng_kernel_probe_ctx probe_ctx = {
+		.event = &event_recorder->parent,
+		.interruptible = 0,
+	};
+	unsigned int i = 0, j;
+	u64 payload = 0, cycles = 0;
+
+	while (i < NR_EVENTS) {
+		cycles_t begin;
+
+		preempt_disable();
+		begin = get_cycles();
+		for (j = 0; j < BENCH_BATCH && i < NR_EVENTS; j++, i++) {
+			struct lttng_kernel_ring_buffer_ctx ctx;
+
+			lib_ring_buffer_ctx_init(&ctx, event_recorder,
+				sizeof(payload), lttng_alignof(payload), &probe_ctx);
+			if (ops->event_reserve(&ctx) < 0) {
+				(*nr_lost)++;
+				continue;
+			}
+			ops->event_write(&ctx, &payload, sizeof(payload),
+				lttng_alignof(payload));
+			ops->event_commit(&ctx);
+			payload++;
+		}
+		cycles += get_cycles() - begin;
+		preempt_enable();
+		cond_resched();
+	}
+	return cycles;
+}
+
+static
+int bench_run(int header_type, bool context)
+{
+	struct lttng_kernel_event_recorder_private event_recorder_priv = {
+		.id = 1,
+	};
+	struct lttng_kernel_event_recorder event_recorder = {
+		.priv = &event_recorder_priv,
+	};
+	struct lttng_kernel_channel_buffer_ops *generic_ops;
+	struct lttng_kernel_channel_buffer *chan;
+	struct lttng_kernel_session *session;
+	unsigned long nr_lost = 0;
+	u64 generic, specialized;
+	int ret = 0;
+
+	session = lttng_session_create();
+	if (!session)
+		return -ENOMEM;
+	chan = lttng_channel_buffer_create(session, "relay-overwrite", NULL,
+			PAGE_SIZE * 16, 4, 0, 0,
+			header_type == 3 ? LTTNG_KERNEL_ABI_CHANNEL_FLAG_PACKED_HEADER : 0,
+			PER_CPU_CHANNEL);
+	if (IS_ERR(chan)) {
+		printk(KERN_WARNING "LTTng: client benchmark: cannot create channel\n");
+		ret = PTR_ERR(chan);
+		goto destroy_session;
+	}
+	if (context) {
+		ret = lttng_add_cpu_id_to_ctx(&chan->priv->ctx);
+		if (ret)
+			goto destroy_session;
+	}
+	event_recorder.chan = chan;
+	chan->priv->header_type = header_type;
+	generic_ops = chan->ops;
+	lttng_channel_buffer_specialize(chan);
+
+	generic = bench_record(generic_ops, &event_recorder, &nr_lost);
+	specialized = bench_record(chan->ops, &event_recorder, &nr_lost);
+	printk(KERN_INFO "LTTng: client benchmark: %s header, %s context: "
+	       "generic %llu cycles/event, specialized %llu cycles/event%s, %lu lost\n",
+	       header_type_name[header_type], context ? "cpu_id" : "no",
+	       div_u64(generic, NR_EVENTS), div_u64(specialized, NR_EVENTS),
+	       chan->ops == generic_ops ? " (not specialized)" : "",
+	       nr_lost);
+destroy_session:
+	lttng_session_destroy(session);
+	return ret;
+}
+
+static
+int lttng_client_benchmark_run(void)
+{
+	int header_type, ret;
+
+	for (header_type = 1; header_type <= 3; header_type++) {
+		ret = bench_run(header_type, false);
+		if (ret)
+			return ret;
+		ret = bench_run(header_type, true);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+LTTNG_BENCHMARK(client, lttng_client_benchmark_run);
@@ -0,0 +1,114 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-compress-benchmark.c
+ *
+ * LTTng sub-buffer compression benchmark. Compresses synthetic CTF
+ * packets with each compression algorithm available to the channel
+ * compression stage, and reports the throughput, the CPU cost per MB of
+ * trace data and the compression ratio. Results are printed to the kernel
+ * log when the benchmark is run.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/crypto.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+#include <wrapper/vmalloc.h>
+#include <lttng/tracer.h>
+#include "lttng-benchmark.h"
+
+#define SUBBUF_SIZE	262144
+#define NR_ITERATIONS	256
+
+static const char *algs[] = { "lz4", "zstd" };
+
+/*
+ * Fill @data with records laid out like the compact event header of the
+ * ring buffer client: a 32-bit id/timestamp word followed by a small
+ * payload of integers drawn from a few distinct values.
+ */
+static
+void fill_packet(u32 *data, size_t len)
+{
+	u32 rand = 2463534242U, timestamp = 0;
+	size_t i = 0;
+
+	while (i + 4 <= len / sizeof(u32)) {
+		rand ^= rand << 13;
+		rand ^= rand >> 17;
+		rand ^= rand << 5;
+		timestamp += 1 + (rand & 255);
+		data[i++] = ((rand >> 8) & 0x1F) | (timestamp << 5);
+		data[i++] = (rand >> 16) & 0xF;		/* cpu-like field */
+		data[i++] = 1000 + ((rand >> 20) & 0x7);	/* pid-like field */
+		data[i++] = rand & 0xFFF;		/* value field */
+	}
+}
+
+static
+int bench_alg(const char *alg_name, const void *src, void *dst)
+{
+	struct crypto_comp *tfm;
+	u64 start, ns, total_in = 0, total_out = 0;
+	unsigned int i;
+	int ret = 0;
+
+	if (!crypto_has_comp(alg_name, 0, 0)) {
+		printk(KERN_INFO "LTTng: compress benchmark: %s not available\n",
+		       alg_name);
+		return 0;
+	}
+	tfm = crypto_alloc_comp(alg_name, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+	start = ktime_get_ns();
+	for (i = 0; i < NR_ITERATIONS; i++) {
+		unsigned int dlen = SUBBUF_SIZE;
+
+		ret = crypto_comp_compress(tfm, src, SUBBUF_SIZE, dst, &dlen);
+		if (ret)
+			goto end;
+		total_in += SUBBUF_SIZE;
+		total_out += dlen;
+	}
+	ns = max_t(u64, ktime_get_ns() - start, 1);
+	printk(KERN_INFO "LTTng: compress benchmark: %s: %llu bytes/s, "
+	       "%llu ns/MB, ratio %llu.%02llu\n",
+	       alg_name,
+	       div64_u64(total_in * NSEC_PER_SEC, ns),
+	       div64_u64(ns << 20, total_in),
+	       div64_u64(total_in, total_out),
+	       div64_u64((total_in % total_out) * 100, total_out));
+end:
+	crypto_free_comp(tfm);
+	return ret;
+}
+
+static
+int lttng_compress_benchmark_run(void)
+{
+	void *src, *dst;
+	unsigned int i;
+	int ret = 0;
+
+	src = lttng_kvmalloc(SUBBUF_SIZE, GFP_KERNEL);
+	dst = lttng_kvmalloc(SUBBUF_SIZE, GFP_KERNEL);
+	if (!src || !dst) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	fill_packet(src, SUBBUF_SIZE);
+	for (i = 0; i < ARRAY_SIZE(algs); i++) {
+		ret = bench_alg(algs[i], src, dst);
+		if (ret)
+			goto end;
+	}
+end:
+	lttng_kvfree(dst);
+	lttng_kvfree(src);
+	return ret;
+}
+LTTNG_BENCHMARK(compress, lttng_compress_benchmark_run);
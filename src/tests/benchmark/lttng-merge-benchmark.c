@@ -0,0 +1,168 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-merge-benchmark.c
+ *
+ * LTTng channel iterator merge benchmark. Compares the throughput of the
+ * prio heap and of the loser tree when merging per-CPU streams of
+ * timestamps, for increasing stream counts. Results are printed to the
+ * kernel log when the benchmark is run.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+#include <lttng/prio_heap.h>
+#include <lttng/loser_tree.h>
+#include <lttng/tracer.h>
+#include "lttng-benchmark.h"
+
+#define NR_RECORDS	1000000
+#define MAX_STREAMS	256
+
+/*
+ * Per-stream state, allocated separately to reproduce the pointer chasing
+ * of per-CPU ring buffer iterators.
+ */
+struct merge_stream {
+	u64 timestamp;
+	u32 rand;
+	unsigned int index;
+};
+
+static
+u64 merge_stream_next(struct merge_stream *stream)
+{
+	/* xorshift32: unpredictable but deterministic increments. */
+	stream->rand ^= stream->rand << 13;
+	stream->rand ^= stream->rand >> 17;
+	stream->rand ^= stream->rand << 5;
+	stream->timestamp += 1 + (stream->rand & 1023);
+	return stream->timestamp;
+}
+
+static
+void merge_streams_reset(struct merge_stream **streams, unsigned int nr_streams)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_streams; i++) {
+		streams[i]->timestamp = 0;
+		streams[i]->rand = 2463534242U + i;
+		streams[i]->index = i;
+		merge_stream_next(streams[i]);
+	}
+}
+
+static
+int stream_is_higher(void *a, void *b)
+{
+	struct merge_stream *sa = a, *sb = b;
+
+	return sa->timestamp < sb->timestamp;
+}
+
+static
+int bench_heap(struct merge_stream **streams, unsigned int nr_streams,
+		u64 *ns)
+{
+	struct lttng_ptr_heap heap;
+	unsigned long i;
+	u64 start;
+	int ret;
+
+	ret = lttng_heap_init(&heap, nr_streams, GFP_KERNEL, stream_is_higher);
+	if (ret)
+		return ret;
+	merge_streams_reset(streams, nr_streams);
+	for (i = 0; i < nr_streams; i++) {
+		ret = lttng_heap_insert(&heap, streams[i]);
+		if (ret)
+			goto end;
+	}
+	start = ktime_get_ns();
+	for (i = 0; i < NR_RECORDS; i++) {
+		struct merge_stream *top = lttng_heap_maximum(&heap);
+
+		merge_stream_next(top);
+		lttng_heap_replace_max(&heap, top);
+	}
+	*ns = ktime_get_ns() - start;
+end:
+	lttng_heap_free(&heap);
+	return ret;
+}
+
+static
+int bench_loser_tree(struct merge_stream **streams, unsigned int nr_streams,
+		u64 *ns)
+{
+	struct lttng_loser_tree tree;
+	unsigned long i;
+	u64 start;
+	int ret;
+
+	ret = lttng_loser_tree_init(&tree, nr_streams, GFP_KERNEL);
+	if (ret)
+		return ret;
+	merge_streams_reset(streams, nr_streams);
+	for (i = 0; i < nr_streams; i++)
+		lttng_loser_tree_set_key(&tree, i, streams[i]->timestamp);
+	lttng_loser_tree_rebuild(&tree);
+	start = ktime_get_ns();
+	for (i = 0; i < NR_RECORDS; i++) {
+		struct merge_stream *top = streams[lttng_loser_tree_winner(&tree)];
+
+		lttng_loser_tree_replace_winner(&tree, merge_stream_next(top));
+	}
+	*ns = ktime_get_ns() - start;
+	lttng_loser_tree_free(&tree);
+	return 0;
+}
+
+static
+u64 records_per_sec(u64 ns)
+{
+	return div64_u64((u64) NR_RECORDS * NSEC_PER_SEC, max_t(u64, ns, 1));
+}
+
+static
+int lttng_merge_benchmark_run(void)
+{
+	struct merge_stream **streams;
+	unsigned int nr_streams, i;
+	int ret = 0;
+
+	streams = kcalloc(MAX_STREAMS, sizeof(*streams), GFP_KERNEL);
+	if (!streams)
+		return -ENOMEM;
+	for (i = 0; i < MAX_STREAMS; i++) {
+		streams[i] = kzalloc(sizeof(*streams[i]), GFP_KERNEL);
+		if (!streams[i]) {
+			ret = -ENOMEM;
+			goto end;
+		}
+	}
+	for (nr_streams = 1; nr_streams <= MAX_STREAMS; nr_streams <<= 1) {
+		u64 heap_ns, tree_ns;
+
+		ret = bench_heap(streams, nr_streams, &heap_ns);
+		if (ret)
+			goto end;
+		ret = bench_loser_tree(streams, nr_streams, &tree_ns);
+		if (ret)
+			goto end;
+		printk(KERN_INFO "LTTng: merge benchmark: %u streams: "
+		       "heap %llu records/s, loser tree %llu records/s\n",
+		       nr_streams, records_per_sec(heap_ns),
+		       records_per_sec(tree_ns));
+	}
+end:
+	for (i = 0; i < MAX_STREAMS; i++)
+		kfree(streams[i]);
+	kfree(streams);
+	return ret;
+}
+LTTNG_BENCHMARK(merge, lttng_merge_benchmark_run);
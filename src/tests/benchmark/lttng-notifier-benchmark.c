@@ -0,0 +1,236 @@
+/* SPDX-License-Identifier: (GPL-2.0-only or LGPL-2.1-only)
+ *
+ * lttng-notifier-benchmark.c
+ *
+ * LTTng event notifier group scalability benchmark. Produces notifications
+ * concurrently from an increasing number of CPUs into an event notifier
+ * group, with a global ring buffer, with per-CPU staging and with per-CPU
+ * ring buffers, and reports the notification throughput. A consumer
+ * thread drains the group ring buffers. Results are printed to the kernel
+ * log when the benchmark is run.
+ *
+ * Copyright (C) 2026 EfficiOS Inc.
+ */
+
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/irq_work.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
+
+#include <lttng/abi.h>
+#include <lttng/events.h>
+#include <lttng/events-internal.h>
+#include <lttng/tracer.h>
+#include "lttng-benchmark.h"
+#include <ringbuffer/frontend.h>
+
+#define NR_NOTIFICATIONS	1000000
+
+struct bench_writer {
+	struct lttng_event_notifier_group *group;
+	struct completion *start;
+	struct completion done;
+	struct task_struct *task;
+	unsigned long nr_written, nr_lost;
+};
+
+struct bench_consumer {
+	struct lttng_kernel_ring_buffer **bufs;
+	unsigned int nr_bufs;
+};
+
+static
+void bench_wait_stop(void)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+}
+
+static
+int bench_writer_thread(void *data)
+{
+	struct bench_writer *writer = data;
+	struct lttng_event_notifier_group *group = writer->group;
+	struct lttng_kernel_abi_event_notifier_notification notif = { 0 };
+	unsigned int i;
+
+	wait_for_completion(writer->start);
+	for (i = 0; i < NR_NOTIFICATIONS; i++) {
+		struct lttng_kernel_ring_buffer_ctx ctx;
+
+		notif.token = i;
+		lib_ring_buffer_ctx_init(&ctx, group->chan, sizeof(notif),
+				lttng_alignof(notif), NULL);
+		if (group->ops->event_reserve(&ctx) < 0) {
+			writer->nr_lost++;
+			continue;
+		}
+		group->ops->event_write(&ctx, &notif, sizeof(notif),
+				lttng_alignof(notif));
+		group->ops->event_commit(&ctx);
+		writer->nr_written++;
+	}
+	complete(&writer->done);
+	bench_wait_stop();
+	return 0;
+}
+
+static
+int bench_consumer_thread(void *data)
+{
+	struct bench_consumer *consumer = data;
+	unsigned int i;
+
+	while (!kthread_should_stop()) {
+		bool consumed = false;
+
+		for (i = 0; i < consumer->nr_bufs; i++) {
+			if (!lib_ring_buffer_get_next_subbuf(consumer->bufs[i])) {
+				lib_ring_buffer_put_next_subbuf(consumer->bufs[i]);
+				consumed = true;
+			}
+		}
+		if (!consumed)
+			cond_resched();
+	}
+	return 0;
+}
+
+static
+const char *bench_mode_name(uint32_t flags)
+{
+	if (flags & LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING)
+		return "staging";
+	if (flags & LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_PER_CPU)
+		return "per-cpu";
+	return "direct";
+}
+
+static
+void bench_wakeup(struct irq_work *entry)
+{
+}
+
+static
+int bench_run(uint32_t flags, unsigned int nr_cpus)
+{
+	struct lttng_kernel_abi_event_notifier_group_conf conf = {
+		.flags = flags,
+	};
+	struct lttng_event_notifier_group *group;
+	struct lttng_kernel_ring_buffer *buf;
+	struct bench_consumer consumer_data = { 0 };
+	struct task_struct *consumer;
+	struct bench_writer *writers;
+	DECLARE_COMPLETION_ONSTACK(start);
+	unsigned long nr_written = 0, nr_lost = 0;
+	unsigned int i = 0, nr_started = 0;
+	u64 begin, ns;
+	int cpu, ret = 0;
+
+	writers = kcalloc(nr_cpus, sizeof(*writers), GFP_KERNEL);
+	if (!writers)
+		return -ENOMEM;
+	group = lttng_event_notifier_group_create(&conf);
+	if (!group) {
+		printk(KERN_WARNING "LTTng: notifier benchmark: cannot create event notifier group\n");
+		ret = -ENOENT;
+		goto free_writers;
+	}
+	init_waitqueue_head(&group->read_wait);
+	init_irq_work(&group->wakeup_pending, bench_wakeup);
+	consumer_data.bufs = kcalloc(num_possible_cpus(), sizeof(*consumer_data.bufs),
+			GFP_KERNEL);
+	if (!consumer_data.bufs) {
+		ret = -ENOMEM;
+		goto destroy_group;
+	}
+	/* Per-CPU groups open one buffer per call. */
+	while (consumer_data.nr_bufs < num_possible_cpus()
+			&& (buf = group->ops->priv->buffer_read_open(group->chan)))
+		consumer_data.bufs[consumer_data.nr_bufs++] = buf;
+	if (!consumer_data.nr_bufs) {
+		ret = -EBUSY;
+		goto close_read;
+	}
+	consumer = kthread_run(bench_consumer_thread, &consumer_data, "lttng-notif-consumer");
+	if (IS_ERR(consumer)) {
+		ret = PTR_ERR(consumer);
+		goto close_read;
+	}
+	for_each_online_cpu(cpu) {
+		struct bench_writer *writer = &writers[i];
+
+		if (i == nr_cpus)
+			break;
+		writer->group = group;
+		writer->start = &start;
+		init_completion(&writer->done);
+		writer->task = kthread_create_on_node(bench_writer_thread, writer,
+				cpu_to_node(cpu), "lttng-notif-writer/%d", cpu);
+		if (IS_ERR(writer->task)) {
+			ret = PTR_ERR(writer->task);
+			break;
+		}
+		kthread_bind(writer->task, cpu);
+		wake_up_process(writer->task);
+		nr_started = ++i;
+	}
+	begin = ktime_get_ns();
+	complete_all(&start);
+	for (i = 0; i < nr_started; i++)
+		wait_for_completion(&writers[i].done);
+	ns = max_t(u64, ktime_get_ns() - begin, 1);
+	for (i = 0; i < nr_started; i++) {
+		kthread_stop(writers[i].task);
+		nr_written += writers[i].nr_written;
+		nr_lost += writers[i].nr_lost;
+	}
+	kthread_stop(consumer);
+	if (!ret)
+		printk(KERN_INFO "LTTng: notifier benchmark: %s, %u CPUs: "
+		       "%llu notifications/s, %lu lost\n",
+		       bench_mode_name(flags),
+		       nr_started,
+		       div64_u64((u64) (nr_written + nr_lost) * NSEC_PER_SEC, ns),
+		       nr_lost);
+close_read:
+	for (i = 0; i < consumer_data.nr_bufs; i++)
+		group->ops->priv->buffer_read_close(consumer_data.bufs[i]);
+	kfree(consumer_data.bufs);
+destroy_group:
+	lttng_event_notifier_group_destroy(group);
+free_writers:
+	kfree(writers);
+	return ret;
+}
+
+static
+int lttng_notifier_benchmark_run(void)
+{
+	unsigned int nr_cpus, n;
+	int ret;
+
+	nr_cpus = num_online_cpus();
+	for (n = 1; ; n = min(n * 2, nr_cpus)) {
+		ret = bench_run(0, n);
+		if (ret)
+			return ret;
+		ret = bench_run(LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_STAGING, n);
+		if (ret)
+			return ret;
+		ret = bench_run(LTTNG_KERNEL_ABI_EVENT_NOTIFIER_GROUP_FLAG_PER_CPU, n);
+		if (ret)
+			return ret;
+		if (n == nr_cpus)
+			break;
+	}
+	return 0;
+}
+LTTNG_BENCHMARK(notifier, lttng_notifier_benchmark_run);